@@ -0,0 +1,346 @@
+/* MisbitFont Library Micro-Benchmarks
+ *
+ * Measures every public hot path of the library against synthetic fonts covering all
+ * palette formats, a range of character sizes and character counts.  Results are written
+ * to stdout as CSV (default) or JSON so they can be compared between builds.
+ *
+ * Usage:  msbtfont_bench [--json] [--quick] [--max-memory <MiB>] [--min-time <ms>]
+ *
+ */
+
+#include "../include/msbtfont.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct msbtfont_bench_options
+{
+	int json;
+	int quick;
+	size_t max_memory;
+	double min_time;
+} msbtfont_bench_options;
+
+typedef struct msbtfont_bench_font
+{
+	msbtfont_header header;
+	msbtfont_filedata filedata;
+	unsigned char palette_format;
+	unsigned short size;
+	unsigned int count;
+} msbtfont_bench_font;
+
+static int msbtfont_bench_first_result = 1;
+
+static double msbtfont_bench_now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)(ts.tv_sec) + ((double)(ts.tv_nsec) / 1e9);
+}
+
+static void msbtfont_bench_report(const msbtfont_bench_options *options, const char *benchmark, const msbtfont_bench_font *font, const char *variant, double seconds, unsigned long long iterations, unsigned long long items_per_iteration, unsigned long long bytes_per_iteration)
+{
+	if (seconds <= 0.0)
+	{
+		seconds = 1e-9;
+	}
+	double ns_per_iteration = (seconds * 1e9) / (double)(iterations);
+	double items_per_second = ((double)(items_per_iteration) * (double)(iterations)) / seconds;
+	double mib_per_second = (((double)(bytes_per_iteration) * (double)(iterations)) / seconds) / (1024.0 * 1024.0);
+	if (options->json)
+	{
+		printf("%s\n\t{ \"benchmark\": \"%s\", \"palette_format\": %u, \"size\": %u, \"count\": %u, \"variant\": \"%s\", \"iterations\": %llu, \"ns_per_iteration\": %.1f, \"items_per_second\": %.1f, \"mib_per_second\": %.2f }", msbtfont_bench_first_result ? "" : ",", benchmark, font->palette_format, font->size, font->count, variant, iterations, ns_per_iteration, items_per_second, mib_per_second);
+	}
+	else
+	{
+		printf("%s,%u,%u,%u,%s,%llu,%.1f,%.1f,%.2f\n", benchmark, font->palette_format, font->size, font->count, variant, iterations, ns_per_iteration, items_per_second, mib_per_second);
+	}
+	msbtfont_bench_first_result = 0;
+	fflush(stdout);
+}
+
+static int msbtfont_bench_create_font(msbtfont_bench_font *font, unsigned char palette_format, unsigned short size, unsigned int count)
+{
+	msbtfont_header_descriptor header_descriptor;
+	memset(&header_descriptor, 0, sizeof(header_descriptor));
+	header_descriptor.palette_format = palette_format;
+	header_descriptor.max_font_width = (unsigned char)(size - 1);
+	header_descriptor.max_font_height = (unsigned char)(size - 1);
+	header_descriptor.font_character_count = count;
+	if (msbtfont_create_header(&font->header, &header_descriptor) != MSBTFONT_SUCCESS)
+	{
+		return 0;
+	}
+	if (msbtfont_create_filedata(&font->header, &font->filedata) != MSBTFONT_SUCCESS || font->filedata.data == NULL)
+	{
+		return 0;
+	}
+	// Deterministic pseudo-random contents so every run measures the same data
+	unsigned int state = 0x12345678u ^ (palette_format * 131u) ^ (size * 7919u) ^ count;
+	for (size_t i = 0; i < font->filedata.size; ++i)
+	{
+		state = (state * 1103515245u) + 12345u;
+		font->filedata.data[i] = (unsigned char)(state >> 16);
+	}
+	font->palette_format = palette_format;
+	font->size = size;
+	font->count = count;
+	return 1;
+}
+
+static void msbtfont_bench_character_data(const msbtfont_bench_options *options, msbtfont_bench_font *font)
+{
+	size_t character_bytes = (((size_t)(font->palette_format) + 1) * font->size * font->size + 7) / 8;
+	unsigned char *character_data = malloc(character_bytes + 1);
+	unsigned long long iterations = 0;
+	double start = 0.0;
+	double elapsed = 0.0;
+	if (character_data == NULL)
+	{
+		return;
+	}
+	memset(character_data, 0, character_bytes + 1);
+	start = msbtfont_bench_now();
+	do
+	{
+		for (unsigned int i = 0; i < font->count; ++i)
+		{
+			msbtfont_load_font_character_data(&font->header, &font->filedata, character_data, i);
+		}
+		++iterations;
+		elapsed = msbtfont_bench_now() - start;
+	} while (elapsed < options->min_time);
+	msbtfont_bench_report(options, "load_font_character_data", font, "all", elapsed, iterations, font->count, character_bytes * font->count);
+	iterations = 0;
+	start = msbtfont_bench_now();
+	do
+	{
+		for (unsigned int i = 0; i < font->count; ++i)
+		{
+			msbtfont_store_font_character_data(&font->header, &font->filedata, character_data, i);
+		}
+		++iterations;
+		elapsed = msbtfont_bench_now() - start;
+	} while (elapsed < options->min_time);
+	msbtfont_bench_report(options, "store_font_character_data", font, "all", elapsed, iterations, font->count, character_bytes * font->count);
+	free(character_data);
+}
+
+static void msbtfont_bench_surface(const msbtfont_bench_options *options, msbtfont_bench_font *font)
+{
+	static const char *format_names[] = { "8", "16_8", "24_8", "32_8" };
+	static const char *origin_names[] = { "upperleft", "lowerleft" };
+	static const char *effect_names[] = { "bold", "outline", "shadow" };
+	static const msbtfont_effect_descriptor effect_descriptors[] =
+	{
+		{ 1, 0, 0, 0, 0, 0 },
+		{ 0, 1, 1, 0, 0, 0 },
+		{ 0, 0, 0, 1, 1, 1 }
+	};
+	unsigned int characters_per_row = (font->count < 256) ? font->count : 256;
+	msbtfont_surface_descriptor surface_descriptor;
+	unsigned long long iterations = 0;
+	double start = msbtfont_bench_now();
+	double elapsed = 0.0;
+	char variant[64];
+	do
+	{
+		msbtfont_get_surface_size(&font->header, &surface_descriptor.rect, characters_per_row);
+		++iterations;
+		elapsed = msbtfont_bench_now() - start;
+	} while (elapsed < options->min_time);
+	msbtfont_bench_report(options, "get_surface_size", font, "all", elapsed, iterations, 1, 0);
+	surface_descriptor.rect.x = 0;
+	surface_descriptor.rect.y = 0;
+	for (int format = MSBTFONT_SURFACE_FORMAT_8; format <= MSBTFONT_SURFACE_FORMAT_32_8; ++format)
+	{
+		surface_descriptor.format = (msbtfont_surface_format)(format);
+		size_t surface_size = msbtfont_get_surface_memory_requirement(&surface_descriptor);
+		if (surface_size == 0 || surface_size > options->max_memory)
+		{
+			continue;
+		}
+		unsigned char *surface_data = malloc(surface_size);
+		if (surface_data == NULL)
+		{
+			continue;
+		}
+		memset(surface_data, 0, surface_size);
+		for (int origin = MSBTFONT_SURFACE_ORIGIN_UPPERLEFT; origin <= MSBTFONT_SURFACE_ORIGIN_LOWERLEFT; ++origin)
+		{
+			surface_descriptor.origin = (msbtfont_surface_origin)(origin);
+			snprintf(variant, sizeof(variant), "%s_%s", format_names[format], origin_names[origin]);
+			iterations = 0;
+			start = msbtfont_bench_now();
+			do
+			{
+				msbtfont_copy_to_surface(&font->header, &font->filedata, characters_per_row, 0, &surface_descriptor, surface_data);
+				++iterations;
+				elapsed = msbtfont_bench_now() - start;
+			} while (elapsed < options->min_time);
+			msbtfont_bench_report(options, "copy_to_surface", font, variant, elapsed, iterations, font->count, surface_size);
+			for (size_t effect = 0; effect < sizeof(effect_descriptors) / sizeof(effect_descriptors[0]); ++effect)
+			{
+				snprintf(variant, sizeof(variant), "%s_%s_%s", format_names[format], origin_names[origin], effect_names[effect]);
+				iterations = 0;
+				start = msbtfont_bench_now();
+				do
+				{
+					msbtfont_copy_to_surface_with_effects(&font->header, &font->filedata, characters_per_row, 0, &surface_descriptor, &effect_descriptors[effect], surface_data);
+					++iterations;
+					elapsed = msbtfont_bench_now() - start;
+				} while (elapsed < options->min_time);
+				msbtfont_bench_report(options, "copy_to_surface_with_effects", font, variant, elapsed, iterations, font->count, surface_size);
+			}
+		}
+		free(surface_data);
+	}
+}
+
+// Terminal-style grid of 200x60 cells on a 32-bit surface:  a full redraw, then frames that
+// change 1% of the cells (measured with the previous frame for damage tracking).
+static void msbtfont_bench_cells(const msbtfont_bench_options *options, msbtfont_bench_font *font)
+{
+	const unsigned int columns = 200;
+	const unsigned int rows = 60;
+	size_t cell_count = (size_t)(columns) * rows;
+	msbtfont_surface_descriptor surface_descriptor;
+	surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_32_8;
+	surface_descriptor.origin = MSBTFONT_SURFACE_ORIGIN_UPPERLEFT;
+	surface_descriptor.rect.width = columns * font->size;
+	surface_descriptor.rect.height = rows * font->size;
+	surface_descriptor.rect.x = 0;
+	surface_descriptor.rect.y = 0;
+	size_t surface_size = msbtfont_get_surface_memory_requirement(&surface_descriptor);
+	if (surface_size == 0 || surface_size > options->max_memory)
+	{
+		return;
+	}
+	unsigned char *surface_data = malloc(surface_size);
+	msbtfont_cell *cells = malloc(cell_count * sizeof(msbtfont_cell));
+	msbtfont_cell *previous_cells = malloc(cell_count * sizeof(msbtfont_cell));
+	unsigned int rect_count = 0;
+	unsigned int state = 0x9E3779B9u;
+	unsigned long long iterations = 0;
+	double start = 0.0;
+	double elapsed = 0.0;
+	if (surface_data == NULL || cells == NULL || previous_cells == NULL)
+	{
+		free(surface_data);
+		free(cells);
+		free(previous_cells);
+		return;
+	}
+	for (size_t i = 0; i < cell_count; ++i)
+	{
+		state = (state * 1103515245u) + 12345u;
+		cells[i].character = (state >> 8) % font->count;
+		cells[i].foreground = 0xFFC0C0C0u;
+		cells[i].background = ((state >> 4) & 7) ? 0xFF000000u : 0xFF800000u;
+	}
+	start = msbtfont_bench_now();
+	do
+	{
+		msbtfont_render_cells(&font->header, &font->filedata, columns, rows, cells, NULL, &surface_descriptor, surface_data, NULL, 0, &rect_count);
+		++iterations;
+		elapsed = msbtfont_bench_now() - start;
+	} while (elapsed < options->min_time);
+	msbtfont_bench_report(options, "render_cells", font, "full", elapsed, iterations, cell_count, surface_size);
+	memcpy(previous_cells, cells, cell_count * sizeof(msbtfont_cell));
+	iterations = 0;
+	start = msbtfont_bench_now();
+	do
+	{
+		for (size_t i = 0; i < cell_count / 100; ++i)
+		{
+			state = (state * 1103515245u) + 12345u;
+			cells[(state >> 8) % cell_count].character = (state >> 4) % font->count;
+		}
+		msbtfont_render_cells(&font->header, &font->filedata, columns, rows, cells, previous_cells, &surface_descriptor, surface_data, NULL, 0, &rect_count);
+		++iterations;
+		elapsed = msbtfont_bench_now() - start;
+	} while (elapsed < options->min_time);
+	msbtfont_bench_report(options, "render_cells", font, "damaged_1pct", elapsed, iterations, cell_count / 100, 0);
+	free(surface_data);
+	free(cells);
+	free(previous_cells);
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned short sizes[] = { 8, 16, 32, 64 };
+	static const unsigned int counts[] = { 256, 4096, 65536 };
+	msbtfont_bench_options options;
+	options.json = 0;
+	options.quick = 0;
+	options.max_memory = (size_t)(256) * 1024 * 1024;
+	options.min_time = 0.05;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+		{
+			options.json = 1;
+		}
+		else if (strcmp(argv[i], "--quick") == 0)
+		{
+			options.quick = 1;
+			options.min_time = 0.001;
+		}
+		else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc)
+		{
+			options.max_memory = (size_t)(strtoul(argv[++i], NULL, 10)) * 1024 * 1024;
+		}
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+		{
+			options.min_time = strtod(argv[++i], NULL) / 1000.0;
+		}
+		else
+		{
+			fprintf(stderr, "Usage:  %s [--json] [--quick] [--max-memory <MiB>] [--min-time <ms>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (options.json)
+	{
+		printf("[");
+	}
+	else
+	{
+		printf("benchmark,palette_format,size,count,variant,iterations,ns_per_iteration,items_per_second,mib_per_second\n");
+	}
+	for (unsigned char palette_format = 0; palette_format < 8; ++palette_format)
+	{
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+		{
+			for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+			{
+				msbtfont_bench_font font;
+				size_t font_data_size = ((((size_t)(palette_format) + 1) * sizes[s] * sizes[s] * counts[c]) + 7) / 8;
+				if (options.quick && c > 0)
+				{
+					continue;
+				}
+				if (font_data_size > options.max_memory)
+				{
+					continue;
+				}
+				if (!msbtfont_bench_create_font(&font, palette_format, sizes[s], counts[c]))
+				{
+					fprintf(stderr, "Failed to create a font (palette format %u, size %u, count %u)\n", palette_format, sizes[s], counts[c]);
+					continue;
+				}
+				msbtfont_bench_character_data(&options, &font);
+				msbtfont_bench_surface(&options, &font);
+				msbtfont_bench_cells(&options, &font);
+				msbtfont_delete_filedata(&font.filedata);
+			}
+		}
+	}
+	if (options.json)
+	{
+		printf("\n]\n");
+	}
+	return 0;
+}
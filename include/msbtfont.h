@@ -10,6 +10,25 @@
  * Useful applications include bitmap font editors (for producing MisbitFont files),
  * games, emulators, fantasy computers/consoles, and more. 
  *
+ * Thread safety:  The library keeps no hidden state besides the global allocator and the
+ * per-thread stats.  Functions that take a header or file data as const never write to them,
+ * so a font (header plus file data, including fonts retrieved from a collection) can be shared
+ * by any number of threads as long as nothing modifies it at the same time.  This covers
+ * 'msbtfont_load_font_character_data', 'msbtfont_copy_to_surface' (with or without effects),
+ * 'msbtfont_render_cells', 'msbtfont_get_surface_size', 'msbtfont_validate_filedata',
+ * 'msbtfont_prefetch_characters' and reading from a source font with
+ * 'msbtfont_repack_characters'.  Every scratch buffer is local to the call.  Functions that
+ * modify a font ('msbtfont_store_font_character_data', 'msbtfont_copy_from_surface', writing
+ * to a destination font with 'msbtfont_repack_characters', 'msbtfont_update_surface' (which
+ * clears the dirty bits), 'msbtfont_delete_filedata', etc.) need exclusive access to it,
+ * except that 'msbtfont_repack_characters' and 'msbtfont_store_font_characters' may write
+ * different ranges of the same font from several threads as documented there.  Surfaces follow
+ * the same rules: separate threads may copy into separate surfaces (or separate regions of one
+ * surface that don't share a byte).  Paged file data has a mutable cache and must only be
+ * used by one thread at a time (its own prefetch worker is synchronized internally).
+ * 'msbtfont_set_allocator' should be called before other threads start using the library.
+ * Stats are per thread.
+ *
  */
 
 #ifndef _MSBTFONT_H_
@@ -31,6 +50,9 @@
 extern "C"
 {
 #endif
+#define MSBTFONT_FLAG_VARIABLE_WIDTH 0x01 // File data starts with a variable table (one width per character)
+#define MSBTFONT_FLAG_DEDUPLICATED 0x02 // Characters share glyphs through a glyph table (see 'msbtfont_deduplicate'); Not part of the 0.1 specifications
+
 typedef struct msbtfont_header
 {
 	unsigned int magicword_le; // MSBT Magic Word in Little Endian
@@ -55,20 +77,41 @@ typedef struct msbtfont_header
 	unsigned char language[64]; // Uses UTF-8; Optional
 } msbtfont_header;
 
+typedef struct msbtfont_allocator
+{
+	void *(*alloc)(void *user_data, size_t size, size_t alignment); // Must return memory aligned to at least 'alignment' bytes, or NULL on failure
+	void *(*realloc)(void *user_data, void *ptr, size_t old_size, size_t new_size, size_t alignment); // Optional; Used when the library resizes memory it owns (emulated with alloc and free if NULL)
+	void (*free)(void *user_data, void *ptr, size_t size);
+	void *user_data; // Passed back to every callback (arena, pool, heap handle, etc.)
+} msbtfont_allocator;
+
+struct msbtfont_dirty_tracker; // Opaque; Created and freed by 'msbtfont_track_dirty_characters'
+
 typedef struct msbtfont_filedata
 {
 	unsigned char *data;
 	unsigned char *variable_table;
 	unsigned char *font_data;
 	size_t size;
+	msbtfont_allocator allocator; // Allocator used by 'msbtfont_create_filedata' (used again by 'msbtfont_delete_filedata')
+	unsigned char *glyph_table; // Deduplicated fonts only:  Glyph count followed by the glyph of every character (32-bit little endian values); Otherwise NULL
+	struct msbtfont_dirty_tracker *dirty_tracker; // Characters stored since the last 'msbtfont_update_surface' (see 'msbtfont_track_dirty_characters'); Owned by the library
+	unsigned int dirty_tracker_key; // Set by the library along with 'dirty_tracker', which is ignored unless both match (so stray values are never followed)
 } msbtfont_filedata;
 
+// Empty file data.  File data filled in by hand (rather than by 'msbtfont_create_filedata',
+// 'msbtfont_adopt_filedata', etc.) should start from this (or be zeroed):  The dirty tracker
+// is ignored unless the library set it up, but 'allocator' is used by the functions that make
+// new memory from a font and 'glyph_table' by deduplicated fonts.
+// Usage:  msbtfont_filedata filedata = MSBTFONT_FILEDATA_INIT;
+#define MSBTFONT_FILEDATA_INIT { NULL, NULL, NULL, 0, { NULL, NULL, NULL, NULL }, NULL, NULL, 0 }
+
 typedef struct msbtfont_rect
 {
-	unsigned short width;
-	unsigned short height;
-	unsigned short x;
-	unsigned short y;
+	unsigned int width;
+	unsigned int height;
+	unsigned int x;
+	unsigned int y;
 } msbtfont_rect;
 
 typedef enum 
@@ -104,9 +147,64 @@ typedef enum
 	MSBTFONT_MISSING_SURFACE_DATA = -13,
 	MSBTFONT_NO_SURFACE_AREA = -14,
 	MSBTFONT_UNSUPPORTED_SURFACE_FORMAT = -15,
-	MSBTFONT_MISSING_DESTINATION_DATA = -16
+	MSBTFONT_MISSING_DESTINATION_DATA = -16,
+	MSBTFONT_INVALID_EFFECT = -17,
+	MSBTFONT_INCOMPATIBLE_FONTS = -18,
+	MSBTFONT_INVALID_MODE = -19,
+	MSBTFONT_MISSING_STATS = -20,
+	MSBTFONT_FEATURE_DISABLED = -21,
+	MSBTFONT_INVALID_FILEDATA = -22,
+	MSBTFONT_FONT_TOO_LARGE = -23,
+	MSBTFONT_MISSING_SIZE = -24,
+	MSBTFONT_OUT_OF_MEMORY = -25,
+	MSBTFONT_SURFACE_TOO_LARGE = -26,
+	MSBTFONT_MISSING_ALLOCATOR = -27,
+	MSBTFONT_INVALID_ALLOCATOR = -28,
+	MSBTFONT_MISSING_COLLECTION = -29,
+	MSBTFONT_INVALID_COLLECTION = -30,
+	MSBTFONT_MISSING_READER = -31,
+	MSBTFONT_READ_FAILED = -32,
+	MSBTFONT_THREAD_FAILED = -33,
+	MSBTFONT_MISSING_STATUS = -34,
+	MSBTFONT_DEDUPLICATED_FONT = -35,
+	MSBTFONT_SURFACE_BUFFER_TOO_SMALL = -36 // Only reported by the C++ interface ('msbtfont.hpp'), which knows the size of the surface buffer
 } msbtfont_retcode;
 
+typedef enum
+{
+	MSBTFONT_REPACK_THRESHOLD, // Splits the source range into equally sized buckets when reducing bits (truncates); Same as MSBTFONT_REPACK_SCALE when widening
+	MSBTFONT_REPACK_SCALE, // Scales each value to the nearest destination value
+	MSBTFONT_REPACK_ORDERED_DITHER // Scales each value using a 4x4 ordered dither matrix over the character's pixels
+} msbtfont_repack_mode;
+
+typedef enum
+{
+	MSBTFONT_FILEDATA_ZEROED, // Variable table is set to the maximum width and font data is cleared
+	MSBTFONT_FILEDATA_LAZY_ZEROED, // Same contents as zeroed, but lets the system hand out zero pages on first touch when possible
+	MSBTFONT_FILEDATA_UNINITIALIZED // Nothing is written; the caller overwrites every byte (e.g. when reading a file); Stores never write the pad bits after the last character
+} msbtfont_filedata_initialization;
+
+typedef enum
+{
+	MSBTFONT_STATS_STORE_FONT_CHARACTER_DATA, // Includes 'msbtfont_store_font_characters'
+	MSBTFONT_STATS_LOAD_FONT_CHARACTER_DATA,
+	MSBTFONT_STATS_GET_SURFACE_SIZE,
+	MSBTFONT_STATS_COPY_TO_SURFACE, // Includes 'msbtfont_copy_to_surface_with_effects', 'msbtfont_copy_to_surface_clipped' and 'msbtfont_blend_to_surface'
+	MSBTFONT_STATS_COPY_FROM_SURFACE,
+	MSBTFONT_STATS_REPACK, // Counts 'msbtfont_repack_characters' (which 'msbtfont_repack' also uses)
+	MSBTFONT_STATS_RENDER_CELLS,
+	MSBTFONT_STATS_FUNCTION_COUNT
+} msbtfont_stats_function;
+
+typedef struct msbtfont_stats
+{
+	unsigned long long calls[MSBTFONT_STATS_FUNCTION_COUNT]; // Number of calls per function
+	unsigned long long cycles[MSBTFONT_STATS_FUNCTION_COUNT]; // Time spent in successful calls per function (CPU timestamp counter ticks on x86, nanoseconds elsewhere)
+	unsigned long long characters_decoded; // Characters decoded from font data
+	unsigned long long pixels_written; // Pixels written to surfaces
+	unsigned long long font_data_bytes_read; // Bytes read from font data
+} msbtfont_stats;
+
 typedef struct msbtfont_header_descriptor
 {
 	unsigned char palette_format;
@@ -125,6 +223,142 @@ typedef struct msbtfont_surface_descriptor
 	msbtfont_surface_origin origin;
 } msbtfont_surface_descriptor;
 
+#define MSBTFONT_MAX_EFFECT_RADIUS 8
+
+// Effects never draw outside the character cell:  Every effect is clipped to it instead of
+// being rendered into a cell padded by the effect radius, so fonts meant for effects should
+// reserve blank margins (at least the bold strength on the right, and the outline thickness or
+// shadow offset on the affected sides).
+typedef struct msbtfont_effect_descriptor
+{
+	unsigned char bold; // Synthetic bold strength in pixels (horizontal dilation towards the right only, so glyphs grow to the right); 0 = Disabled
+	unsigned char outline; // Outline thickness in pixels; Clipped to the character cell, so glyphs touching the cell edge lose that side of the outline; 0 = Disabled
+	unsigned char outline_index; // Palette index written to outline pixels
+	unsigned char shadow_index; // Palette index written to shadow pixels
+	signed char shadow_x; // Shadow offset on the X axis; Shadow is disabled if both offsets are 0, and is clipped to the character cell (it never spills into neighboring cells)
+	signed char shadow_y; // Shadow offset on the Y axis (towards the bottom of the character)
+} msbtfont_effect_descriptor;
+
+typedef enum
+{
+	MSBTFONT_BLEND_ALPHA_OVER, // Composites the color over the surface with the coverage times the alpha of the color
+	MSBTFONT_BLEND_ADDITIVE, // Adds the color times the coverage and its alpha to the surface (saturating)
+	MSBTFONT_BLEND_COLORIZE // Replaces surface pixels with the color, its alpha multiplied by the coverage
+} msbtfont_blend_mode;
+
+typedef struct msbtfont_blend_descriptor
+{
+	msbtfont_blend_mode mode;
+	unsigned int color; // Color in the byte order of the surface (least significant byte first), with the alpha in the last byte
+} msbtfont_blend_descriptor;
+
+typedef struct msbtfont_cell
+{
+	unsigned int character; // Index of the character drawn in the cell; Indices past the font character count leave the cell blank
+	unsigned int foreground; // Pixel written where the character is fully set (least significant byte first in memory)
+	unsigned int background; // Pixel written where the character is clear (least significant byte first in memory)
+} msbtfont_cell;
+
+typedef struct msbtfont_collection_header
+{
+	unsigned int magicword_le; // MSBC Magic Word in Little Endian
+	struct
+	{
+		unsigned short major;
+		unsigned short minor;
+	} version_le; // Version in Little Endian
+	unsigned int magicword_be; // MSBC Magic Word in Big Endian
+	struct
+	{
+		unsigned short major;
+		unsigned short minor;
+	} version_be; // Version in Big Endian
+	unsigned int font_count_le; // Font Count in Little Endian
+	unsigned int font_count_be; // Font Count in Big Endian
+} msbtfont_collection_header;
+
+typedef struct msbtfont_collection_entry
+{
+	unsigned long long offset_le; // Offset of the font's file data from the start of the collection in Little Endian
+	unsigned long long offset_be; // Offset of the font's file data from the start of the collection in Big Endian
+	unsigned long long size_le; // Size of the font's file data in Little Endian
+	unsigned long long size_be; // Size of the font's file data in Big Endian
+	msbtfont_header header;
+	unsigned int reserved; // Keeps entries 8 byte aligned; Always 0
+} msbtfont_collection_entry;
+
+typedef struct msbtfont_collection
+{
+	const unsigned char *data; // Entire collection (typically a memory mapped file)
+	size_t size;
+	unsigned int font_count;
+	unsigned char foreign; // Non-zero if the collection was built on a host with the other byte order
+} msbtfont_collection;
+
+typedef struct msbtfont_reader
+{
+	size_t (*read)(void *user_data, void *buffer, size_t size, unsigned long long offset); // Reads 'size' bytes starting at 'offset' of the source; Returns the number of bytes read; May be called from two threads at once (see 'msbtfont_schedule_paged_prefetch')
+	void (*close)(void *user_data); // Optional; Called by 'msbtfont_close_paged_filedata'
+	void *user_data; // Passed back to every callback (file handle, archive entry, etc.)
+} msbtfont_reader;
+
+struct msbtfont_page_cache;
+
+typedef struct msbtfont_paged_filedata
+{
+	unsigned char *variable_table; // Loaded when the paged file data is opened; NULL if the header doesn't use it
+	msbtfont_reader reader;
+	unsigned long long font_data_offset; // Offset of the font data within the reader's source
+	unsigned long long font_data_size;
+	size_t page_size;
+	unsigned int max_resident_pages;
+	unsigned int resident_pages; // Number of pages currently held in the cache; Written by the prefetch worker, so read it with 'msbtfont_get_paged_resident_pages' once prefetches are scheduled
+	msbtfont_allocator allocator;
+	struct msbtfont_page_cache *cache; // Internal
+} msbtfont_paged_filedata;
+
+typedef struct msbtfont_paged_filedata_descriptor
+{
+	const msbtfont_reader *reader; // Reader for the source; If NULL, 'path' is opened and read directly
+	const char *path; // Only used if 'reader' is NULL
+	unsigned long long offset; // Offset of the file data (variable table if used, then font data) within the source
+	size_t page_size; // Size of each cached page in bytes; 0 = 65536
+	unsigned int max_resident_pages; // Maximum number of pages cached at once; 0 = 64
+	const msbtfont_allocator *allocator; // Allocator for the cache; If NULL, the global allocator is used
+} msbtfont_paged_filedata_descriptor;
+
+/**
+ *  Function:  msbtfont_set_allocator
+ *
+ *  Description:  Sets the global allocator used for every allocation made by the library when
+ *  no allocator is given explicitly.  The allocator is copied.  File data remembers the
+ *  allocator it was created with, so changing the global allocator doesn't affect how
+ *  existing file data is freed.  Not thread-safe; set it up before using the library from
+ *  multiple threads.  The library never requests an alignment above 16 bytes.
+ *
+ *  Parameters:
+ *  	allocator = Pointer to an existing MisbitFont allocator structure.  'alloc' and 'free' must not be NULL.  If NULL, the default allocator (malloc, realloc and free) is restored.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Successfully set the global allocator.
+ *  	MSBTFONT_INVALID_ALLOCATOR = Either 'alloc' or 'free' was NULL.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_set_allocator(const msbtfont_allocator *allocator);
+
+/**
+ *  Function:  msbtfont_get_allocator
+ *
+ *  Description:  Retrieves a copy of the current global allocator.
+ *
+ *  Parameters:
+ *  	allocator = Pointer to an existing MisbitFont allocator structure that receives the global allocator.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Successfully retrieved the global allocator.
+ *  	MSBTFONT_MISSING_ALLOCATOR = Pointer to a MisbitFont allocator structure was not provided.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_allocator(msbtfont_allocator *allocator);
+
 /**
  *  Function:  msbtfont_create_header
  *
@@ -144,6 +378,28 @@ typedef struct msbtfont_surface_descriptor
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_header(msbtfont_header *header, const msbtfont_header_descriptor *header_descriptor);
 
+/**
+ *  Function:  msbtfont_normalize_header
+ *
+ *  Description:  Prepares a header read straight from a MisbitFont file for use on this
+ *  platform.  Every header stores its multi-byte fields in both little endian and big endian
+ *  form, but only the form matching the platform is used by the rest of the library.  This
+ *  function rebuilds the native form from the foreign one when only the foreign form is valid
+ *  (and vice versa), so the conversion happens once instead of on every call.  Call it once
+ *  after reading a header from a file.  Headers made by 'msbtfont_create_header' are already
+ *  normalized.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Header was successfully normalized.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Neither magic word is valid, so this isn't a MisbitFont header.
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Invalid palette format was found in the header (outside the 0-7 range).
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_normalize_header(msbtfont_header *header);
+
 /**
  *  Function:  msbtfont_create_filedata
  *
@@ -152,6 +408,9 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_header(msbtfont_header *he
  *  successful.  A variable spacing size table pointer is also provided if the header happens
  *  to be using the variable spacing type.  Make sure to call 'msbtfont_delete_filedata' when
  *  you're done with this data to prevent memory leaks.
+ *  The header has to be in native byte order:  Headers read from a file go through
+ *  'msbtfont_normalize_header' first, otherwise a header stored with the other byte order
+ *  (TBSM) is rejected.
  *
  *  Parameters:
  *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL as it is necessary to setup the file data properly.
@@ -161,15 +420,90 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_header(msbtfont_header *he
  *  	MSBTFONT_SUCCESS = Successfully initialized MisbitFont file data structure.
  *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
  *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
- *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Invalid palette format was found in the header (outside the 0-7 range).
+ *  	MSBTFONT_FONT_TOO_LARGE = Font described by the header doesn't fit in the address space of this platform.
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for the file data couldn't be allocated.
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated; Its size depends on its glyph table, so the file data has to come from 'msbtfont_deduplicate' or 'msbtfont_adopt_filedata'.
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_filedata(const msbtfont_header *header, msbtfont_filedata *filedata);
 
+/**
+ *  Function:  msbtfont_create_filedata_with_allocator
+ *
+ *  Description:  Works exactly like 'msbtfont_create_filedata', but allocates the memory with
+ *  the given allocator instead of the global one.  'msbtfont_delete_filedata' frees it with the
+ *  same allocator.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL as it is necessary to setup the file data properly.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL.
+ *  	allocator = Pointer to an existing MisbitFont allocator structure.  The allocator is copied into the file data.  If NULL, the global allocator is used.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_create_filedata', plus:
+ *  	MSBTFONT_INVALID_ALLOCATOR = Either 'alloc' or 'free' was NULL.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_filedata_with_allocator(const msbtfont_header *header, msbtfont_filedata *filedata, const msbtfont_allocator *allocator);
+
+/**
+ *  Function:  msbtfont_create_filedata_with_initialization
+ *
+ *  Description:  Works like 'msbtfont_create_filedata_with_allocator', but lets you choose how
+ *  the new memory is prepared.  Loaders that read the whole file data straight from disk should
+ *  use MSBTFONT_FILEDATA_UNINITIALIZED so that large fonts aren't written twice.  Filling it
+ *  through the store functions instead leaves the pad bits after the last character in the
+ *  final byte of font data as they were, so clear that byte first if the file data is saved
+ *  (otherwise the saved file holds whatever was in memory).
+ *  MSBTFONT_FILEDATA_LAZY_ZEROED only avoids the clear with the default allocator (through
+ *  calloc); with any other allocator it behaves like MSBTFONT_FILEDATA_ZEROED.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL as it is necessary to setup the file data properly.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL.
+ *  	allocator = Pointer to an existing MisbitFont allocator structure.  The allocator is copied into the file data.  If NULL, the global allocator is used.
+ *  	initialization = How the file data is prepared (see 'msbtfont_filedata_initialization').
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_create_filedata_with_allocator', plus:
+ *  	MSBTFONT_INVALID_MODE = Initialization mode is not one of the supported values.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_filedata_with_initialization(const msbtfont_header *header, msbtfont_filedata *filedata, const msbtfont_allocator *allocator, msbtfont_filedata_initialization initialization);
+
+/**
+ *  Function:  msbtfont_adopt_filedata
+ *
+ *  Description:  Sets up a MisbitFont file data structure around a buffer you already have (a
+ *  memory mapped file, a buffer you read the file into, an embedded array, etc.) without
+ *  copying it.  The variable table (if the header has one) and font data pointers are placed
+ *  the same way 'msbtfont_create_filedata' would place them, and the result is checked with
+ *  'msbtfont_validate_filedata'.  The file data structure is left untouched on failure.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL.
+ *  	data = Pointer to the buffer holding the variable table (if any) followed by the font data.  Must not be NULL.
+ *  	size = Size of the buffer in bytes.
+ *  	allocator = Allocator that owns the buffer, used by 'msbtfont_delete_filedata' to free it.  If NULL, the buffer is only borrowed and 'msbtfont_delete_filedata' won't free it (it must outlive the file data).
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = File data now refers to the buffer.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_MISSING_SOURCE_DATA = Pointer to the buffer was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Header is not a native-endian MisbitFont header.
+ *  	MSBTFONT_INVALID_ALLOCATOR = Either 'alloc' or 'free' was NULL.
+ *  	MSBTFONT_INVALID_FILEDATA = Buffer is too small for the font described by the header.
+ *  	MSBTFONT_FONT_TOO_LARGE = Font described by the header doesn't fit in the address space of this platform.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_adopt_filedata(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned char *data, size_t size, const msbtfont_allocator *allocator);
+
 /**
  *  Function:  msbtfont_delete_filedata
  *
  *  Description:  Frees file data from an existing MisbitFont file data structure.  You should
- *  call this function if 'msbtfont_create_filedata' was used to create that data.  Resets
+ *  call this function if 'msbtfont_create_filedata' was used to create that data.  Memory is
+ *  freed with the allocator stored in the file data (if its 'free' is NULL, free() is used).  Resets
  *  the data (if successfully freed), variable_table (if not NULL) and font_data pointers
  *  to NULL automatically.
  *
@@ -183,11 +517,62 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_create_filedata(const msbtfont_he
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata *filedata);
 
+/**
+ *  Function:  msbtfont_get_filedata_size
+ *
+ *  Description:  Retrieves the number of bytes of file data (variable spacing table plus font
+ *  data) that follow the header in a MisbitFont file.  Useful for knowing how much to read from
+ *  a file before setting up file data yourself.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *  	size = Pointer to a variable that receives the size in bytes.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Successfully retrieved the size.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_SIZE = Pointer to a size variable was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Invalid palette format was found in the header (outside the 0-7 range).
+ *  	MSBTFONT_FONT_TOO_LARGE = Size doesn't fit in the address space of this platform.
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated; Its size depends on its glyph table.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_filedata_size(const msbtfont_header *header, size_t *size);
+
+/**
+ *  Function:  msbtfont_validate_filedata
+ *
+ *  Description:  Checks that file data is consistent with a header:  the palette format is
+ *  valid, and the variable spacing table (if used) and font data both lie entirely inside
+ *  'data' according to 'size'.  Every function that reads or writes font data performs the
+ *  font data part of this check, so fonts from untrusted sources can't cause out of bounds
+ *  accesses as long as 'data' really holds 'size' bytes.  Call this once after setting up file
+ *  data from a file yourself (starting from MSBTFONT_FILEDATA_INIT, so the fields you don't set
+ *  are zero).
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = File data is consistent with the header.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Invalid palette format was found in the header (outside the 0-7 range).
+ *  	MSBTFONT_FONT_TOO_LARGE = Font described by the header doesn't fit in the address space of this platform.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header, or its pointers lie outside 'data'.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_validate_filedata(const msbtfont_header *header, const msbtfont_filedata *filedata);
+
 /**
  *  Function:  msbtfont_store_font_character_data
  *
  *  Description:  Stores font character data for a single character from application memory
  *  straight to the file data; guided by the header in order to ensure proper storage.
+ *  Like every function taking a header, it only reads the native copy of the header fields,
+ *  so call 'msbtfont_normalize_header' on a header read from a file before storing.
  *
  *  Parameters:
  *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL in order to ensure proper storage.
@@ -200,17 +585,52 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata
  *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
  *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
  *  	MSBTFONT_MISSING_SOURCE_DATA = Pointer to source data was not provided.
- *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
  *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
  *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Index provided was outside the range (greater than or equal to the font character count).
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated; Its characters share glyphs and can't be stored individually.
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_store_font_character_data(const msbtfont_header *header, msbtfont_filedata *filedata, const unsigned char *srcdata, unsigned int index);
 
+/**
+ *  Function:  msbtfont_store_font_characters
+ *
+ *  Description:  Stores font character data for a range of consecutive characters in one go.
+ *  The source data holds the characters back to back exactly as they appear in the font data
+ *  (the first character starting at the first bit), so the whole range is copied at once
+ *  instead of one character at a time.  Separate ranges of the same font can be stored from
+ *  several threads at the same time as long as every range starts and ends on a character
+ *  index that is a multiple of 8 (or the end of the font).
+ *  Headers read from a file must be normalized first (see 'msbtfont_normalize_header').
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL in order to ensure proper storage.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL in order to store any kind of data.
+ *  	srcdata = Pointer to the packed characters to store.  Must not be NULL in order to copy data.
+ *  	first_index = Index of the first character to store.
+ *  	count = Number of characters to store.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Font character data was successfully stored.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_MISSING_SOURCE_DATA = Pointer to source data was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Range provided goes past the font character count.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated; Its characters share glyphs and can't be stored individually.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_store_font_characters(const msbtfont_header *header, msbtfont_filedata *filedata, const unsigned char *srcdata, unsigned int first_index, unsigned int count);
+
 /**
  *  Function:  msbtfont_load_font_character_data
  *
  *  Description:  Loads font character data for a single character from file data to
  *  application memory; guided by the header in order to ensure proper storage.
+ *  Only the native copy of the header fields is used, so a header read from a file must go
+ *  through 'msbtfont_normalize_header' before loading (TBSM headers are rejected).
  *
  *  Parameters:
  *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL in order to ensure proper storage.
@@ -223,9 +643,10 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_store_font_character_data(const m
  *	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
  *	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
  *	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to destination data was not provided.
- *	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check.
+ *	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
  *	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
  *	MSBTFONT_INDEX_OUT_OF_BOUNDS = Index provided as outside the range (greater than or equal to the font character count).
+ *	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_load_font_character_data(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned char *dstdata, unsigned int index);
 
@@ -235,6 +656,7 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_load_font_character_data(const ms
  *  Description:  Retrieves the dimensions of a possible surface based on the font data and
  *  the number of characters per row.  Useful for surface creation and copying data back to
  *  the surface. 
+ *  Headers read from a file must be normalized first (see 'msbtfont_normalize_header').
  *
  *  Parameters:
  *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL in order to properly retrieve the dimensions of a possible surface.
@@ -245,8 +667,9 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_load_font_character_data(const ms
  *  	MSBTFONT_NO_ERROR = Successfully able to retrieve surface size data.
  *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
  *  	MSBTFONT_MISSING_RECT = Pointer to a MisbitFont rect structure was not provided for 'surface_size'.
- *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
  *  	MSBTFONT_NO_CHARACTERS = Characters per row was set to 0.
+ *  	MSBTFONT_SURFACE_TOO_LARGE = Width or height of the surface would exceed the range of an unsigned int.
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_surface_size(const msbtfont_header *header, msbtfont_rect *surface_size, unsigned int characters_per_row);
 
@@ -262,7 +685,7 @@ extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_surface_size(const msbtfont_h
  *  	surface_descriptor = Pointer to an existing surface descriptor (created either statically or dynamically).  Must not be NULL in order to properly retrieve memory size data.
  *
  *  Returns:
- *  	Surface memory required to allocate.  Otherwise, it's 0 if an invalid or no surface descriptor was provided.
+ *  	Surface memory required to allocate.  Otherwise, it's 0 if an invalid or no surface descriptor was provided, or if the surface is too large to be addressed on this platform.
  **/
 extern MSBTFONT_SPEC size_t msbtfont_get_surface_memory_requirement(const msbtfont_surface_descriptor *surface_descriptor);
 
@@ -274,6 +697,8 @@ extern MSBTFONT_SPEC size_t msbtfont_get_surface_memory_requirement(const msbtfo
  *  proper copying (conversion if necessary).  You can also specify the origin for different
  *  coordinate systems.  You can copy anywhere on the surface by specifying the coordinates
  *  within the surface descriptor.
+ *  The header must be in native byte order; Call 'msbtfont_normalize_header' on headers read
+ *  from a file (including fonts written on a platform with the other byte order) first.
  *
  *  Parameters:
  *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
@@ -289,13 +714,853 @@ extern MSBTFONT_SPEC size_t msbtfont_get_surface_memory_requirement(const msbtfo
  *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
  *  	MSBTFONT_MISSING_SURFACE_DESCRIPTOR = Pointer to a surface descriptor was not provided.
  *  	MSBTFONT_MISSING_SURFACE_DATA = Pointer to surface data was not provided.
- *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check or wasn't normalized to the native byte order (see 'msbtfont_normalize_header').
  *  	MSBTFONT_NO_SURFACE_AREA = There is no surface to copy due to either 0 width or height on the surface descriptor.
  *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structre was not initialized.
  *  	MSBTFONT_UNSUPPORTED_SURFACE_FORMAT = Surface format supplied by the descriptor is currently unsupported or invalid.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
  **/
 extern MSBTFONT_SPEC msbtfont_retcode msbtfont_copy_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data);
 
+/**
+ *  Function:  msbtfont_copy_to_surface_with_effects
+ *
+ *  Description:  Works exactly like 'msbtfont_copy_to_surface', but applies optional effect
+ *  stages while copying.  Effects are computed on the fly from the packed font character data
+ *  and are applied in this order:  synthetic bold (horizontal dilation, to the right only),
+ *  outline and drop shadow.  Glyph pixels are drawn over outline pixels, which are drawn over
+ *  shadow pixels.  All effects are clipped to the character cell (nothing spills into the
+ *  neighboring pixels), so fonts should reserve blank margins for them.  Works with any
+ *  palette format.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL in order to retrieve (and convert if necessary).
+ *  	characters_per_row = Number of characters per row in the surface.  If 0 is specified, it will fill based on the available width of the surface.
+ *  	character_start_offset = If 'characters_per_row' is non-zero, this shifts the starting position by a number of characters.  Otherwise, it does nothing.
+ *  	surface_descriptor = Pointer to an existing surface descriptor (created either statically or dynamically).  Must not be NULL in order to ensure proper copying (and conversion if necessary).
+ *  	effect_descriptor = Pointer to an existing effect descriptor (created either statically or dynamically).  If NULL, this behaves the same as 'msbtfont_copy_to_surface'.  Every radius and offset must be within MSBTFONT_MAX_EFFECT_RADIUS.
+ *  	surface_data = Pointer to an existing surface (created either statically or dynamically).  Must not be NULL in order to store data onto the surface.  Must also make sure there is enough memory before storage.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_copy_to_surface', plus:
+ *  	MSBTFONT_INVALID_EFFECT = An effect radius or offset in the effect descriptor exceeds MSBTFONT_MAX_EFFECT_RADIUS.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_copy_to_surface_with_effects(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, unsigned char *surface_data);
+
+/**
+ *  Function:  msbtfont_copy_to_surface_clipped
+ *
+ *  Description:  Works exactly like 'msbtfont_copy_to_surface_with_effects', but only writes
+ *  the pixels inside a clip rect and leaves the rest of the surface untouched, so part of a
+ *  surface (such as a damaged or newly scrolled in area) can be redrawn without paying for
+ *  the rest of the font.  Rows and columns of characters that miss the clip rect are skipped
+ *  without being visited, and only the visible span of each remaining character is decoded.
+ *  Effects are still computed from the whole character cell, so the clipped pixels match
+ *  those of a full copy.  Like the rects of 'msbtfont_update_surface', the clip rect
+ *  addresses the surface data directly:  'y' is the first row in memory, even with
+ *  MSBTFONT_SURFACE_ORIGIN_LOWERLEFT.  Parts of the clip rect outside the surface are ignored.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	characters_per_row = Same as for 'msbtfont_copy_to_surface'.
+ *  	character_start_offset = Same as for 'msbtfont_copy_to_surface'.
+ *  	surface_descriptor = Pointer to an existing surface descriptor.  Must not be NULL.
+ *  	effect_descriptor = Pointer to an existing effect descriptor, or NULL to copy without effects.
+ *  	clip_rect = Pointer to the area of the surface to write.  If NULL, the whole surface is written.
+ *  	surface_data = Pointer to an existing surface.  Must not be NULL.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_copy_to_surface_with_effects'.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_copy_to_surface_clipped(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, const msbtfont_rect *clip_rect, unsigned char *surface_data);
+
+/**
+ *  Function:  msbtfont_blend_to_surface
+ *
+ *  Description:  Works like 'msbtfont_copy_to_surface_clipped', but composites a color into
+ *  a 32-bit surface (RGBA, BGRA or any other order with the alpha in the last byte of each
+ *  pixel) instead of writing palette indices, so text can be drawn over an existing image in
+ *  place.  The palette index of each pixel is treated as coverage (0 = none, the highest
+ *  index of the palette format = full) and multiplied by the alpha of the color:
+ *  	MSBTFONT_BLEND_ALPHA_OVER = Source over blending (straight alpha).  Pixels without coverage are left untouched.
+ *  	MSBTFONT_BLEND_ADDITIVE = Adds the weighted color to each component, saturating at 255 (the alpha component adds the weight).  Pixels without coverage are left untouched.
+ *  	MSBTFONT_BLEND_COLORIZE = Writes the color with its alpha multiplied by the coverage to every pixel of the visible cells, producing a colored glyph mask.
+ *  Effect indices ('outline_index' and 'shadow_index') above the highest palette index count
+ *  as full coverage.  Uses SSE2 where the compiler targets it.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	characters_per_row = Same as for 'msbtfont_copy_to_surface'.
+ *  	character_start_offset = Same as for 'msbtfont_copy_to_surface'.
+ *  	surface_descriptor = Pointer to an existing surface descriptor.  Must not be NULL.  The format must be MSBTFONT_SURFACE_FORMAT_32_8 when blending.
+ *  	effect_descriptor = Pointer to an existing effect descriptor, or NULL to copy without effects.
+ *  	blend_descriptor = Pointer to an existing blend descriptor.  If NULL, this behaves the same as 'msbtfont_copy_to_surface_clipped'.
+ *  	clip_rect = Pointer to the area of the surface to write (see 'msbtfont_copy_to_surface_clipped').  If NULL, the whole surface is written.
+ *  	surface_data = Pointer to an existing surface.  Must not be NULL.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_copy_to_surface_with_effects', plus:
+ *  	MSBTFONT_INVALID_MODE = Invalid blend mode was provided.
+ *  	MSBTFONT_UNSUPPORTED_SURFACE_FORMAT = Also returned when blending into a surface whose format isn't MSBTFONT_SURFACE_FORMAT_32_8.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_blend_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, const msbtfont_blend_descriptor *blend_descriptor, const msbtfont_rect *clip_rect, unsigned char *surface_data);
+
+/**
+ *  Function:  msbtfont_track_dirty_characters
+ *
+ *  Description:  Turns tracking of stored characters on or off for a font, so a surface made
+ *  with 'msbtfont_copy_to_surface' can be kept up to date with 'msbtfont_update_surface'
+ *  instead of being copied again after every edit.  While tracking is on, every character
+ *  written by 'msbtfont_store_font_character_data', 'msbtfont_store_font_characters',
+ *  'msbtfont_copy_from_surface' or 'msbtfont_repack_characters' (as the destination) is marked
+ *  dirty in a bitset held by the file data ('dirty_tracker').  Changes made by writing to
+ *  the file data directly (such as the variable table) must be marked with
+ *  'msbtfont_mark_dirty_characters'.  Enabling clears every bit (call it right after copying
+ *  the whole font), and disabling frees the bitset, as does 'msbtfont_delete_filedata'.  The
+ *  bitset is allocated with the allocator of the file data (the global allocator for
+ *  borrowed file data and for file data without an allocator, such as embedded fonts or file
+ *  data set up from MSBTFONT_FILEDATA_INIT), and always freed with the allocator it came from.
+ *  Enabling tracking again after the character count changed resizes the bitset.  The tracker is only used while
+ *  'dirty_tracker_key' matches it, so a stray tracker in file data that was never zeroed is
+ *  ignored (never written to or freed).
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	enable = Non-zero to start (or restart) tracking, 0 to stop.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Tracking was successfully turned on or off.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for the bitset couldn't be allocated.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_track_dirty_characters(const msbtfont_header *header, msbtfont_filedata *filedata, int enable);
+
+/**
+ *  Function:  msbtfont_mark_dirty_characters
+ *
+ *  Description:  Marks a range of characters dirty so the next 'msbtfont_update_surface'
+ *  copies them again.  Only needed for changes the library can't see, such as edits to the
+ *  variable table or writes straight into the font data.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	first_index = Index of the first character to mark.
+ *  	count = Number of characters to mark.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Characters were successfully marked.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Tracking is not turned on for this file data (see 'msbtfont_track_dirty_characters').
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Range provided goes past the font character count.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_mark_dirty_characters(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int first_index, unsigned int count);
+
+/**
+ *  Function:  msbtfont_update_surface
+ *
+ *  Description:  Copies only the dirty characters (see 'msbtfont_track_dirty_characters') to
+ *  a surface previously filled by 'msbtfont_copy_to_surface' or
+ *  'msbtfont_copy_to_surface_with_effects' with the same layout parameters, then clears their
+ *  dirty bits.  Each character lands in the same cell the full copy puts it in, so the
+ *  surface ends up identical to copying the whole font again, while the cost depends on the
+ *  number of edited characters rather than the size of the font.  The areas that were
+ *  written are returned as rects (dirty characters next to each other in a row share one
+ *  rect), ready to be uploaded to a texture or redrawn.  Rect coordinates address the
+ *  surface data directly:  'y' is the first row in memory, even with
+ *  MSBTFONT_SURFACE_ORIGIN_LOWERLEFT.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure with tracking turned on.  Must not be NULL.
+ *  	characters_per_row = Same as for 'msbtfont_copy_to_surface'.
+ *  	character_start_offset = Same as for 'msbtfont_copy_to_surface'.
+ *  	surface_descriptor = Pointer to the surface descriptor used for the full copy.  Must not be NULL.
+ *  	effect_descriptor = Pointer to the effect descriptor used for the full copy, or NULL if it was made without effects.
+ *  	surface_data = Pointer to the surface.  Must not be NULL.
+ *  	rects = Array receiving the updated areas.  Can only be NULL if 'capacity' is 0.
+ *  	capacity = Number of rects 'rects' can hold.  Rects past it are counted but not written (the characters are still copied).
+ *  	rect_count = Pointer to an unsigned int that receives the number of updated areas (which may exceed 'capacity').  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Dirty characters were successfully copied.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the rect count was not provided, or 'rects' was NULL with a non-zero capacity.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = File data was not initialized, or tracking is not turned on for it.
+ *  	Same as 'msbtfont_copy_to_surface_with_effects' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_update_surface(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, unsigned char *surface_data, msbtfont_rect *rects, unsigned int capacity, unsigned int *rect_count);
+
+/**
+ *  Function:  msbtfont_render_cells
+ *
+ *  Description:  Draws a grid of character cells (such as the screen of a terminal) into a
+ *  surface, with a foreground and background color per cell.  Cell (column, row) is placed
+ *  at 'rect.x + column * width', 'rect.y + row * height' of the surface (counting rows from
+ *  the origin, like 'msbtfont_copy_to_surface' with 'columns' characters per row).  The
+ *  cells are drawn straight from the packed font data:  every pixel of the cell becomes the
+ *  background color where the character is clear, the foreground color where it uses the
+ *  highest palette index, and a per-byte blend of both in between.  Colors are whole surface
+ *  pixels (1 to 4 bytes depending on the surface format, least significant byte first), so
+ *  RGBA and BGRA surfaces work the same way.  Variable widths are ignored (every cell is the
+ *  full character width).
+ *
+ *  If 'previous_cells' is provided, only the cells that differ from it are drawn (unchanged
+ *  rows are skipped with a single comparison) and every drawn cell is copied into it, so it
+ *  can be kept as the previous frame between calls.  The areas that were drawn are returned
+ *  as rects (damaged cells next to each other in a row share one rect), addressed like the
+ *  rects of 'msbtfont_update_surface'.  Cells outside the surface are clipped; Cells that
+ *  are entirely outside it are not drawn and keep their entry in 'previous_cells', so they
+ *  are drawn by a later call once they are visible (on a larger surface, for example).
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	columns = Number of cells per row.
+ *  	rows = Number of rows of cells.
+ *  	cells = Array of 'columns * rows' cells, row by row.  Can only be NULL if there are no cells.
+ *  	previous_cells = Array of 'columns * rows' cells holding the previous frame, or NULL to draw every cell.  Must not overlap 'cells'.
+ *  	surface_descriptor = Pointer to an existing surface descriptor.  Must not be NULL.
+ *  	surface_data = Pointer to the surface.  Must not be NULL.
+ *  	rects = Array receiving the drawn areas.  Can only be NULL if 'capacity' is 0.
+ *  	capacity = Number of rects 'rects' can hold.  Rects past it are counted but not written (the cells are still drawn).
+ *  	rect_count = Pointer to an unsigned int that receives the number of drawn areas (which may exceed 'capacity').  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Cells were successfully drawn.
+ *  	MSBTFONT_MISSING_SOURCE_DATA = Pointer to the cells was not provided.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the rect count was not provided, or 'rects' was NULL with a non-zero capacity.
+ *  	Same as 'msbtfont_copy_to_surface' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_render_cells(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int columns, unsigned int rows, const msbtfont_cell *cells, msbtfont_cell *previous_cells, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data, msbtfont_rect *rects, unsigned int capacity, unsigned int *rect_count);
+
+/**
+ *  Function:  msbtfont_copy_from_surface
+ *
+ *  Description:  The inverse of 'msbtfont_copy_to_surface'.  Reads font character data from
+ *  a surface laid out the same way (same characters per row, start offset, surface format and
+ *  origin) and packs all of it straight into the file data in one call.  Surface values are
+ *  treated as palette indices and values above the highest index of the palette format are
+ *  clamped to it.  Characters that are partially outside the surface only have their visible
+ *  pixels stored.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure (created either statically or dynamically).  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure (created either statically or dynamically).  Must not be NULL in order to store any kind of data.
+ *  	characters_per_row = Number of characters per row in the surface.  If 0 is specified, it will read based on the available width of the surface.
+ *  	character_start_offset = If 'characters_per_row' is non-zero, this shifts the starting position by a number of characters.  Otherwise, it does nothing.
+ *  	surface_descriptor = Pointer to an existing surface descriptor (created either statically or dynamically).  Must not be NULL in order to properly read the surface.
+ *  	surface_data = Pointer to an existing surface (created either statically or dynamically).  Must not be NULL in order to read data from the surface.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Font character data was successfully stored.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_MISSING_SURFACE_DESCRIPTOR = Pointer to a surface descriptor was not provided.
+ *  	MSBTFONT_MISSING_SURFACE_DATA = Pointer to surface data was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_NO_SURFACE_AREA = There is no surface to read due to either 0 width or height on the surface descriptor.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_UNSUPPORTED_SURFACE_FORMAT = Surface format supplied by the descriptor is currently unsupported or invalid.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated; Its characters share glyphs and can't be stored individually.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_copy_from_surface(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const unsigned char *surface_data);
+
+/**
+ *  Function:  msbtfont_repack
+ *
+ *  Description:  Converts an entire font to a different palette format.  The destination
+ *  header and file data are created automatically (the header is a copy of the source header
+ *  using the new palette format, and the variable spacing table is copied as well).  Pixels are
+ *  streamed straight from one bit depth to the other without going through individual
+ *  characters.  The destination file data is allocated with the allocator of the source file
+ *  data, or the global allocator if the source file data is borrowed or embedded (use
+ *  'msbtfont_create_filedata_with_allocator' and 'msbtfont_repack_characters' for a specific
+ *  one).  The destination header and file data are only written if the conversion succeeds.
+ *  Make sure to call 'msbtfont_delete_filedata' on the destination file data when you're done
+ *  with it.
+ *
+ *  Parameters:
+ *  	src_header = Pointer to the header of the font to convert.  Must not be NULL.
+ *  	src_filedata = Pointer to the file data of the font to convert.  Must not be NULL.
+ *  	dst_header = Pointer to an existing MisbitFont header structure that receives the converted header.  Must not be NULL.
+ *  	dst_filedata = Pointer to an existing MisbitFont file data structure that receives the converted data.  Must not be NULL.
+ *  	dst_palette_format = Palette format to convert to (0-7).
+ *  	mode = How values are converted between bit depths.  Only matters if the palette formats differ.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Font was successfully converted.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to one of the MisbitFont header structures was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to one of the MisbitFont file data structures was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid source header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Source MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Invalid destination palette format was provided (outside the 0-7 range).
+ *  	MSBTFONT_INVALID_MODE = Invalid repack mode was provided.
+ *  	MSBTFONT_INVALID_FILEDATA = Source file data is too small for the source header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = Source font is deduplicated.
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for the destination file data couldn't be allocated.
+ *  	Same as 'msbtfont_create_filedata' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_repack(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, msbtfont_header *dst_header, msbtfont_filedata *dst_filedata, unsigned char dst_palette_format, msbtfont_repack_mode mode);
+
+/**
+ *  Function:  msbtfont_repack_characters
+ *
+ *  Description:  Converts a range of characters from one font into another font that only
+ *  differs by palette format (for example, one created by 'msbtfont_repack').  Useful for
+ *  splitting large conversions across threads:  separate ranges can be converted at the same
+ *  time as long as every range starts and ends on a character index that is a multiple of 8
+ *  (or the end of the font), since those never share a byte of destination font data.
+ *
+ *  Parameters:
+ *  	src_header = Pointer to the header of the font to convert.  Must not be NULL.
+ *  	src_filedata = Pointer to the file data of the font to convert.  Must not be NULL.
+ *  	dst_header = Pointer to the header of the destination font.  Must not be NULL.
+ *  	dst_filedata = Pointer to the file data of the destination font.  Must not be NULL.
+ *  	mode = How values are converted between bit depths.  Only matters if the palette formats differ.
+ *  	first_index = Index of the first character to convert.
+ *  	count = Number of characters to convert.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Characters were successfully converted.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to one of the MisbitFont header structures was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to one of the MisbitFont file data structures was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = One of the MisbitFont file data structures was not initialized.
+ *  	MSBTFONT_INCOMPATIBLE_FONTS = Fonts differ in max font width, max font height or font character count.
+ *  	MSBTFONT_INVALID_MODE = Invalid repack mode was provided.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Range provided goes past the font character count.
+ *  	MSBTFONT_INVALID_FILEDATA = One of the file data structures is too small for its header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = One of the fonts is deduplicated.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_repack_characters(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, const msbtfont_header *dst_header, msbtfont_filedata *dst_filedata, msbtfont_repack_mode mode, unsigned int first_index, unsigned int count);
+
+/**
+ *  Function:  msbtfont_deduplicate
+ *
+ *  Description:  Creates a deduplicated copy of a font, where characters with identical pixels
+ *  share a single glyph.  The destination header is a copy of the source header with the
+ *  MSBTFONT_FLAG_DEDUPLICATED flag set, and the destination file data holds the variable table
+ *  (if used), a glyph table mapping every character to its glyph, and the font data of the
+ *  unique glyphs only.  Duplicates are found by hashing the packed pixels of every character.
+ *  Deduplicated fonts can be loaded, copied to surfaces (see also
+ *  'msbtfont_copy_glyphs_to_surface') and validated like any other font, but can't be
+ *  modified, repacked, paged or put in a collection (those functions return
+ *  MSBTFONT_DEDUPLICATED_FONT).  The destination file data (and the work memory) is allocated
+ *  with the allocator of the source file data, or the global allocator if the source file data
+ *  is borrowed (see 'msbtfont_adopt_filedata') or embedded.  Make sure to call
+ *  'msbtfont_delete_filedata' on it when you're done with it.
+ *
+ *  Parameters:
+ *  	src_header = Pointer to the header of the font to deduplicate.  Must not be NULL.
+ *  	src_filedata = Pointer to the file data of the font to deduplicate.  Must not be NULL.
+ *  	dst_header = Pointer to an existing MisbitFont header structure that receives the deduplicated header.  Must not be NULL.
+ *  	dst_filedata = Pointer to an existing MisbitFont file data structure that receives the deduplicated data.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Font was successfully deduplicated.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to one of the MisbitFont header structures was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to one of the MisbitFont file data structures was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid source header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Source MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INVALID_FILEDATA = Source file data is too small for the source header (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_DEDUPLICATED_FONT = Source font is already deduplicated.
+ *  	MSBTFONT_OUT_OF_MEMORY = Allocation failed.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_deduplicate(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, msbtfont_header *dst_header, msbtfont_filedata *dst_filedata);
+
+/**
+ *  Function:  msbtfont_get_glyph_count
+ *
+ *  Description:  Retrieves the number of glyphs (unique character bitmaps) in a font.  This is
+ *  the font character count unless the font is deduplicated.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	glyph_count = Pointer to an unsigned int that receives the glyph count.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Glyph count was successfully retrieved.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the glyph count was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header (see 'msbtfont_validate_filedata').
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_glyph_count(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int *glyph_count);
+
+/**
+ *  Function:  msbtfont_get_glyph_index
+ *
+ *  Description:  Retrieves the glyph holding the pixels of a character.  This is the character
+ *  index itself unless the font is deduplicated.  Glyphs are placed in the order used by
+ *  'msbtfont_copy_glyphs_to_surface', so this also gives a character's cell in such an atlas.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	index = Index to a certain font character (provided it is less than the font character count).
+ *  	glyph_index = Pointer to an unsigned int that receives the glyph index.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Glyph index was successfully retrieved.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the glyph index was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Invalid header was provided, more than likely failed a magic word check (see 'msbtfont_normalize_header').
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Index provided was outside the range (greater than or equal to the font character count).
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header, or the glyph table refers to a glyph that doesn't exist (see 'msbtfont_validate_filedata').
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_glyph_index(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int index, unsigned int *glyph_index);
+
+/**
+ *  Function:  msbtfont_get_glyph_surface_size
+ *
+ *  Description:  Same as 'msbtfont_get_surface_size', but for a surface holding every glyph
+ *  once (see 'msbtfont_copy_glyphs_to_surface').  For deduplicated fonts this is smaller than
+ *  a surface holding every character.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	surface_size = Pointer to an existing MisbitFont rect structure.  Must not be NULL.  Retrieves only the width and height.
+ *  	glyphs_per_row = Number of glyphs per row in the possible surface.  Must be at least 1.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_get_glyph_count' and 'msbtfont_get_surface_size'.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_glyph_surface_size(const msbtfont_header *header, const msbtfont_filedata *filedata, msbtfont_rect *surface_size, unsigned int glyphs_per_row);
+
+/**
+ *  Function:  msbtfont_copy_glyphs_to_surface
+ *
+ *  Description:  Same as 'msbtfont_copy_to_surface', but copies every glyph once instead of
+ *  every character, so characters sharing a glyph in a deduplicated font share a cell of the
+ *  surface.  Use 'msbtfont_get_glyph_index' to find the cell of a character.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	glyphs_per_row = Number of glyphs per row in the surface.  If 0 is specified, it will copy based on the available width of the surface.
+ *  	glyph_start_offset = If 'glyphs_per_row' is non-zero, this shifts the starting position by a number of glyphs.  Otherwise, it does nothing.
+ *  	surface_descriptor = Pointer to an existing surface descriptor.  Must not be NULL.
+ *  	surface_data = Pointer to an existing surface.  Must not be NULL.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_copy_to_surface'.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_copy_glyphs_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int glyphs_per_row, unsigned int glyph_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data);
+
+/**
+ *  Function:  msbtfont_hash_font
+ *
+ *  Description:  Computes a 64-bit content hash of a font, suitable as a cache key for the font
+ *  and anything derived from it (atlases, repacked copies, etc.).  The hash covers the palette
+ *  format, character size, character count and flags of the header plus the variable table,
+ *  glyph table and font data, and is the same on every host.  The font name and language are
+ *  not included.  A deduplicated copy of a font hashes differently from the original; Use
+ *  'msbtfont_hash_characters' when characters need to be compared independently of how they
+ *  are stored.  The hash is XXH64, which reads the data in large blocks and is limited by
+ *  memory bandwidth rather than computation on most processors.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	hash = Pointer to an unsigned long long that receives the hash.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Hash was successfully computed.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the hash was not provided.
+ *  	Same as 'msbtfont_get_glyph_count' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_hash_font(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned long long *hash);
+
+/**
+ *  Function:  msbtfont_hash_characters
+ *
+ *  Description:  Computes a 64-bit hash of each character in a range, covering its pixels and
+ *  its width.  Characters with identical pixels and widths hash the same, whether they are in
+ *  the same font or not and whether the font is deduplicated or not, so the hashes can key
+ *  per-character caches (atlas cells, rendered text, etc.).  Memory for unpacking characters
+ *  comes from the allocator of the file data (the global allocator for borrowed or embedded
+ *  file data).
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	first_index = Index of the first character to hash.
+ *  	count = Number of characters to hash.
+ *  	hashes = Array of 'count' unsigned long longs that receives the hashes.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Hashes were successfully computed.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Array for the hashes was not provided.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Range provided goes past the font character count.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the header, or the glyph table refers to a glyph that doesn't exist (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for unpacking characters couldn't be allocated.
+ *  	Same as 'msbtfont_get_glyph_count' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_hash_characters(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int first_index, unsigned int count, unsigned long long *hashes);
+
+/**
+ *  Function:  msbtfont_diff_fonts
+ *
+ *  Description:  Finds the characters that differ (in pixels or width) between two fonts with
+ *  the same palette format and character size, such as two versions of the same font.  This
+ *  tells an application which cells of an atlas need to be copied again after a font changes.
+ *  Characters only one of the fonts has are reported as changed.  Fonts that both store every
+ *  character are compared eight characters (one run of whole bytes) at a time, so unchanged
+ *  parts of a font cost little more than a memory comparison.  Either font may be
+ *  deduplicated.  Memory for unpacking characters comes from the allocator of the first
+ *  font's file data (the global allocator for borrowed or embedded file data).
+ *
+ *  Parameters:
+ *  	header_a = Pointer to the header of the first font.  Must not be NULL.
+ *  	filedata_a = Pointer to the file data of the first font.  Must not be NULL.
+ *  	header_b = Pointer to the header of the second font.  Must not be NULL.
+ *  	filedata_b = Pointer to the file data of the second font.  Must not be NULL.
+ *  	changed_indices = Array receiving the indices of the changed characters in ascending order.  Can only be NULL if 'capacity' is 0.
+ *  	capacity = Number of indices 'changed_indices' can hold.  Indices past it are counted but not written.
+ *  	changed_count = Pointer to an unsigned int that receives the number of changed characters (which may exceed 'capacity').  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Fonts were successfully compared.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the changed count was not provided, or 'changed_indices' was NULL with a non-zero capacity.
+ *  	MSBTFONT_INCOMPATIBLE_FONTS = Fonts differ in palette format, max font width or max font height.
+ *  	MSBTFONT_INVALID_FILEDATA = One of the file data structures is too small for its header, or a glyph table refers to a glyph that doesn't exist (see 'msbtfont_validate_filedata').
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for unpacking characters couldn't be allocated.
+ *  	Same as 'msbtfont_get_glyph_count' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_diff_fonts(const msbtfont_header *header_a, const msbtfont_filedata *filedata_a, const msbtfont_header *header_b, const msbtfont_filedata *filedata_b, unsigned int *changed_indices, unsigned int capacity, unsigned int *changed_count);
+
+/**
+ *  Function:  msbtfont_get_collection_size
+ *
+ *  Description:  Gets the size in bytes of a font collection holding the given fonts, which is
+ *  what 'msbtfont_build_collection' needs.  A collection is a collection header, followed by one
+ *  entry (a copy of the font's header plus the offset and size of its file data) per font,
+ *  followed by the file data of every font aligned to 16 bytes.
+ *
+ *  Parameters:
+ *  	headers = Array of 'font_count' MisbitFont header structures.  Must not be NULL.
+ *  	font_count = Number of fonts.
+ *  	size = Pointer to receive the size in bytes.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Size was successfully computed.
+ *  	MSBTFONT_MISSING_HEADER = Array of MisbitFont header structures was not provided.
+ *  	MSBTFONT_MISSING_SIZE = Pointer to receive the size was not provided.
+ *  	MSBTFONT_INVALID_HEADER = One of the headers is not a native-endian MisbitFont header.
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = One of the headers has a palette format above 7.
+ *  	MSBTFONT_FONT_TOO_LARGE = Collection doesn't fit in the address space of this platform.
+ *  	MSBTFONT_DEDUPLICATED_FONT = One of the headers describes a deduplicated font.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_collection_size(const msbtfont_header *headers, unsigned int font_count, size_t *size);
+
+/**
+ *  Function:  msbtfont_build_collection
+ *
+ *  Description:  Writes a font collection holding the given fonts into 'data', which can then
+ *  be saved as a single file.  Each font's variable table (if any) and font data are copied
+ *  as is.  Use 'msbtfont_get_collection_size' to find out how large 'data' needs to be.
+ *
+ *  Parameters:
+ *  	headers = Array of 'font_count' MisbitFont header structures.  Must not be NULL.
+ *  	filedata = Array of 'font_count' MisbitFont file data structures matching 'headers'.  Must not be NULL.
+ *  	font_count = Number of fonts.
+ *  	data = Pointer to the destination buffer.  Must not be NULL.
+ *  	size = Size of the destination buffer in bytes.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Collection was successfully written.
+ *  	MSBTFONT_MISSING_FILEDATA = Array of MisbitFont file data structures was not provided.
+ *  	MSBTFONT_MISSING_DESTINATION_DATA = Pointer to the destination buffer was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = One of the file data structures was not initialized.
+ *  	MSBTFONT_INVALID_FILEDATA = One of the file data structures is too small for its header, or the destination buffer is too small.
+ *  	Same as 'msbtfont_get_collection_size' otherwise.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_build_collection(const msbtfont_header *headers, const msbtfont_filedata *filedata, unsigned int font_count, unsigned char *data, size_t size);
+
+/**
+ *  Function:  msbtfont_open_collection
+ *
+ *  Description:  Sets up a MisbitFont collection structure for a collection already in memory
+ *  (typically a memory mapped file).  Only the collection header and the table of entries are
+ *  checked, and nothing is copied, so opening is cheap regardless of how many fonts there are.
+ *  Individual fonts are checked when they are retrieved with 'msbtfont_get_collection_font'.
+ *  Collections built on a host with the other byte order are supported.  The memory must
+ *  outlive the collection and any font retrieved from it.
+ *
+ *  Parameters:
+ *  	collection = Pointer to an existing MisbitFont collection structure.  Must not be NULL.
+ *  	data = Pointer to the collection.  Must not be NULL.
+ *  	size = Size of the collection in bytes.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Collection was successfully opened.
+ *  	MSBTFONT_MISSING_COLLECTION = Pointer to a MisbitFont collection structure was not provided.
+ *  	MSBTFONT_MISSING_SOURCE_DATA = Pointer to the collection was not provided.
+ *  	MSBTFONT_INVALID_COLLECTION = Data is not a MisbitFont collection, or it is truncated.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_open_collection(msbtfont_collection *collection, const unsigned char *data, size_t size);
+
+/**
+ *  Function:  msbtfont_get_collection_font
+ *
+ *  Description:  Retrieves one font from an opened collection.  The header is copied (and
+ *  normalized for this host) and the file data refers directly to the collection's memory, so
+ *  no font data is copied or allocated.  Calling 'msbtfont_delete_filedata' on it is allowed but
+ *  never frees anything.  If the collection's memory is read only, the font must not be
+ *  modified.
+ *
+ *  Parameters:
+ *  	collection = Pointer to an opened MisbitFont collection structure.  Must not be NULL.
+ *  	index = Index of the font within the collection.
+ *  	header = Pointer to receive the font's header.  Must not be NULL.
+ *  	filedata = Pointer to receive the font's file data.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Font was successfully retrieved.
+ *  	MSBTFONT_MISSING_COLLECTION = Pointer to a MisbitFont collection structure was not provided.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = Index is not below the collection's font count.
+ *  	MSBTFONT_INVALID_COLLECTION = Entry points outside of the collection.
+ *  	MSBTFONT_INVALID_HEADER = Entry's header is not a valid MisbitFont header.
+ *  	MSBTFONT_INVALID_FILEDATA = Entry's file data is too small for its header.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_collection_font(const msbtfont_collection *collection, unsigned int index, msbtfont_header *header, msbtfont_filedata *filedata);
+
+/**
+ *  Function:  msbtfont_open_paged_filedata
+ *
+ *  Description:  Sets up file data that isn't loaded into memory up front.  Font data is read
+ *  through the reader in fixed-size pages the first time a character on that page is needed,
+ *  and the least recently used page is dropped once 'max_resident_pages' pages are cached, so
+ *  memory use follows the characters actually used instead of the size of the font.  The
+ *  variable table (if used) is small and read immediately.  If no reader is given, the file at
+ *  'path' is opened and read with pread (or the C library on platforms without it).  For a
+ *  regular MisbitFont file, 'offset' is the size of the header.  Paged file data must not be
+ *  used by more than one thread at a time.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	paged_filedata = Pointer to an existing MisbitFont paged file data structure.  Must not be NULL.
+ *  	descriptor = Pointer to an existing MisbitFont paged file data descriptor structure.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Paged file data is ready to use.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_MISSING_READER = Neither a reader (with a 'read' function) nor a path was provided.
+ *  	MSBTFONT_INVALID_HEADER = Header is not a native-endian MisbitFont header.
+ *  	MSBTFONT_INVALID_PALETTE_FORMAT = Header has a palette format above 7.
+ *  	MSBTFONT_INVALID_ALLOCATOR = Either 'alloc' or 'free' was NULL.
+ *  	MSBTFONT_FONT_TOO_LARGE = Font described by the header doesn't fit in the address space of this platform.
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for the cache couldn't be allocated.
+ *  	MSBTFONT_DEDUPLICATED_FONT = Font is deduplicated.
+ *  	MSBTFONT_READ_FAILED = File couldn't be opened or the variable table couldn't be read.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_open_paged_filedata(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, const msbtfont_paged_filedata_descriptor *descriptor);
+
+/**
+ *  Function:  msbtfont_close_paged_filedata
+ *
+ *  Description:  Frees the cache of paged file data and closes its reader (if the reader has a
+ *  'close' function, or if the file was opened from a path).
+ *
+ *  Parameters:
+ *  	paged_filedata = Pointer to an existing MisbitFont paged file data structure.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Paged file data was successfully closed.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Paged file data was not opened.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_close_paged_filedata(msbtfont_paged_filedata *paged_filedata);
+
+/**
+ *  Function:  msbtfont_load_paged_font_character_data
+ *
+ *  Description:  Works exactly like 'msbtfont_load_font_character_data', but for paged file
+ *  data.  Pages holding the character are read if they aren't cached yet.
+ *
+ *  Parameters:
+ *  	header = Pointer to the MisbitFont header structure the paged file data was opened with.  Must not be NULL.
+ *  	paged_filedata = Pointer to an opened MisbitFont paged file data structure.  Must not be NULL.
+ *  	dstdata = Pointer to the destination buffer.  Must not be NULL.
+ *  	index = Index of the character to load.
+ *
+ *  Returns:
+ *  	Same as 'msbtfont_load_font_character_data', plus:
+ *  	MSBTFONT_READ_FAILED = A page couldn't be read.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_load_paged_font_character_data(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned char *dstdata, unsigned int index);
+
+/**
+ *  Function:  msbtfont_prefetch_paged_characters
+ *
+ *  Description:  Hints that a range of characters is about to be used by reading the pages
+ *  holding them into the cache now.  Only as many pages as the cache can hold are read, starting
+ *  from the beginning of the range.  Useful for warming up a script's block of characters before
+ *  rendering starts.
+ *
+ *  Parameters:
+ *  	header = Pointer to the MisbitFont header structure the paged file data was opened with.  Must not be NULL.
+ *  	paged_filedata = Pointer to an opened MisbitFont paged file data structure.  Must not be NULL.
+ *  	first_index = Index of the first character in the range.
+ *  	count = Number of characters in the range (clamped to the end of the font).
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Pages were successfully read (or were already cached).
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Paged file data was not opened.
+ *  	MSBTFONT_INVALID_HEADER = Header is not a native-endian MisbitFont header.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = First index is not below the font's character count.
+ *  	MSBTFONT_READ_FAILED = A page couldn't be read.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_prefetch_paged_characters(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned int first_index, unsigned int count);
+
+/**
+ *  Function:  msbtfont_schedule_paged_prefetch
+ *
+ *  Description:  Works like 'msbtfont_prefetch_paged_characters', but returns immediately and
+ *  reads the pages on a background worker owned by the paged file data instead.  Use it to warm
+ *  up characters for an upcoming screen without stalling the current frame.  The worker is
+ *  started by the first call and stopped by 'msbtfont_close_paged_filedata'; requests are
+ *  handled in the order they were scheduled.  Pages that fail to read are skipped (loading the
+ *  character later reports the error).  While the worker exists, the reader's 'read' function
+ *  may be called from the worker and from the loading thread at the same time, and the paged
+ *  file data structure must not be moved in memory.
+ *
+ *  Parameters:
+ *  	header = Pointer to the MisbitFont header structure the paged file data was opened with.  Must not be NULL.
+ *  	paged_filedata = Pointer to an opened MisbitFont paged file data structure.  Must not be NULL.
+ *  	first_index = Index of the first character in the range.
+ *  	count = Number of characters in the range (clamped to the end of the font).
+ *  	ticket = Pointer to receive a ticket for 'msbtfont_query_paged_prefetch'.  Can be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Prefetch was successfully scheduled.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Paged file data was not opened.
+ *  	MSBTFONT_INVALID_HEADER = Header is not a native-endian MisbitFont header.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = First index is not below the font's character count.
+ *  	MSBTFONT_OUT_OF_MEMORY = Memory for the worker or the request couldn't be allocated.
+ *  	MSBTFONT_THREAD_FAILED = Worker thread couldn't be started.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_schedule_paged_prefetch(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned int first_index, unsigned int count, unsigned long long *ticket);
+
+/**
+ *  Function:  msbtfont_query_paged_prefetch
+ *
+ *  Description:  Checks whether a prefetch scheduled with 'msbtfont_schedule_paged_prefetch'
+ *  (and every prefetch scheduled before it) has finished.  Never blocks on I/O.
+ *
+ *  Parameters:
+ *  	paged_filedata = Pointer to an opened MisbitFont paged file data structure.  Must not be NULL.
+ *  	ticket = Ticket returned by 'msbtfont_schedule_paged_prefetch'.
+ *  	complete = Pointer to receive 1 if the prefetch has finished, or 0 if it is still pending.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Status was successfully retrieved.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_MISSING_STATUS = Pointer to receive the status was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Paged file data was not opened.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_query_paged_prefetch(msbtfont_paged_filedata *paged_filedata, unsigned long long ticket, int *complete);
+
+/**
+ *  Function:  msbtfont_get_paged_resident_pages
+ *
+ *  Description:  Retrieves the number of pages currently held in the cache of paged file data.
+ *  Once a prefetch has been scheduled with 'msbtfont_schedule_paged_prefetch', the worker
+ *  thread updates the count at any time, so it must be read through this function (which takes
+ *  the cache lock) instead of the 'resident_pages' field.
+ *
+ *  Parameters:
+ *  	paged_filedata = Pointer to an opened MisbitFont paged file data structure.  Must not be NULL.
+ *  	resident_pages = Pointer to receive the number of cached pages.  Must not be NULL.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Count was successfully retrieved.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont paged file data structure was not provided.
+ *  	MSBTFONT_MISSING_STATUS = Pointer to receive the count was not provided.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = Paged file data was not opened.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_paged_resident_pages(msbtfont_paged_filedata *paged_filedata, unsigned int *resident_pages);
+
+/**
+ *  Function:  msbtfont_prefetch_characters
+ *
+ *  Description:  Hints that a range of characters is about to be used when the file data
+ *  refers to a memory mapped file (see 'msbtfont_adopt_filedata' and collections).  The system
+ *  is asked to start reading the pages holding those characters in the background
+ *  (posix_madvise with POSIX_MADV_WILLNEED, or PrefetchVirtualMemory on Windows), so the first
+ *  access doesn't stall on a page fault.  Returns immediately.  The hint has no effect on
+ *  memory that isn't mapped from a file.
+ *
+ *  Parameters:
+ *  	header = Pointer to an existing MisbitFont header structure.  Must not be NULL.
+ *  	filedata = Pointer to an existing MisbitFont file data structure.  Must not be NULL.
+ *  	first_index = Index of the first character in the range.
+ *  	count = Number of characters in the range (clamped to the end of the font).
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Hint was given.
+ *  	MSBTFONT_MISSING_HEADER = Pointer to a MisbitFont header structure was not provided.
+ *  	MSBTFONT_MISSING_FILEDATA = Pointer to a MisbitFont file data structure was not provided.
+ *  	MSBTFONT_INVALID_HEADER = Header is not a native-endian MisbitFont header.
+ *  	MSBTFONT_FILEDATA_NOT_INITIALIZED = MisbitFont file data structure was not initialized.
+ *  	MSBTFONT_INVALID_FILEDATA = File data is too small for the font described by the header.
+ *  	MSBTFONT_INDEX_OUT_OF_BOUNDS = First index is not below the font's character count.
+ *  	MSBTFONT_FEATURE_DISABLED = The system can't prefetch memory (Windows versions before Windows 8); Nothing was done.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_prefetch_characters(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int first_index, unsigned int count);
+
+/**
+ *  Function:  msbtfont_get_stats
+ *
+ *  Description:  Retrieves instrumentation counters for the calling thread.  Counters are
+ *  accumulated per thread so that instrumented calls never contend with each other, which means
+ *  each thread has to retrieve its own counters.  Only available if the library was built with
+ *  the MSBTFONT_ENABLE_STATS CMake option; otherwise the instrumentation is compiled out entirely.
+ *
+ *  Parameters:
+ *  	stats = Pointer to an existing MisbitFont stats structure (created either statically or dynamically).  Must not be NULL.  Zeroed if stats are disabled.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Successfully retrieved the counters.
+ *  	MSBTFONT_MISSING_STATS = Pointer to a MisbitFont stats structure was not provided.
+ *  	MSBTFONT_FEATURE_DISABLED = Library was built without stats support.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_get_stats(msbtfont_stats *stats);
+
+/**
+ *  Function:  msbtfont_reset_stats
+ *
+ *  Description:  Resets all instrumentation counters of the calling thread to 0.
+ *
+ *  Returns:
+ *  	MSBTFONT_SUCCESS = Successfully reset the counters.
+ *  	MSBTFONT_FEATURE_DISABLED = Library was built without stats support.
+ **/
+extern MSBTFONT_SPEC msbtfont_retcode msbtfont_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
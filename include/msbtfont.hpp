@@ -0,0 +1,598 @@
+/* MisbitFont Library V0.2.2 - C++ Interface
+ * By Joshua Moss
+ *
+ * Header-only C++17 interface on top of 'msbtfont.h'.  Fonts are move-only objects that
+ * free their file data automatically, glyph data is exposed through spans, and errors are
+ * reported with 'msbtfont::error' exceptions carrying the original 'msbtfont_retcode'.  Surface
+ * buffers smaller than the surface descriptor (or view) requires throw with
+ * MSBTFONT_SURFACE_BUFFER_TOO_SMALL before anything is written.
+ *
+ * 'msbtfont::blit<Format, Origin>' copies a single character into a surface with the surface
+ * format and origin fixed at compile time, so only the kernel you use is instantiated and no
+ * per-call format dispatch is left.  Pixels are written exactly like 'msbtfont_copy_to_surface'
+ * writes them (palette index in the first component of each surface pixel, rows padded to a
+ * multiple of 4 bytes).  Given a clip rect, it only decodes the part of the character inside it.
+ *
+ * The thread safety rules of 'msbtfont.h' apply unchanged.
+ *
+ */
+
+#ifndef _MSBTFONT_HPP_
+#define _MSBTFONT_HPP_
+
+#include "msbtfont.h"
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+namespace msbtfont
+{
+#if defined(__cpp_lib_span)
+	template <typename T>
+	using span = std::span<T>;
+#else
+	// Minimal stand-in for std::span (C++20) covering what this interface needs.
+	template <typename T>
+	class span
+	{
+	public:
+		constexpr span() noexcept : data_(nullptr), size_(0) { }
+		constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) { }
+		template <typename Container, typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container &>().data()), T *>>>
+		constexpr span(Container &container) noexcept : data_(container.data()), size_(container.size()) { }
+		template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+		constexpr span(const span<U> &other) noexcept : data_(other.data()), size_(other.size()) { }
+
+		constexpr T *data() const noexcept { return data_; }
+		constexpr std::size_t size() const noexcept { return size_; }
+		constexpr bool empty() const noexcept { return size_ == 0; }
+		constexpr T *begin() const noexcept { return data_; }
+		constexpr T *end() const noexcept { return data_ + size_; }
+		constexpr T &operator[](std::size_t index) const noexcept { return data_[index]; }
+		constexpr span subspan(std::size_t offset, std::size_t count) const noexcept { return span(data_ + offset, count); }
+
+	private:
+		T *data_;
+		std::size_t size_;
+	};
+#endif
+
+	class error : public std::runtime_error
+	{
+	public:
+		explicit error(msbtfont_retcode code) : std::runtime_error("msbtfont error " + std::to_string(static_cast<int>(code))), code_(code) { }
+
+		msbtfont_retcode code() const noexcept { return code_; }
+
+	private:
+		msbtfont_retcode code_;
+	};
+
+	namespace detail
+	{
+		inline void check(msbtfont_retcode code)
+		{
+			if (code != MSBTFONT_SUCCESS)
+			{
+				throw error(code);
+			}
+		}
+
+		// Headers are always normalized before a font object holds them, so the copy matching the host is valid.
+		inline bool little_endian_host() noexcept
+		{
+			const unsigned int value = 1;
+			unsigned char first_byte = 0;
+			std::memcpy(&first_byte, &value, 1);
+			return first_byte == 1;
+		}
+
+		template <msbtfont_surface_format Format>
+		constexpr std::size_t pixel_size() noexcept
+		{
+			static_assert(Format == MSBTFONT_SURFACE_FORMAT_8 || Format == MSBTFONT_SURFACE_FORMAT_16_8 || Format == MSBTFONT_SURFACE_FORMAT_24_8 || Format == MSBTFONT_SURFACE_FORMAT_32_8, "Unsupported surface format");
+			return (Format == MSBTFONT_SURFACE_FORMAT_8) ? 1 : (Format == MSBTFONT_SURFACE_FORMAT_16_8) ? 2 : (Format == MSBTFONT_SURFACE_FORMAT_24_8) ? 3 : 4;
+		}
+
+		template <std::size_t PixelSize, msbtfont_surface_origin Origin, unsigned int BitsPerPixel>
+		void blit_kernel(const unsigned char *font_data, unsigned long long bit_offset, std::size_t width, std::size_t visible_width, std::size_t visible_height, unsigned char *surface_data, std::size_t pitch, std::size_t surface_height, std::size_t x, std::size_t y)
+		{
+			constexpr unsigned int pixel_mask = (1u << BitsPerPixel) - 1;
+			for (std::size_t row = 0; row < visible_height; ++row)
+			{
+				std::size_t surface_y = (Origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? (surface_height - 1 - y - row) : (y + row);
+				unsigned char *destination = &surface_data[(surface_y * pitch) + (x * PixelSize)];
+				unsigned long long row_offset = bit_offset + (static_cast<unsigned long long>(row) * width * BitsPerPixel);
+				if constexpr (BitsPerPixel == 8)
+				{
+					const unsigned char *source = &font_data[static_cast<std::size_t>(row_offset / 8)];
+					if constexpr (PixelSize == 1)
+					{
+						std::memcpy(destination, source, visible_width);
+					}
+					else
+					{
+						for (std::size_t column = 0; column < visible_width; ++column)
+						{
+							destination[column * PixelSize] = source[column];
+						}
+					}
+				}
+				else
+				{
+					for (std::size_t column = 0; column < visible_width; ++column)
+					{
+						const unsigned char *source = &font_data[static_cast<std::size_t>(row_offset / 8)];
+						unsigned int bit_shift = static_cast<unsigned int>(row_offset % 8) + BitsPerPixel;
+						unsigned int window = static_cast<unsigned int>(source[0]) << 8;
+						if (bit_shift > 8)
+						{
+							window |= source[1];
+						}
+						destination[column * PixelSize] = static_cast<unsigned char>((window >> (16 - bit_shift)) & pixel_mask);
+						row_offset += BitsPerPixel;
+					}
+				}
+			}
+		}
+	}
+
+	// Writable view of a surface.  The pitch follows the library's rule: width times the pixel size
+	// of the surface format, rounded up to a multiple of 4 bytes.
+	struct surface_view
+	{
+		span<unsigned char> data;
+		unsigned int width;
+		unsigned int height;
+	};
+
+	template <msbtfont_surface_format Format>
+	constexpr std::size_t surface_pitch(unsigned int width) noexcept
+	{
+		std::size_t pitch = static_cast<std::size_t>(width) * detail::pixel_size<Format>();
+		return (pitch % 4) ? pitch + (4 - (pitch % 4)) : pitch;
+	}
+
+	// Font compiled into the program by msbtfont_embed.  Every member is a constant expression, so
+	// characters can be decoded at compile time (for example to build lookup tables with constexpr).
+	struct embedded_font
+	{
+		unsigned int character_count;
+		unsigned int width;
+		unsigned int height;
+		unsigned int bits_per_pixel;
+		const unsigned char *variable_table; // nullptr if the font doesn't use it
+		const unsigned char *font_data;
+		const unsigned char *glyph_table = nullptr; // Deduplicated fonts only
+
+		constexpr unsigned int glyph(unsigned int index) const noexcept
+		{
+			if (glyph_table == nullptr)
+			{
+				return index;
+			}
+			const unsigned char *entry = &glyph_table[4 + (static_cast<std::size_t>(index) * 4)];
+			return static_cast<unsigned int>(entry[0]) | (static_cast<unsigned int>(entry[1]) << 8) | (static_cast<unsigned int>(entry[2]) << 16) | (static_cast<unsigned int>(entry[3]) << 24);
+		}
+
+		constexpr unsigned char pixel(unsigned int index, unsigned int x, unsigned int y) const noexcept
+		{
+			unsigned long long bit_offset = ((((static_cast<unsigned long long>(glyph(index)) * height) + y) * width) + x) * bits_per_pixel;
+			std::size_t byte_offset = static_cast<std::size_t>(bit_offset / 8);
+			unsigned int bit_shift = static_cast<unsigned int>(bit_offset % 8) + bits_per_pixel;
+			unsigned int window = static_cast<unsigned int>(font_data[byte_offset]) << 8;
+			if (bit_shift > 8)
+			{
+				window |= font_data[byte_offset + 1];
+			}
+			return static_cast<unsigned char>((window >> (16 - bit_shift)) & ((1u << bits_per_pixel) - 1));
+		}
+
+		constexpr unsigned int character_width(unsigned int index) const noexcept
+		{
+			return (variable_table != nullptr) ? variable_table[index] + 1u : width;
+		}
+	};
+
+	class font
+	{
+	public:
+		// Creates a header and zeroed file data (see 'msbtfont_create_header' and 'msbtfont_create_filedata').
+		explicit font(const msbtfont_header_descriptor &descriptor, const msbtfont_allocator *allocator = nullptr)
+		{
+			detail::check(msbtfont_create_header(&header_, &descriptor));
+			detail::check(msbtfont_create_filedata_with_allocator(&header_, &filedata_, allocator));
+		}
+
+		// Wraps an existing buffer without copying it (see 'msbtfont_adopt_filedata').  The header is
+		// normalized first, so headers read from a file written on either kind of host work.  With a
+		// null allocator the buffer is borrowed and must outlive the font.
+		static font adopt(msbtfont_header header, span<unsigned char> data, const msbtfont_allocator *allocator = nullptr)
+		{
+			font adopted;
+			detail::check(msbtfont_normalize_header(&header));
+			detail::check(msbtfont_adopt_filedata(&header, &adopted.filedata_, data.data(), data.size(), allocator));
+			adopted.header_ = header;
+			return adopted;
+		}
+
+		// Retrieves a font from an opened collection without copying it.
+		static font from_collection(const msbtfont_collection &collection, unsigned int index)
+		{
+			font retrieved;
+			detail::check(msbtfont_get_collection_font(&collection, index, &retrieved.header_, &retrieved.filedata_));
+			return retrieved;
+		}
+
+		font(const font &) = delete;
+		font &operator=(const font &) = delete;
+
+		font(font &&other) noexcept : header_(other.header_), filedata_(other.filedata_)
+		{
+			other.filedata_ = msbtfont_filedata();
+		}
+
+		font &operator=(font &&other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				header_ = other.header_;
+				filedata_ = other.filedata_;
+				other.filedata_ = msbtfont_filedata();
+			}
+			return *this;
+		}
+
+		~font()
+		{
+			reset();
+		}
+
+		const msbtfont_header &header() const noexcept { return header_; }
+		const msbtfont_filedata &filedata() const noexcept { return filedata_; }
+		msbtfont_filedata &filedata() noexcept { return filedata_; }
+
+		unsigned int character_count() const noexcept { return detail::little_endian_host() ? header_.font_character_count_le : header_.font_character_count_be; }
+		unsigned int width() const noexcept { return header_.max_font_width + 1u; }
+		unsigned int height() const noexcept { return header_.max_font_height + 1u; }
+		unsigned int bits_per_pixel() const noexcept { return header_.palette_format + 1u; }
+
+		// Bytes needed to hold one character loaded with 'load'.
+		std::size_t character_size() const noexcept
+		{
+			unsigned long long bits = static_cast<unsigned long long>(bits_per_pixel()) * width() * height();
+			return static_cast<std::size_t>((bits + 7) / 8);
+		}
+
+		span<const unsigned char> variable_table() const noexcept
+		{
+			return span<const unsigned char>(filedata_.variable_table, (filedata_.variable_table != nullptr) ? character_count() : 0);
+		}
+
+		span<const unsigned char> font_data() const noexcept
+		{
+			return span<const unsigned char>(filedata_.font_data, (filedata_.font_data != nullptr) ? filedata_.size - static_cast<std::size_t>(filedata_.font_data - filedata_.data) : 0);
+		}
+
+		void load(unsigned int index, span<unsigned char> character) const
+		{
+			check_character_size(character.size());
+			detail::check(msbtfont_load_font_character_data(&header_, &filedata_, character.data(), index));
+		}
+
+		void store(unsigned int index, span<const unsigned char> character)
+		{
+			check_character_size(character.size());
+			detail::check(msbtfont_store_font_character_data(&header_, &filedata_, character.data(), index));
+		}
+
+		// Glyphs are the unique character bitmaps; Only fewer than the characters in deduplicated fonts.
+		unsigned int glyph_count() const
+		{
+			unsigned int count = 0;
+			detail::check(msbtfont_get_glyph_count(&header_, &filedata_, &count));
+			return count;
+		}
+
+		unsigned int glyph_index(unsigned int index) const
+		{
+			unsigned int glyph = 0;
+			detail::check(msbtfont_get_glyph_index(&header_, &filedata_, index, &glyph));
+			return glyph;
+		}
+
+		// Creates a deduplicated copy of this font (see 'msbtfont_deduplicate').
+		font deduplicate() const
+		{
+			font deduplicated;
+			detail::check(msbtfont_deduplicate(&header_, &filedata_, &deduplicated.header_, &deduplicated.filedata_));
+			return deduplicated;
+		}
+
+		msbtfont_rect surface_size(unsigned int characters_per_row) const
+		{
+			msbtfont_rect size;
+			detail::check(msbtfont_get_surface_size(&header_, &size, characters_per_row));
+			return size;
+		}
+
+		msbtfont_rect glyph_surface_size(unsigned int glyphs_per_row) const
+		{
+			msbtfont_rect size;
+			detail::check(msbtfont_get_glyph_surface_size(&header_, &filedata_, &size, glyphs_per_row));
+			return size;
+		}
+
+		void copy_to_surface(unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data) const
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			detail::check(msbtfont_copy_to_surface(&header_, &filedata_, characters_per_row, character_start_offset, &surface, surface_data.data()));
+		}
+
+		// Copies only the pixels inside 'clip' (which addresses rows of the surface data, see
+		// 'msbtfont_copy_to_surface_clipped') and leaves the rest of the surface untouched.
+		void copy_to_surface_clipped(unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data, const msbtfont_rect &clip, const msbtfont_effect_descriptor *effects = nullptr) const
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			detail::check(msbtfont_copy_to_surface_clipped(&header_, &filedata_, characters_per_row, character_start_offset, &surface, effects, &clip, surface_data.data()));
+		}
+
+		// Composites a color into a 32-bit surface, using each pixel of the characters as coverage
+		// (see 'msbtfont_blend_to_surface').  'clip' and 'effects' are optional.
+		void blend_to_surface(unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data, const msbtfont_blend_descriptor &blend, const msbtfont_rect *clip = nullptr, const msbtfont_effect_descriptor *effects = nullptr) const
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			detail::check(msbtfont_blend_to_surface(&header_, &filedata_, characters_per_row, character_start_offset, &surface, effects, &blend, clip, surface_data.data()));
+		}
+
+		void copy_glyphs_to_surface(unsigned int glyphs_per_row, unsigned int glyph_start_offset, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data) const
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			detail::check(msbtfont_copy_glyphs_to_surface(&header_, &filedata_, glyphs_per_row, glyph_start_offset, &surface, surface_data.data()));
+		}
+
+		// Starts (or restarts) tracking stored characters for 'update_surface', or stops it.
+		void track_dirty_characters(bool enable = true)
+		{
+			detail::check(msbtfont_track_dirty_characters(&header_, &filedata_, enable ? 1 : 0));
+		}
+
+		void mark_dirty_characters(unsigned int first_index, unsigned int count)
+		{
+			detail::check(msbtfont_mark_dirty_characters(&header_, &filedata_, first_index, count));
+		}
+
+		// Copies the characters stored since the last update to a surface made by 'copy_to_surface'
+		// with the same layout.  Writes the updated areas (as many as fit) and returns how many
+		// there are in total.
+		unsigned int update_surface(unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data, span<msbtfont_rect> rects, const msbtfont_effect_descriptor *effects = nullptr)
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			unsigned int rect_count = 0;
+			detail::check(msbtfont_update_surface(&header_, &filedata_, characters_per_row, character_start_offset, &surface, effects, surface_data.data(), rects.data(), static_cast<unsigned int>(rects.size()), &rect_count));
+			return rect_count;
+		}
+
+		// Draws a grid of cells 'columns' wide (see 'msbtfont_render_cells').  Only the cells that
+		// differ from 'previous' are drawn unless it's empty, and 'previous' is updated to match.
+		// Writes the drawn areas (as many as fit) and returns how many there are in total.
+		unsigned int render_cells(unsigned int columns, span<const msbtfont_cell> cells, span<msbtfont_cell> previous, const msbtfont_surface_descriptor &surface, span<unsigned char> surface_data, span<msbtfont_rect> rects) const
+		{
+			if (surface_data.size() < msbtfont_get_surface_memory_requirement(&surface))
+			{
+				throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+			}
+			if (((columns == 0) ? !cells.empty() : (cells.size() % columns != 0)) || (!previous.empty() && previous.size() != cells.size()))
+			{
+				throw error(MSBTFONT_MISSING_SOURCE_DATA);
+			}
+			unsigned int rect_count = 0;
+			detail::check(msbtfont_render_cells(&header_, &filedata_, columns, (columns != 0) ? static_cast<unsigned int>(cells.size() / columns) : 0u, cells.data(), previous.empty() ? nullptr : previous.data(), &surface, surface_data.data(), rects.data(), static_cast<unsigned int>(rects.size()), &rect_count));
+			return rect_count;
+		}
+
+		// Content hash of the whole font (see 'msbtfont_hash_font').
+		unsigned long long hash() const
+		{
+			unsigned long long result = 0;
+			detail::check(msbtfont_hash_font(&header_, &filedata_, &result));
+			return result;
+		}
+
+		// Hashes characters 'first_index' to 'first_index + hashes.size() - 1'.
+		void hash_characters(unsigned int first_index, span<unsigned long long> hashes) const
+		{
+			detail::check(msbtfont_hash_characters(&header_, &filedata_, first_index, static_cast<unsigned int>(hashes.size()), hashes.data()));
+		}
+
+		// Writes the indices of the characters that differ from 'other' (as many as fit) and
+		// returns how many differ in total.
+		unsigned int diff(const font &other, span<unsigned int> changed_indices) const
+		{
+			unsigned int changed_count = 0;
+			detail::check(msbtfont_diff_fonts(&header_, &filedata_, &other.header_, &other.filedata_, changed_indices.data(), static_cast<unsigned int>(changed_indices.size()), &changed_count));
+			return changed_count;
+		}
+
+	private:
+		font() noexcept : header_(), filedata_() { }
+
+		void check_character_size(std::size_t size) const
+		{
+			if (size < character_size())
+			{
+				throw error(MSBTFONT_MISSING_DESTINATION_DATA);
+			}
+		}
+
+		void reset() noexcept
+		{
+			if (filedata_.data != nullptr)
+			{
+				msbtfont_delete_filedata(&filedata_);
+			}
+			filedata_ = msbtfont_filedata();
+		}
+
+		msbtfont_header header_;
+		msbtfont_filedata filedata_;
+	};
+
+	class paged_font
+	{
+	public:
+		paged_font(const msbtfont_header &header, const msbtfont_paged_filedata_descriptor &descriptor) : header_(header), paged_filedata_()
+		{
+			detail::check(msbtfont_normalize_header(&header_));
+			detail::check(msbtfont_open_paged_filedata(&header_, &paged_filedata_, &descriptor));
+		}
+
+		// Paged file data can't move while its prefetch worker runs, so it is neither copyable nor movable.
+		paged_font(const paged_font &) = delete;
+		paged_font &operator=(const paged_font &) = delete;
+
+		~paged_font()
+		{
+			msbtfont_close_paged_filedata(&paged_filedata_);
+		}
+
+		const msbtfont_header &header() const noexcept { return header_; }
+
+		void load(unsigned int index, span<unsigned char> character)
+		{
+			unsigned long long bits = static_cast<unsigned long long>(header_.palette_format + 1u) * (header_.max_font_width + 1u) * (header_.max_font_height + 1u);
+			if (character.size() < (bits + 7) / 8)
+			{
+				throw error(MSBTFONT_MISSING_DESTINATION_DATA);
+			}
+			detail::check(msbtfont_load_paged_font_character_data(&header_, &paged_filedata_, character.data(), index));
+		}
+
+		void prefetch(unsigned int first_index, unsigned int count)
+		{
+			detail::check(msbtfont_prefetch_paged_characters(&header_, &paged_filedata_, first_index, count));
+		}
+
+		unsigned long long schedule_prefetch(unsigned int first_index, unsigned int count)
+		{
+			unsigned long long ticket = 0;
+			detail::check(msbtfont_schedule_paged_prefetch(&header_, &paged_filedata_, first_index, count, &ticket));
+			return ticket;
+		}
+
+		bool prefetch_complete(unsigned long long ticket)
+		{
+			int complete = 0;
+			detail::check(msbtfont_query_paged_prefetch(&paged_filedata_, ticket, &complete));
+			return complete != 0;
+		}
+
+		unsigned int resident_pages()
+		{
+			unsigned int resident_pages = 0;
+			detail::check(msbtfont_get_paged_resident_pages(&paged_filedata_, &resident_pages));
+			return resident_pages;
+		}
+
+	private:
+		msbtfont_header header_;
+		msbtfont_paged_filedata paged_filedata_;
+	};
+
+	// Copies the part of character 'index' of 'source' inside 'clip' so its upper left pixel lands
+	// at (x, y) of the surface (y counts from the bottom row with MSBTFONT_SURFACE_ORIGIN_LOWERLEFT,
+	// like the whole-font copy).  'clip' addresses rows of the surface data like the clip rect of
+	// 'msbtfont_copy_to_surface_clipped'; Characters outside it are skipped without reading the
+	// font data.  Throws if the index is out of bounds or the view is smaller than its width,
+	// height and pitch require.
+	template <msbtfont_surface_format Format, msbtfont_surface_origin Origin>
+	void blit(const font &source, unsigned int index, const surface_view &surface, unsigned int x, unsigned int y, const msbtfont_rect &clip)
+	{
+		constexpr std::size_t pixel_size = detail::pixel_size<Format>();
+		std::size_t pitch = surface_pitch<Format>(surface.width);
+		if (index >= source.character_count())
+		{
+			throw error(MSBTFONT_INDEX_OUT_OF_BOUNDS);
+		}
+		if (surface.data.size() < pitch * surface.height)
+		{
+			throw error(MSBTFONT_SURFACE_BUFFER_TOO_SMALL);
+		}
+		if (clip.x >= surface.width || clip.y >= surface.height)
+		{
+			return;
+		}
+		std::size_t clip_width = (clip.width > surface.width - clip.x) ? surface.width - clip.x : clip.width;
+		std::size_t clip_height = (clip.height > surface.height - clip.y) ? surface.height - clip.y : clip.height;
+		std::size_t clip_left = clip.x;
+		std::size_t clip_top = (Origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? surface.height - clip.y - clip_height : clip.y;
+		std::size_t clip_right = clip_left + clip_width;
+		std::size_t clip_bottom = clip_top + clip_height;
+		std::size_t width = source.width();
+		std::size_t height = source.height();
+		if (x >= clip_right || y >= clip_bottom || x + width <= clip_left || y + height <= clip_top)
+		{
+			return;
+		}
+		std::size_t first_x = (x < clip_left) ? clip_left - x : 0;
+		std::size_t first_y = (y < clip_top) ? clip_top - y : 0;
+		std::size_t visible_width = ((x + width > clip_right) ? clip_right - x : width) - first_x;
+		std::size_t visible_height = ((y + height > clip_bottom) ? clip_bottom - y : height) - first_y;
+		unsigned int bits_per_pixel = source.bits_per_pixel();
+		unsigned long long bit_offset = static_cast<unsigned long long>((source.header().flags & MSBTFONT_FLAG_DEDUPLICATED) ? source.glyph_index(index) : index) * bits_per_pixel * width * height;
+		bit_offset += ((static_cast<unsigned long long>(first_y) * width) + first_x) * bits_per_pixel;
+		const unsigned char *font_data = source.filedata().font_data;
+		x += static_cast<unsigned int>(first_x);
+		y += static_cast<unsigned int>(first_y);
+		switch (bits_per_pixel)
+		{
+			case 1: detail::blit_kernel<pixel_size, Origin, 1>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 2: detail::blit_kernel<pixel_size, Origin, 2>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 3: detail::blit_kernel<pixel_size, Origin, 3>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 4: detail::blit_kernel<pixel_size, Origin, 4>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 5: detail::blit_kernel<pixel_size, Origin, 5>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 6: detail::blit_kernel<pixel_size, Origin, 6>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			case 7: detail::blit_kernel<pixel_size, Origin, 7>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+			default: detail::blit_kernel<pixel_size, Origin, 8>(font_data, bit_offset, width, visible_width, visible_height, surface.data.data(), pitch, surface.height, x, y); break;
+		}
+	}
+
+	// Copies character 'index' of 'source' so its upper left pixel lands at (x, y) of the surface,
+	// clipped against the whole surface.
+	template <msbtfont_surface_format Format, msbtfont_surface_origin Origin>
+	void blit(const font &source, unsigned int index, const surface_view &surface, unsigned int x, unsigned int y)
+	{
+		msbtfont_rect clip;
+		clip.width = static_cast<unsigned int>(surface.width);
+		clip.height = static_cast<unsigned int>(surface.height);
+		clip.x = 0;
+		clip.y = 0;
+		blit<Format, Origin>(source, index, surface, x, y, clip);
+	}
+}
+
+#endif
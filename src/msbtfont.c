@@ -1,11 +1,187 @@
 #include "../include/msbtfont.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+#if defined(MSBTFONT_ENABLE_STATS)
+#include <time.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MSBTFONT_SSE2
+#include <emmintrin.h>
+#endif
 
 #define MSBTFONT_FOURCC(a, b, c, d) (a | (b << 8) | (c << 16) | (d << 24))
 #define MSBTFONT_MSBT MSBTFONT_FOURCC('M', 'S', 'B', 'T')
 #define MSBTFONT_TBSM MSBTFONT_FOURCC('T', 'B', 'S', 'M')
+#define MSBTFONT_MSBC MSBTFONT_FOURCC('M', 'S', 'B', 'C')
+#define MSBTFONT_CBSM MSBTFONT_FOURCC('C', 'B', 'S', 'M')
+#define MSBTFONT_ALLOCATION_ALIGNMENT 16
+#define MSBTFONT_COLLECTION_ALIGNMENT 16
+#define MSBTFONT_DEFAULT_PAGE_SIZE 65536
+#define MSBTFONT_DEFAULT_RESIDENT_PAGES 64
+#define MSBTFONT_NO_SLOT UINT_MAX
+#define MSBTFONT_NO_GLYPH UINT_MAX
+
+// Every header carries both a little endian and a big endian copy of its multi-byte fields.
+// Only the copy matching the host is ever read by the hot paths; 'msbtfont_normalize_header'
+// rebuilds it from the foreign copy when needed.
+#if defined(MSBTFONT_BIG_ENDIAN) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+#define MSBTFONT_NATIVE(header, member) ((header)->member##_be)
+#define MSBTFONT_FOREIGN(header, member) ((header)->member##_le)
+#else
+#define MSBTFONT_NATIVE(header, member) ((header)->member##_le)
+#define MSBTFONT_FOREIGN(header, member) ((header)->member##_be)
+#endif
+
+#if defined(_MSC_VER)
+#define MSBTFONT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define MSBTFONT_THREAD_LOCAL __thread
+#else
+#define MSBTFONT_THREAD_LOCAL _Thread_local
+#endif
+
+#if defined(MSBTFONT_ENABLE_STATS)
+static MSBTFONT_THREAD_LOCAL msbtfont_stats msbtfont_thread_stats;
+
+static unsigned long long msbtfont_read_cycles(void)
+{
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || ((defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)))
+	return __rdtsc();
+#else
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ((unsigned long long)(ts.tv_sec) * 1000000000ull) + (unsigned long long)(ts.tv_nsec);
+#endif
+}
+
+#define MSBTFONT_STATS_BEGIN(function) unsigned long long msbtfont_stats_start = msbtfont_read_cycles(); ++msbtfont_thread_stats.calls[function]
+#define MSBTFONT_STATS_END(function) (msbtfont_thread_stats.cycles[function] += msbtfont_read_cycles() - msbtfont_stats_start)
+#define MSBTFONT_STATS_ADD(member, value) (msbtfont_thread_stats.member += (value))
+#else
+#define MSBTFONT_STATS_BEGIN(function) ((void)(0))
+#define MSBTFONT_STATS_END(function) ((void)(0))
+#define MSBTFONT_STATS_ADD(member, value) ((void)(0))
+#endif
+
+static unsigned int msbtfont_swap32(unsigned int value)
+{
+	return ((value >> 24) | ((value & 0xFF0000) >> 8) | ((value & 0xFF00) << 8) | (value << 24));
+}
+
+static unsigned long long msbtfont_swap64(unsigned long long value)
+{
+	return ((unsigned long long)(msbtfont_swap32((unsigned int)(value))) << 32) | msbtfont_swap32((unsigned int)(value >> 32));
+}
+
+static unsigned short msbtfont_swap16(unsigned short value)
+{
+	return (unsigned short)((value >> 8) | (value << 8));
+}
+
+static void *msbtfont_default_alloc(void *user_data, size_t size, size_t alignment)
+{
+	(void)(user_data);
+	(void)(alignment);
+	return malloc(size);
+}
+
+static void *msbtfont_default_realloc(void *user_data, void *ptr, size_t old_size, size_t new_size, size_t alignment)
+{
+	(void)(user_data);
+	(void)(old_size);
+	(void)(alignment);
+	return realloc(ptr, new_size);
+}
+
+static void msbtfont_default_free(void *user_data, void *ptr, size_t size)
+{
+	(void)(user_data);
+	(void)(size);
+	free(ptr);
+}
+
+static msbtfont_allocator msbtfont_global_allocator = { msbtfont_default_alloc, msbtfont_default_realloc, msbtfont_default_free, NULL };
+
+static void *msbtfont_allocate(const msbtfont_allocator *allocator, size_t size)
+{
+	return allocator->alloc(allocator->user_data, size ? size : 1, MSBTFONT_ALLOCATION_ALIGNMENT);
+}
+
+static void msbtfont_deallocate(const msbtfont_allocator *allocator, void *ptr, size_t size)
+{
+	if (allocator->free != NULL)
+	{
+		allocator->free(allocator->user_data, ptr, size);
+	}
+	else
+	{
+		free(ptr);
+	}
+}
+
+// Resizes memory from an allocator through its 'realloc', or with 'alloc', a copy and 'free'
+// if it has none.  The original memory is left alone on failure.
+static void *msbtfont_reallocate(const msbtfont_allocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+	old_size = old_size ? old_size : 1;
+	new_size = new_size ? new_size : 1;
+	if (allocator->realloc != NULL)
+	{
+		return allocator->realloc(allocator->user_data, ptr, old_size, new_size, MSBTFONT_ALLOCATION_ALIGNMENT);
+	}
+	void *resized = msbtfont_allocate(allocator, new_size);
+	if (resized != NULL)
+	{
+		memcpy(resized, ptr, (old_size < new_size) ? old_size : new_size);
+		msbtfont_deallocate(allocator, ptr, old_size);
+	}
+	return resized;
+}
+
+msbtfont_retcode msbtfont_set_allocator(const msbtfont_allocator *allocator)
+{
+	if (allocator == NULL)
+	{
+		msbtfont_global_allocator.alloc = msbtfont_default_alloc;
+		msbtfont_global_allocator.realloc = msbtfont_default_realloc;
+		msbtfont_global_allocator.free = msbtfont_default_free;
+		msbtfont_global_allocator.user_data = NULL;
+		return MSBTFONT_SUCCESS;
+	}
+	if (allocator->alloc == NULL || allocator->free == NULL)
+	{
+		return MSBTFONT_INVALID_ALLOCATOR;
+	}
+	msbtfont_global_allocator = *allocator;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_allocator(msbtfont_allocator *allocator)
+{
+	if (allocator == NULL)
+	{
+		return MSBTFONT_MISSING_ALLOCATOR;
+	}
+	*allocator = msbtfont_global_allocator;
+	return MSBTFONT_SUCCESS;
+}
 
 msbtfont_retcode msbtfont_create_header(msbtfont_header *header, const msbtfont_header_descriptor *header_descriptor)
 {
@@ -17,109 +193,374 @@ msbtfont_retcode msbtfont_create_header(msbtfont_header *header, const msbtfont_
 	const char magicword_be_data[] = { 'T', 'B', 'S', 'M' };
 	const unsigned char version_le_data[] = { 0, 0, 1, 0 };
 	const unsigned char version_be_data[] = { 0, 0, 0, 1 };
-	unsigned char endianness = 0; // 0 = Little Endian, 1 = Big Endian
-	unsigned int font_character_count = header_descriptor->font_character_count;
-	memcpy(&header->magicword_le, magicword_le_data, sizeof(unsigned int));
-	if (header->magicword_le != MSBTFONT_MSBT)
+	if (header_descriptor->palette_format > 7)
 	{
-		endianness = 1;
+		return MSBTFONT_INVALID_PALETTE_FORMAT;
 	}
+	memcpy(&header->magicword_le, magicword_le_data, sizeof(unsigned int));
 	memcpy(&header->version_le, version_le_data, sizeof(header->version_le));
 	memcpy(&header->magicword_be, magicword_be_data, sizeof(unsigned int));
 	memcpy(&header->version_be, version_be_data, sizeof(header->version_be));
-	if (header_descriptor->palette_format > 7)
-	{
-		return MSBTFONT_INVALID_PALETTE_FORMAT;
-	}
 	header->palette_format = header_descriptor->palette_format;
 	header->max_font_width = header_descriptor->max_font_width;
 	header->max_font_height = header_descriptor->max_font_height;
 	header->flags = header_descriptor->flags;
-	if (endianness == 0)
+	MSBTFONT_NATIVE(header, font_character_count) = header_descriptor->font_character_count;
+	MSBTFONT_FOREIGN(header, font_character_count) = msbtfont_swap32(header_descriptor->font_character_count);
+	memcpy(header->font_name, header_descriptor->font_name, sizeof(header->font_name));
+	memcpy(header->language, header_descriptor->language, sizeof(header->language));
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_normalize_header(msbtfont_header *header)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) == MSBTFONT_MSBT)
+	{
+		MSBTFONT_FOREIGN(header, magicword) = MSBTFONT_TBSM;
+		MSBTFONT_FOREIGN(header, version).major = msbtfont_swap16(MSBTFONT_NATIVE(header, version).major);
+		MSBTFONT_FOREIGN(header, version).minor = msbtfont_swap16(MSBTFONT_NATIVE(header, version).minor);
+		MSBTFONT_FOREIGN(header, font_character_count) = msbtfont_swap32(MSBTFONT_NATIVE(header, font_character_count));
+	}
+	else if (MSBTFONT_FOREIGN(header, magicword) == MSBTFONT_TBSM)
 	{
-		memcpy(&header->font_character_count_le, &font_character_count, sizeof(unsigned int));
-		font_character_count = ((font_character_count >> 24) | ((font_character_count & 0xFF0000) >> 8) | ((font_character_count & 0xFF00) << 8) | (font_character_count << 24));
-		memcpy(&header->font_character_count_be, &font_character_count, sizeof(unsigned int));
+		MSBTFONT_NATIVE(header, magicword) = MSBTFONT_MSBT;
+		MSBTFONT_NATIVE(header, version).major = msbtfont_swap16(MSBTFONT_FOREIGN(header, version).major);
+		MSBTFONT_NATIVE(header, version).minor = msbtfont_swap16(MSBTFONT_FOREIGN(header, version).minor);
+		MSBTFONT_NATIVE(header, font_character_count) = msbtfont_swap32(MSBTFONT_FOREIGN(header, font_character_count));
 	}
 	else
 	{
-		memcpy(&header->font_character_count_be, &font_character_count, sizeof(unsigned int));
-		font_character_count = ((font_character_count >> 24) | ((font_character_count & 0xFF0000) >> 8) | ((font_character_count & 0xFF00) << 8) | (font_character_count << 24));
-		memcpy(&header->font_character_count_le, &font_character_count, sizeof(unsigned int));
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (header->palette_format > 7)
+	{
+		return MSBTFONT_INVALID_PALETTE_FORMAT;
 	}
-	memcpy(header->font_name, header_descriptor->font_name, sizeof(header->font_name));
-	memcpy(header->language, header_descriptor->language, sizeof(header->language));
 	return MSBTFONT_SUCCESS;
 }
 
-msbtfont_retcode msbtfont_create_filedata(const msbtfont_header *header, msbtfont_filedata *filedata)
+static unsigned int msbtfont_read_le32(const unsigned char *data)
 {
-	size_t filedata_size = 0;
-	size_t font_data_size = 0;
-	if (header == NULL || filedata == NULL)
+	return (unsigned int)(data[0]) | ((unsigned int)(data[1]) << 8) | ((unsigned int)(data[2]) << 16) | ((unsigned int)(data[3]) << 24);
+}
+
+static void msbtfont_write_le32(unsigned char *data, unsigned int value)
+{
+	data[0] = (unsigned char)(value);
+	data[1] = (unsigned char)(value >> 8);
+	data[2] = (unsigned char)(value >> 16);
+	data[3] = (unsigned char)(value >> 24);
+}
+
+// File data holds the variable table (if used), the glyph table (deduplicated fonts only) and
+// the font data of 'glyph_count' glyphs, in that order.
+static msbtfont_retcode msbtfont_compute_layout(const msbtfont_header *header, unsigned int glyph_count, size_t *variable_table_size, size_t *glyph_table_size, size_t *font_data_size)
+{
+	if (header->palette_format > 7)
 	{
-		return (header == NULL) ? MSBTFONT_MISSING_HEADER : MSBTFONT_MISSING_FILEDATA;
+		return MSBTFONT_INVALID_PALETTE_FORMAT;
 	}
-	if (header->magicword_le == MSBTFONT_MSBT)
+	unsigned long long font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	unsigned long long font_data_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1) * glyph_count;
+	unsigned long long font_data_bytes = (font_data_bits / 8) + ((font_data_bits % 8) ? 1 : 0);
+	unsigned long long variable_table_bytes = (header->flags & MSBTFONT_FLAG_VARIABLE_WIDTH) ? font_character_count : 0;
+	unsigned long long glyph_table_bytes = (header->flags & MSBTFONT_FLAG_DEDUPLICATED) ? (font_character_count + 1) * 4 : 0;
+	if (glyph_table_bytes > (unsigned long long)(SIZE_MAX) - variable_table_bytes || font_data_bytes > (unsigned long long)(SIZE_MAX) - variable_table_bytes - glyph_table_bytes)
 	{
-		if (header->flags & 0x01)
-		{
-			filedata_size += header->font_character_count_le;
-		}
-		font_data_size = ((header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1) * header->font_character_count_le);
-		filedata_size += font_data_size / 8;
-		if (font_data_size % 8)
-		{
-			filedata_size += 1;
-		}
-		filedata->data = malloc(filedata_size);
-		filedata->size = filedata_size;
-		if (header->flags & 0x01)
-		{
-			filedata->variable_table = &filedata->data[0];
-			filedata->font_data = &filedata->data[header->font_character_count_le];
-			memset(filedata->variable_table, header->max_font_width, header->font_character_count_le);
-			memset(filedata->font_data, 0, filedata->size - header->font_character_count_le);
-		}
-		else
-		{
-			filedata->font_data = &filedata->data[0];
-			memset(filedata->font_data, 0, filedata->size);
-		}
-		return MSBTFONT_SUCCESS;
+		return MSBTFONT_FONT_TOO_LARGE;
+	}
+	*variable_table_size = (size_t)(variable_table_bytes);
+	*glyph_table_size = (size_t)(glyph_table_bytes);
+	*font_data_size = (size_t)(font_data_bytes);
+	return MSBTFONT_SUCCESS;
+}
+
+// Sizes of fonts whose layout follows from the header alone (every font but deduplicated ones)
+static msbtfont_retcode msbtfont_compute_filedata_size(const msbtfont_header *header, size_t *variable_table_size, size_t *font_data_size)
+{
+	size_t glyph_table_size = 0;
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		return MSBTFONT_DEDUPLICATED_FONT;
+	}
+	return msbtfont_compute_layout(header, MSBTFONT_NATIVE(header, font_character_count), variable_table_size, &glyph_table_size, font_data_size);
+}
+
+// Glyph table of a deduplicated font, or NULL if characters are their own glyphs
+static const unsigned char *msbtfont_get_glyph_table(const msbtfont_header *header, const msbtfont_filedata *filedata)
+{
+	return (header->flags & MSBTFONT_FLAG_DEDUPLICATED) ? filedata->glyph_table : NULL;
+}
+
+// Returns the glyph holding a character, or MSBTFONT_NO_GLYPH if the glyph table refers past
+// the last glyph (possible with untrusted data that skipped 'msbtfont_validate_filedata').
+static unsigned int msbtfont_get_glyph(const unsigned char *glyph_table, unsigned int index)
+{
+	if (glyph_table == NULL)
+	{
+		return index;
+	}
+	unsigned int glyph = msbtfont_read_le32(&glyph_table[4 + ((size_t)(index) * 4)]);
+	return (glyph < msbtfont_read_le32(glyph_table)) ? glyph : MSBTFONT_NO_GLYPH;
+}
+
+// Dirty character bits set up by 'msbtfont_track_dirty_characters', allocated in one block
+// with the bits right after the structure.
+struct msbtfont_dirty_tracker
+{
+	msbtfont_allocator allocator; // Allocator the tracker came from, so it's freed with the same one
+	size_t size;
+	unsigned int font_character_count;
+	unsigned char *bits;
+};
+
+#define MSBTFONT_DIRTY_TRACKER_KEY 0x44525459 // DRTY
+
+// Key stored next to a tracker pointer.  It depends on the pointer, so leftover values in file
+// data that was never zeroed are practically never taken for a tracker.
+static unsigned int msbtfont_get_dirty_tracker_key(const struct msbtfont_dirty_tracker *tracker)
+{
+	uintptr_t address = (uintptr_t)(tracker);
+	return MSBTFONT_DIRTY_TRACKER_KEY ^ (unsigned int)(address) ^ (unsigned int)((address >> 16) >> 16);
+}
+
+// Tracker of a font, or NULL if tracking is off (or the fields were never set by the library)
+static struct msbtfont_dirty_tracker *msbtfont_get_dirty_tracker(const msbtfont_filedata *filedata)
+{
+	if (filedata->dirty_tracker == NULL || filedata->dirty_tracker_key != msbtfont_get_dirty_tracker_key(filedata->dirty_tracker))
+	{
+		return NULL;
+	}
+	return filedata->dirty_tracker;
+}
+
+static void msbtfont_clear_dirty_tracker(msbtfont_filedata *filedata)
+{
+	filedata->dirty_tracker = NULL;
+	filedata->dirty_tracker_key = 0;
+}
+
+// Sets the dirty bits of a range of characters (nothing happens if tracking is off).  Ranges
+// starting and ending on multiples of 8 characters touch separate bytes, matching the ranges
+// that can be stored from separate threads.
+static void msbtfont_mark_dirty(struct msbtfont_dirty_tracker *tracker, unsigned int first_index, unsigned int count)
+{
+	if (tracker == NULL || count == 0)
+	{
+		return;
+	}
+	unsigned char *bits = tracker->bits;
+	unsigned int last_index = first_index + count - 1;
+	size_t first_byte = first_index / 8;
+	size_t last_byte = last_index / 8;
+	unsigned char first_mask = (unsigned char)(0xFF >> (first_index % 8));
+	unsigned char last_mask = (unsigned char)(0xFF << (7 - (last_index % 8)));
+	if (first_byte == last_byte)
+	{
+		bits[first_byte] |= first_mask & last_mask;
+		return;
 	}
-	else if (header->magicword_be == MSBTFONT_TBSM)
+	bits[first_byte] |= first_mask;
+	memset(&bits[first_byte + 1], 0xFF, last_byte - first_byte - 1);
+	bits[last_byte] |= last_mask;
+}
+
+// Makes sure the file data actually holds everything the header describes before any font data
+// is touched, since both can come from untrusted files.
+static msbtfont_retcode msbtfont_check_filedata(const msbtfont_header *header, const msbtfont_filedata *filedata)
+{
+	size_t variable_table_size = 0;
+	size_t glyph_table_size = 0;
+	size_t font_data_size = 0;
+	unsigned int glyph_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
 	{
-		if (header->flags & 0x01)
+		unsigned long long required_size = ((unsigned long long)(glyph_count) + 1) * 4;
+		if (filedata->glyph_table == NULL || filedata->glyph_table < filedata->data || (size_t)(filedata->glyph_table - filedata->data) > filedata->size || filedata->size - (size_t)(filedata->glyph_table - filedata->data) < required_size)
 		{
-			filedata_size += header->font_character_count_be;
+			return MSBTFONT_INVALID_FILEDATA;
 		}
-		font_data_size = ((header->max_font_width + 1) * (header->max_font_height + 1) * header->font_character_count_be);
-		filedata_size += font_data_size / 8;
-		if (font_data_size % 8)
+		if (msbtfont_read_le32(filedata->glyph_table) > glyph_count)
 		{
-			filedata_size += 1;
+			return MSBTFONT_INVALID_FILEDATA;
 		}
-		filedata->data = malloc(filedata_size);
-		filedata->size = filedata_size;
-		if (header->flags & 0x01)
+		glyph_count = msbtfont_read_le32(filedata->glyph_table);
+	}
+	msbtfont_retcode retcode = msbtfont_compute_layout(header, glyph_count, &variable_table_size, &glyph_table_size, &font_data_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (filedata->font_data < filedata->data || (size_t)(filedata->font_data - filedata->data) > filedata->size || filedata->size - (size_t)(filedata->font_data - filedata->data) < font_data_size)
+	{
+		return MSBTFONT_INVALID_FILEDATA;
+	}
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_create_filedata(const msbtfont_header *header, msbtfont_filedata *filedata)
+{
+	return msbtfont_create_filedata_with_initialization(header, filedata, NULL, MSBTFONT_FILEDATA_ZEROED);
+}
+
+msbtfont_retcode msbtfont_create_filedata_with_allocator(const msbtfont_header *header, msbtfont_filedata *filedata, const msbtfont_allocator *allocator)
+{
+	return msbtfont_create_filedata_with_initialization(header, filedata, allocator, MSBTFONT_FILEDATA_ZEROED);
+}
+
+msbtfont_retcode msbtfont_create_filedata_with_initialization(const msbtfont_header *header, msbtfont_filedata *filedata, const msbtfont_allocator *allocator, msbtfont_filedata_initialization initialization)
+{
+	size_t variable_table_size = 0;
+	size_t font_data_size = 0;
+	if (header == NULL || filedata == NULL)
+	{
+		return (header == NULL) ? MSBTFONT_MISSING_HEADER : MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (allocator == NULL)
+	{
+		allocator = &msbtfont_global_allocator;
+	}
+	else if (allocator->alloc == NULL || allocator->free == NULL)
+	{
+		return MSBTFONT_INVALID_ALLOCATOR;
+	}
+	if (initialization != MSBTFONT_FILEDATA_ZEROED && initialization != MSBTFONT_FILEDATA_LAZY_ZEROED && initialization != MSBTFONT_FILEDATA_UNINITIALIZED)
+	{
+		return MSBTFONT_INVALID_MODE;
+	}
+	msbtfont_retcode retcode = msbtfont_compute_filedata_size(header, &variable_table_size, &font_data_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	filedata->allocator = *allocator;
+	if (initialization == MSBTFONT_FILEDATA_LAZY_ZEROED && allocator->alloc == msbtfont_default_alloc)
+	{
+		// calloc hands out fresh zero pages for large sizes, so nothing is touched up front
+		filedata->data = calloc((variable_table_size + font_data_size) ? (variable_table_size + font_data_size) : 1, 1);
+	}
+	else
+	{
+		filedata->data = msbtfont_allocate(allocator, variable_table_size + font_data_size);
+		if (filedata->data != NULL && initialization == MSBTFONT_FILEDATA_LAZY_ZEROED)
 		{
-			filedata->variable_table = &filedata->data[0];
-			filedata->font_data = &filedata->data[header->font_character_count_be];
-			memset(filedata->variable_table, header->max_font_width, header->font_character_count_be);
-			memset(filedata->font_data, 0, filedata->size - header->font_character_count_be);
+			initialization = MSBTFONT_FILEDATA_ZEROED;
 		}
-		else
+	}
+	if (filedata->data == NULL)
+	{
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	filedata->size = variable_table_size + font_data_size;
+	filedata->glyph_table = NULL;
+	msbtfont_clear_dirty_tracker(filedata);
+	if (header->flags & 0x01)
+	{
+		filedata->variable_table = &filedata->data[0];
+		filedata->font_data = &filedata->data[variable_table_size];
+		if (initialization != MSBTFONT_FILEDATA_UNINITIALIZED)
 		{
-			filedata->font_data = &filedata->data[0];
-			memset(filedata->font_data, 0, filedata->size);
+			memset(filedata->variable_table, header->max_font_width, variable_table_size);
 		}
-		return MSBTFONT_SUCCESS;
 	}
 	else
+	{
+		filedata->variable_table = NULL;
+		filedata->font_data = &filedata->data[0];
+	}
+	if (initialization == MSBTFONT_FILEDATA_ZEROED)
+	{
+		memset(filedata->font_data, 0, font_data_size);
+	}
+	return MSBTFONT_SUCCESS;
+}
+
+static void msbtfont_borrowed_free(void *user_data, void *ptr, size_t size)
+{
+	(void)(user_data);
+	(void)(ptr);
+	(void)(size);
+}
+
+// Allocator for memory derived from a font (work buffers, new fonts made from it).  Borrowed
+// file data and embedded fonts can't allocate anything themselves, so they use the global one.
+static const msbtfont_allocator *msbtfont_get_filedata_allocator(const msbtfont_filedata *filedata)
+{
+	if (filedata->allocator.alloc == NULL || filedata->allocator.free == msbtfont_borrowed_free)
+	{
+		return &msbtfont_global_allocator;
+	}
+	return &filedata->allocator;
+}
+
+static void msbtfont_free_dirty_tracker(msbtfont_filedata *filedata)
+{
+	struct msbtfont_dirty_tracker *tracker = msbtfont_get_dirty_tracker(filedata);
+	if (tracker != NULL)
+	{
+		msbtfont_allocator allocator = tracker->allocator;
+		msbtfont_deallocate(&allocator, tracker, tracker->size);
+	}
+	msbtfont_clear_dirty_tracker(filedata);
+}
+
+msbtfont_retcode msbtfont_adopt_filedata(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned char *data, size_t size, const msbtfont_allocator *allocator)
+{
+	if (header == NULL || filedata == NULL)
+	{
+		return (header == NULL) ? MSBTFONT_MISSING_HEADER : MSBTFONT_MISSING_FILEDATA;
+	}
+	if (data == NULL)
+	{
+		return MSBTFONT_MISSING_SOURCE_DATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
 	{
 		return MSBTFONT_INVALID_HEADER;
 	}
+	if (allocator != NULL && (allocator->alloc == NULL || allocator->free == NULL))
+	{
+		return MSBTFONT_INVALID_ALLOCATOR;
+	}
+	msbtfont_filedata adopted;
+	adopted.data = data;
+	adopted.size = size;
+	adopted.variable_table = (header->flags & 0x01) ? data : NULL;
+	adopted.font_data = (header->flags & 0x01) ? &data[(size >= MSBTFONT_NATIVE(header, font_character_count)) ? MSBTFONT_NATIVE(header, font_character_count) : size] : data;
+	adopted.glyph_table = NULL;
+	msbtfont_clear_dirty_tracker(&adopted);
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		unsigned long long glyph_table_size = ((unsigned long long)(MSBTFONT_NATIVE(header, font_character_count)) + 1) * 4;
+		adopted.glyph_table = adopted.font_data;
+		adopted.font_data = ((size_t)(&data[size] - adopted.glyph_table) >= glyph_table_size) ? &adopted.glyph_table[(size_t)(glyph_table_size)] : &data[size];
+	}
+	if (allocator != NULL)
+	{
+		adopted.allocator = *allocator;
+	}
+	else
+	{
+		adopted.allocator.alloc = msbtfont_default_alloc;
+		adopted.allocator.realloc = NULL;
+		adopted.allocator.free = msbtfont_borrowed_free;
+		adopted.allocator.user_data = NULL;
+	}
+	msbtfont_retcode retcode = msbtfont_validate_filedata(header, &adopted);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	*filedata = adopted;
+	return MSBTFONT_SUCCESS;
 }
 
 msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata *filedata)
@@ -128,7 +569,8 @@ msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata *filedata)
 	{
 		if (filedata->data != NULL)
 		{
-			free(filedata->data);
+			msbtfont_free_dirty_tracker(filedata);
+			msbtfont_deallocate(&filedata->allocator, filedata->data, filedata->size);
 			filedata->data = NULL;
 			if (filedata->variable_table != NULL)
 			{
@@ -138,6 +580,7 @@ msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata *filedata)
 			{
 				filedata->font_data = NULL;
 			}
+			filedata->glyph_table = NULL;
 			return MSBTFONT_NO_ERROR;
 		}
 		else
@@ -148,139 +591,182 @@ msbtfont_retcode msbtfont_delete_filedata(msbtfont_filedata *filedata)
 	return MSBTFONT_MISSING_FILEDATA;
 }
 
-msbtfont_retcode msbtfont_store_font_character_data(const msbtfont_header *header, msbtfont_filedata *filedata, const unsigned char *srcdata, unsigned int index)
+msbtfont_retcode msbtfont_get_filedata_size(const msbtfont_header *header, size_t *size)
 {
-	if (header != NULL)
+	if (header == NULL)
 	{
-		if (filedata != NULL)
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (size == NULL)
+	{
+		return MSBTFONT_MISSING_SIZE;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	size_t variable_table_size = 0;
+	size_t font_data_size = 0;
+	msbtfont_retcode retcode = msbtfont_compute_filedata_size(header, &variable_table_size, &font_data_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	*size = variable_table_size + font_data_size;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_validate_filedata(const msbtfont_header *header, const msbtfont_filedata *filedata)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (filedata->data == NULL || filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (header->flags & 0x01)
+	{
+		size_t font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+		if (filedata->variable_table == NULL || filedata->variable_table < filedata->data || (size_t)(filedata->variable_table - filedata->data) > filedata->size || filedata->size - (size_t)(filedata->variable_table - filedata->data) < font_character_count)
+		{
+			return MSBTFONT_INVALID_FILEDATA;
+		}
+	}
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+		for (unsigned int i = 0; i < font_character_count; ++i)
+		{
+			if (msbtfont_get_glyph(filedata->glyph_table, i) == MSBTFONT_NO_GLYPH)
+			{
+				return MSBTFONT_INVALID_FILEDATA;
+			}
+		}
+	}
+	return MSBTFONT_SUCCESS;
+}
+
+static void msbtfont_pack_bits(unsigned char *dstdata, unsigned long long dst_bit_offset, const unsigned char *srcdata, unsigned long long bit_count)
+{
+	size_t full_bytes = (size_t)(bit_count / 8);
+	unsigned int tail_bits = (unsigned int)(bit_count % 8);
+	unsigned int shift = (unsigned int)(dst_bit_offset % 8);
+	dstdata = &dstdata[(size_t)(dst_bit_offset / 8)];
+	if (shift == 0)
+	{
+		// Byte-aligned characters are a plain copy plus a masked merge of the final byte
+		memcpy(dstdata, srcdata, full_bytes);
+		if (tail_bits)
+		{
+			unsigned char tail_mask = (unsigned char)(0xFF << (8 - tail_bits));
+			dstdata[full_bytes] = (unsigned char)((dstdata[full_bytes] & ~tail_mask) | (srcdata[full_bytes] & tail_mask));
+		}
+		return;
+	}
+	unsigned int carry = dstdata[0] & (0xFF << (8 - shift));
+	for (size_t i = 0; i < full_bytes; ++i)
+	{
+		dstdata[i] = (unsigned char)(carry | (srcdata[i] >> shift));
+		carry = (srcdata[i] << (8 - shift)) & 0xFF;
+	}
+	// Whatever is left ('shift' carried bits plus the source tail) spans at most two bytes
+	unsigned int total_bits = shift + tail_bits;
+	unsigned int value = carry << 8;
+	if (tail_bits)
+	{
+		value |= ((srcdata[full_bytes] & (0xFF << (8 - tail_bits))) << 8) >> shift;
+	}
+	unsigned int mask = (0xFFFF << (16 - total_bits)) & 0xFFFF;
+	dstdata[full_bytes] = (unsigned char)((dstdata[full_bytes] & ~(mask >> 8)) | (value >> 8));
+	if (total_bits > 8)
+	{
+		dstdata[full_bytes + 1] = (unsigned char)((dstdata[full_bytes + 1] & ~mask) | (value & 0xFF));
+	}
+}
+
+static void msbtfont_unpack_bits(unsigned char *dstdata, const unsigned char *srcdata, unsigned long long src_bit_offset, unsigned long long bit_count)
+{
+	size_t full_bytes = (size_t)(bit_count / 8);
+	unsigned int tail_bits = (unsigned int)(bit_count % 8);
+	unsigned int shift = (unsigned int)(src_bit_offset % 8);
+	unsigned char tail_mask = (unsigned char)(0xFF << (8 - tail_bits));
+	srcdata = &srcdata[(size_t)(src_bit_offset / 8)];
+	if (shift == 0)
+	{
+		memcpy(dstdata, srcdata, full_bytes);
+		if (tail_bits)
+		{
+			dstdata[full_bytes] = (unsigned char)((dstdata[full_bytes] & ~tail_mask) | (srcdata[full_bytes] & tail_mask));
+		}
+		return;
+	}
+	for (size_t i = 0; i < full_bytes; ++i)
+	{
+		dstdata[i] = (unsigned char)((srcdata[i] << shift) | (srcdata[i + 1] >> (8 - shift)));
+	}
+	if (tail_bits)
+	{
+		unsigned int value = (srcdata[full_bytes] << shift) & 0xFF;
+		if (shift + tail_bits > 8)
+		{
+			value |= srcdata[full_bytes + 1] >> (8 - shift);
+		}
+		dstdata[full_bytes] = (unsigned char)((dstdata[full_bytes] & ~tail_mask) | (value & tail_mask));
+	}
+}
+
+msbtfont_retcode msbtfont_store_font_character_data(const msbtfont_header *header, msbtfont_filedata *filedata, const unsigned char *srcdata, unsigned int index)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_STORE_FONT_CHARACTER_DATA);
+	if (header != NULL)
+	{
+		if (filedata != NULL)
 		{
 			if (srcdata != NULL)
 			{
 				if (filedata->data != NULL)
 				{
-					if (header->magicword_le == MSBTFONT_MSBT)
+					unsigned int font_character_count = 0;
+					if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
 					{
-						if (index < header->font_character_count_le)
-						{
-							unsigned short max_font_width = header->max_font_width + 1;
-							unsigned short max_font_height = header->max_font_height + 1;
-							size_t c_doffset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) / 8);
-							size_t c_soffset = 0;
-							unsigned char dbit_offset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-							unsigned char sbit_offset = 0;
-							unsigned char *base_chardata = &filedata->font_data[c_doffset];
-							if (header->palette_format < 7)
-							{
-								c_doffset = 0;
-								unsigned char bitmask = (0xFF << (7 - header->palette_format));
-								for (unsigned int i = 0; i < max_font_width * max_font_height; ++i)
-								{
-									base_chardata[c_doffset] &= ~(bitmask >> dbit_offset);
-									unsigned char sbit_offset_s = sbit_offset;
-									size_t s_bits_left = (header->palette_format + 1);
-									unsigned char src = ((srcdata[c_soffset] & (bitmask >> sbit_offset)) << sbit_offset);
-									sbit_offset += s_bits_left;
-									if (sbit_offset > 7)
-									{
-										s_bits_left -= (8 - sbit_offset_s);
-										sbit_offset -= 8;
-										++c_soffset;
-										if (s_bits_left > 0)
-										{
-											src |= ((srcdata[c_soffset] >> (8 - s_bits_left)) << (7 - header->palette_format));
-										}
-									}
-									base_chardata[c_doffset] |= (src >> dbit_offset);
-									unsigned char dbit_offset_s = dbit_offset;
-									size_t d_bits_left = (header->palette_format + 1);
-									dbit_offset += d_bits_left;
-									if (dbit_offset > 7)
-									{
-										d_bits_left -= (8 - dbit_offset_s);
-										dbit_offset -= 8;
-										++c_doffset;
-										if (d_bits_left > 0)
-										{
-											base_chardata[c_doffset] &= ~(bitmask << ((header->palette_format + 1) - d_bits_left));
-											base_chardata[c_doffset] |= (src << ((header->palette_format + 1) - d_bits_left));
-										}
-									}
-								}
-							}
-							else
-							{
-								memcpy(base_chardata, srcdata, max_font_width * max_font_height);
-							}
-							return MSBTFONT_SUCCESS;
-						}
-						else
-						{
-							return MSBTFONT_INDEX_OUT_OF_BOUNDS;
-						}
+						return MSBTFONT_INVALID_HEADER;
 					}
-					else if (header->magicword_be == MSBTFONT_TBSM)
+					if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
 					{
-						if (index < header->font_character_count_be)
-						{
-							unsigned short max_font_width = header->max_font_width + 1;
-							unsigned short max_font_height = header->max_font_height + 1;
-							size_t c_doffset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) / 8);
-							size_t c_soffset = 0;
-							unsigned char dbit_offset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-							unsigned char sbit_offset = 0;
-							unsigned char *base_chardata = &filedata->font_data[c_doffset];
-							if (header->palette_format < 7)
-							{
-								c_doffset = 0;
-								unsigned char bitmask = (0xFF << (7 - header->palette_format));
-								for (unsigned int i = 0; i < max_font_width * max_font_height; ++i)
-								{
-									base_chardata[c_soffset] &= ~(bitmask >> dbit_offset);
-									unsigned char sbit_offset_s = sbit_offset;
-									size_t s_bits_left = (header->palette_format + 1);
-									unsigned char src = ((srcdata[c_soffset] & (bitmask >> sbit_offset)) << sbit_offset);
-									sbit_offset += s_bits_left;
-									if (sbit_offset > 7)
-									{
-										s_bits_left -= (8 - sbit_offset_s);
-										sbit_offset -= 8;
-										++c_soffset;
-										if (s_bits_left > 0)
-										{
-											src |= ((srcdata[c_soffset] >> (8 - s_bits_left)) << (7 - header->palette_format));
-										}	
-									}
-									base_chardata[c_doffset] |= (src >> dbit_offset);
-									unsigned char dbit_offset_s = dbit_offset;
-									size_t d_bits_left = (header->palette_format + 1);
-									dbit_offset += d_bits_left;
-									if (dbit_offset > 7)
-									{
-										d_bits_left -= (8 - dbit_offset_s);
-										dbit_offset -= 8;
-										++c_doffset;
-										if (d_bits_left > 0)
-										{
-											base_chardata[c_doffset] &= ~(bitmask << ((header->palette_format + 1) - d_bits_left));
-											base_chardata[c_doffset] |= (src << ((header->palette_format + 1) - d_bits_left));
-										}
-									}
-								}
-							}
-							else
-							{
-								memcpy(base_chardata, srcdata, max_font_width * max_font_height);
-							}
-							return MSBTFONT_SUCCESS;
-						}
-						else
-						{
-							return MSBTFONT_INDEX_OUT_OF_BOUNDS;
-						}
+						return MSBTFONT_DEDUPLICATED_FONT;
+					}
+					font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+					msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+					if (retcode != MSBTFONT_SUCCESS)
+					{
+						return retcode;
+					}
+					if (index < font_character_count)
+					{
+						unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+						msbtfont_pack_bits(filedata->font_data, index * character_bits, srcdata, character_bits);
+						msbtfont_mark_dirty(msbtfont_get_dirty_tracker(filedata), index, 1);
+						MSBTFONT_STATS_END(MSBTFONT_STATS_STORE_FONT_CHARACTER_DATA);
+						return MSBTFONT_SUCCESS;
 					}
 					else
 					{
-						return MSBTFONT_INVALID_HEADER;
+						return MSBTFONT_INDEX_OUT_OF_BOUNDS;
 					}
 				}
 				else
@@ -304,8 +790,57 @@ msbtfont_retcode msbtfont_store_font_character_data(const msbtfont_header *heade
 	}
 }
 
+msbtfont_retcode msbtfont_store_font_characters(const msbtfont_header *header, msbtfont_filedata *filedata, const unsigned char *srcdata, unsigned int first_index, unsigned int count)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_STORE_FONT_CHARACTER_DATA);
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (srcdata == NULL)
+	{
+		return MSBTFONT_MISSING_SOURCE_DATA;
+	}
+	if (filedata->data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		return MSBTFONT_DEDUPLICATED_FONT;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (first_index > font_character_count || count > font_character_count - first_index)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	// Consecutive characters are consecutive in the font data, so the whole range is one copy
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	if (count != 0)
+	{
+		msbtfont_pack_bits(filedata->font_data, first_index * character_bits, srcdata, count * character_bits);
+	}
+	msbtfont_mark_dirty(msbtfont_get_dirty_tracker(filedata), first_index, count);
+	MSBTFONT_STATS_END(MSBTFONT_STATS_STORE_FONT_CHARACTER_DATA);
+	return MSBTFONT_SUCCESS;
+}
+
 msbtfont_retcode msbtfont_load_font_character_data(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned char *dstdata, unsigned int index)
 {
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_LOAD_FONT_CHARACTER_DATA);
 	if (header != NULL)
 	{
 		if (filedata != NULL)
@@ -314,129 +849,34 @@ msbtfont_retcode msbtfont_load_font_character_data(const msbtfont_header *header
 			{
 				if (filedata->data != NULL)
 				{
-					if (header->magicword_le == MSBTFONT_MSBT)
+					unsigned int font_character_count = 0;
+					if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
 					{
-						if (index < header->font_character_count_le)
-						{
-							unsigned short max_font_width = header->max_font_width + 1;
-							unsigned short max_font_height = header->max_font_height + 1;
-							size_t c_soffset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) / 8);
-							size_t c_doffset = 0;
-							unsigned char sbit_offset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-							unsigned char dbit_offset = 0;
-							const unsigned char *base_chardata = &filedata->font_data[c_soffset];
-							if (header->palette_format < 7)
-							{
-								c_soffset = 0;
-								unsigned char bitmask = (0xFF << (7 - header->palette_format));
-								for (unsigned int i = 0; i < max_font_width * max_font_height; ++i)
-								{
-									unsigned char sbit_offset_s = sbit_offset;
-									size_t s_bits_left = (header->palette_format + 1);
-									unsigned char src = ((base_chardata[c_soffset] & (bitmask >> sbit_offset)) << sbit_offset);
-									sbit_offset += s_bits_left;
-									if (sbit_offset > 7)
-									{
-										s_bits_left -= (8 - sbit_offset_s);
-										sbit_offset -= 8;
-										++c_soffset;
-										if (s_bits_left > 8)
-										{
-											src |= ((base_chardata[c_soffset] >> (8 - s_bits_left)) << (7 - header->palette_format));
-										}
-									}
-									dstdata[c_doffset] &= ~(bitmask >> dbit_offset);
-									dstdata[c_doffset] |= (src >> dbit_offset);
-									unsigned char dbit_offset_s = dbit_offset;
-									size_t d_bits_left = (header->palette_format + 1);
-									dbit_offset += d_bits_left;
-									if (dbit_offset > 7)
-									{
-										d_bits_left -= (8 - dbit_offset_s);
-										dbit_offset -= 8;
-										++c_doffset;
-										if (d_bits_left > 8)
-										{
-											dstdata[c_doffset] &= ~(bitmask << ((header->palette_format + 1) - d_bits_left));
-											dstdata[c_doffset] |= (src << ((header->palette_format + 1) - d_bits_left));
-										}
-									}
-								}
-							}
-							else
-							{
-								memcpy(dstdata, base_chardata, max_font_width * max_font_height);
-							}
-							return MSBTFONT_SUCCESS;
-						}
-						else
-						{
-							return MSBTFONT_INDEX_OUT_OF_BOUNDS;
-						}
+						return MSBTFONT_INVALID_HEADER;
 					}
-					else if (header->magicword_be == MSBTFONT_TBSM)
+					font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+					msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+					if (retcode != MSBTFONT_SUCCESS)
 					{
-						if (index < header->font_character_count_be)
-						{
-							unsigned short max_font_width = header->max_font_width + 1;
-							unsigned short max_font_height = header->max_font_height + 1;
-							size_t c_soffset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) / 8);
-							size_t c_doffset = 0;
-							unsigned char sbit_offset = ((index * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-							unsigned char dbit_offset = 0;
-							const unsigned char *base_chardata = &filedata->font_data[c_soffset];
-							if (header->palette_format < 7)
-							{
-								c_soffset = 0;
-								unsigned char bitmask = (0xFF << (7 - header->palette_format));
-								for (unsigned int i = 0; i < max_font_width * max_font_height; ++i)
-								{
-									unsigned char sbit_offset_s = sbit_offset;
-									size_t s_bits_left = (header->palette_format + 1);
-									unsigned char src = ((base_chardata[c_soffset] & (bitmask >> sbit_offset)) << sbit_offset);
-									sbit_offset += s_bits_left;
-									if (sbit_offset > 7)
-									{
-										s_bits_left -= (8 - sbit_offset_s);
-										sbit_offset -= 8;
-										++c_soffset;
-										if (s_bits_left > 8)
-										{
-											src |= ((base_chardata[c_soffset] >> (8 - s_bits_left)) << (7 - header->palette_format));
-										}
-									}
-									dstdata[c_doffset] &= ~(bitmask >> dbit_offset);
-									dstdata[c_doffset] |= (src >> dbit_offset);
-									unsigned char dbit_offset_s = dbit_offset;
-									size_t d_bits_left = (header->palette_format + 1);
-									dbit_offset += d_bits_left;
-									if (dbit_offset > 7)
-									{
-										d_bits_left -= (8 - dbit_offset_s);
-										dbit_offset -= 8;
-										++c_doffset;
-										if (d_bits_left > 8)
-										{
-											dstdata[c_doffset] &= ~(bitmask << ((header->palette_format + 1) - d_bits_left));
-											dstdata[c_doffset] |= (src << ((header->palette_format + 1) - d_bits_left));
-										}
-									}
-								}
-							}
-							else
-							{
-								memcpy(dstdata, base_chardata, max_font_width * max_font_height);
-							}
-							return MSBTFONT_SUCCESS;
-						}
-						else
+						return retcode;
+					}
+					if (index < font_character_count)
+					{
+						unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+						unsigned int glyph = msbtfont_get_glyph(msbtfont_get_glyph_table(header, filedata), index);
+						if (glyph == MSBTFONT_NO_GLYPH)
 						{
-							return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+							return MSBTFONT_INVALID_FILEDATA;
 						}
+						msbtfont_unpack_bits(dstdata, filedata->font_data, glyph * character_bits, character_bits);
+						MSBTFONT_STATS_ADD(characters_decoded, 1);
+						MSBTFONT_STATS_ADD(font_data_bytes_read, (character_bits + 7) / 8);
+						MSBTFONT_STATS_END(MSBTFONT_STATS_LOAD_FONT_CHARACTER_DATA);
+						return MSBTFONT_SUCCESS;
 					}
 					else
 					{
-						return MSBTFONT_INVALID_HEADER;
+						return MSBTFONT_INDEX_OUT_OF_BOUNDS;
 					}
 				}
 				else
@@ -462,6 +902,7 @@ msbtfont_retcode msbtfont_load_font_character_data(const msbtfont_header *header
 
 msbtfont_retcode msbtfont_get_surface_size(const msbtfont_header *header, msbtfont_rect *surface_size, unsigned int characters_per_row)
 {
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_GET_SURFACE_SIZE);
 	if (header != NULL)
 	{
 		if (surface_size != NULL)
@@ -469,24 +910,20 @@ msbtfont_retcode msbtfont_get_surface_size(const msbtfont_header *header, msbtfo
 			if (characters_per_row > 0)
 			{
 				unsigned int font_character_count = 0;
-				if (header->magicword_le == MSBTFONT_MSBT)
-				{
-					font_character_count = header->font_character_count_le;
-				}
-				else if (header->magicword_be == MSBTFONT_TBSM)
-				{
-					font_character_count = header->font_character_count_be;
-				}
-				else
+				if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
 				{
 					return MSBTFONT_INVALID_HEADER;
 				}
-				surface_size->width = (header->max_font_width + 1) * characters_per_row;
-				surface_size->height = 0;
-				for (unsigned int i = 0; i < font_character_count; i += characters_per_row)
+				font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+				unsigned long long width = (unsigned long long)(header->max_font_width + 1) * characters_per_row;
+				unsigned long long height = ((font_character_count / characters_per_row) + ((font_character_count % characters_per_row) ? 1 : 0)) * (unsigned long long)(header->max_font_height + 1);
+				if (width > UINT_MAX || height > UINT_MAX)
 				{
-					surface_size->height += (header->max_font_height + 1);
+					return MSBTFONT_SURFACE_TOO_LARGE;
 				}
+				surface_size->width = (unsigned int)(width);
+				surface_size->height = (unsigned int)(height);
+				MSBTFONT_STATS_END(MSBTFONT_STATS_GET_SURFACE_SIZE);
 				return MSBTFONT_NO_ERROR;
 			}
 			else
@@ -509,7 +946,10 @@ size_t msbtfont_get_surface_memory_requirement(const msbtfont_surface_descriptor
 {
 	if (surface_descriptor != NULL)
 	{
-		if (surface_descriptor->rect.width == 0 || surface_descriptor->rect.height == 0)
+		unsigned long long width = surface_descriptor->rect.width;
+		unsigned long long height = surface_descriptor->rect.height;
+		unsigned long long memory_requirement = 0;
+		if (width == 0 || height == 0)
 		{
 			return 0;
 		}
@@ -517,28 +957,34 @@ size_t msbtfont_get_surface_memory_requirement(const msbtfont_surface_descriptor
 		{
 			case MSBTFONT_SURFACE_FORMAT_8:
 			{
-				size_t stride_check = surface_descriptor->rect.width % 4;
-				return (surface_descriptor->rect.width + (stride_check ? 4 - stride_check : 0)) * surface_descriptor->rect.height;
+				unsigned long long stride_check = width % 4;
+				memory_requirement = (width + (stride_check ? 4 - stride_check : 0)) * height;
+				break;
 			}
 			case MSBTFONT_SURFACE_FORMAT_16_8:
 			{
-				size_t stride_check = (surface_descriptor->rect.width * 2) % 4;
-				return (surface_descriptor->rect.width + (stride_check ? 4 - stride_check : 0)) * surface_descriptor->rect.height * 2;
+				unsigned long long stride_check = (width * 2) % 4;
+				memory_requirement = (width + (stride_check ? 4 - stride_check : 0)) * height * 2;
+				break;
 			}
 			case MSBTFONT_SURFACE_FORMAT_24_8:
 			{
-				size_t stride_check = (surface_descriptor->rect.width * 3) % 4;
-				return (surface_descriptor->rect.width + (stride_check ? 4 - stride_check : 0)) * surface_descriptor->rect.height * 3;
+				unsigned long long stride_check = (width * 3) % 4;
+				memory_requirement = (width + (stride_check ? 4 - stride_check : 0)) * height * 3;
+				break;
 			}
 			case MSBTFONT_SURFACE_FORMAT_32_8:
 			{
-				return surface_descriptor->rect.width * surface_descriptor->rect.height * 4;
+				memory_requirement = width * height * 4;
+				break;
 			}
 			default:
 			{
 				return 0;
 			}
 		}
+		// Surfaces that can't be addressed on this platform report 0 like invalid ones
+		return (memory_requirement > (unsigned long long)(SIZE_MAX)) ? 0 : (size_t)(memory_requirement);
 	}
 	else
 	{
@@ -546,1011 +992,2973 @@ size_t msbtfont_get_surface_memory_requirement(const msbtfont_surface_descriptor
 	}
 }
 
-msbtfont_retcode msbtfont_copy_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data)
+typedef struct msbtfont_surface_layout
 {
-	if (header != NULL)
+	size_t pixel_size; // Bytes per surface pixel
+	size_t pitch; // Bytes per surface row (including alignment padding)
+} msbtfont_surface_layout;
+
+static int msbtfont_get_surface_layout(const msbtfont_surface_descriptor *surface_descriptor, msbtfont_surface_layout *layout)
+{
+	switch (surface_descriptor->format)
 	{
-		if (filedata != NULL)
+		case MSBTFONT_SURFACE_FORMAT_8:
 		{
-			if (surface_descriptor != NULL)
+			layout->pixel_size = 1;
+			break;
+		}
+		case MSBTFONT_SURFACE_FORMAT_16_8:
+		{
+			layout->pixel_size = 2;
+			break;
+		}
+		case MSBTFONT_SURFACE_FORMAT_24_8:
+		{
+			layout->pixel_size = 3;
+			break;
+		}
+		case MSBTFONT_SURFACE_FORMAT_32_8:
+		{
+			layout->pixel_size = 4;
+			break;
+		}
+		default:
+		{
+			return 0;
+		}
+	}
+	layout->pitch = (size_t)(surface_descriptor->rect.width) * layout->pixel_size;
+	if (layout->pitch % 4)
+	{
+		layout->pitch += 4 - (layout->pitch % 4);
+	}
+	return 1;
+}
+
+static void msbtfont_decode_pixels(const unsigned char *font_data, unsigned long long bit_offset, unsigned char bits_per_pixel, size_t count, unsigned char *dstdata)
+{
+	if (bits_per_pixel == 8)
+	{
+		memcpy(dstdata, &font_data[(size_t)(bit_offset / 8)], count);
+		return;
+	}
+	unsigned char pixel_mask = (unsigned char)((1 << bits_per_pixel) - 1);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const unsigned char *src = &font_data[(size_t)(bit_offset / 8)];
+		unsigned int bit_shift = (unsigned int)(bit_offset % 8) + bits_per_pixel;
+		unsigned int window = (unsigned int)(src[0]) << 8;
+		if (bit_shift > 8)
+		{
+			window |= src[1];
+		}
+		dstdata[i] = (unsigned char)((window >> (16 - bit_shift)) & pixel_mask);
+		bit_offset += bits_per_pixel;
+	}
+}
+
+static void msbtfont_encode_pixels(unsigned char *font_data, unsigned long long bit_offset, unsigned char bits_per_pixel, size_t count, const unsigned char *srcdata)
+{
+	if (bits_per_pixel == 8)
+	{
+		memcpy(&font_data[(size_t)(bit_offset / 8)], srcdata, count);
+		return;
+	}
+	unsigned int pixel_mask = (1u << bits_per_pixel) - 1;
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned char *dst = &font_data[(size_t)(bit_offset / 8)];
+		unsigned int bit_shift = 16 - ((unsigned int)(bit_offset % 8) + bits_per_pixel);
+		unsigned int mask = pixel_mask << bit_shift;
+		unsigned int value = ((unsigned int)(srcdata[i]) << bit_shift) & mask;
+		dst[0] = (unsigned char)((dst[0] & ~(mask >> 8)) | (value >> 8));
+		if (mask & 0xFF)
+		{
+			dst[1] = (unsigned char)((dst[1] & ~mask) | value);
+		}
+		bit_offset += bits_per_pixel;
+	}
+}
+
+static void msbtfont_write_surface_row(unsigned char *surface_row, size_t pixel_size, const unsigned char *pixels, size_t count)
+{
+	if (pixel_size == 1)
+	{
+		memcpy(surface_row, pixels, count);
+		return;
+	}
+	for (size_t x = 0; x < count; ++x)
+	{
+		surface_row[x * pixel_size] = pixels[x];
+	}
+}
+
+// Per palette index terms of a blend mode, built once per copy.  'sources' holds the color
+// weighted by the coverage of each index (the replacement pixel for MSBTFONT_BLEND_COLORIZE)
+// and 'weights' what is left to the destination, so blending a pixel is one multiply and add
+// per component.  Indices above the highest one of the palette format (outline and shadow
+// indices) count as full coverage.
+typedef struct msbtfont_blend_table
+{
+	msbtfont_blend_mode mode;
+	unsigned char sources[256][4];
+	unsigned char weights[256];
+} msbtfont_blend_table;
+
+// Rounded division by 255 for values up to 255 * 255
+static unsigned int msbtfont_div255(unsigned int value)
+{
+	value += 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+static void msbtfont_build_blend_table(const msbtfont_blend_descriptor *blend_descriptor, unsigned char max_index, msbtfont_blend_table *blend_table)
+{
+	unsigned int alpha = (blend_descriptor->color >> 24) & 0xFF;
+	blend_table->mode = blend_descriptor->mode;
+	for (unsigned int index = 0; index < 256; ++index)
+	{
+		unsigned int coverage = (index >= max_index) ? 255 : ((index * 255) + (max_index / 2)) / max_index;
+		unsigned int weight = msbtfont_div255(coverage * alpha);
+		for (unsigned int component = 0; component < 4; ++component)
+		{
+			// The alpha component composites as if the color were opaque:  a + d * (1 - a)
+			unsigned int value = (component == 3) ? 255 : (blend_descriptor->color >> (component * 8)) & 0xFF;
+			if (blend_descriptor->mode == MSBTFONT_BLEND_COLORIZE)
 			{
-				if (surface_data != NULL)
-				{
-					unsigned int font_character_count = 0;
-					unsigned short max_font_width = header->max_font_width + 1;
-					unsigned short max_font_height = header->max_font_height + 1;
-					size_t font_offset_x = surface_descriptor->rect.x;
-					size_t font_offset_y = surface_descriptor->rect.y;
-					if (header->magicword_le == MSBTFONT_MSBT)
-					{
-						font_character_count = header->font_character_count_le;
-					}
-					else if (header->magicword_be == MSBTFONT_TBSM)
-					{
-						font_character_count = header->font_character_count_be;
-					}
-					else
-					{
-						return MSBTFONT_INVALID_HEADER;
-					}
-					if (surface_descriptor->rect.width == 0 || surface_descriptor->rect.height == 0)
-					{
-						return MSBTFONT_NO_SURFACE_AREA;
-					}
-					if (filedata->font_data == NULL)
-					{
-						return MSBTFONT_FILEDATA_NOT_INITIALIZED;
-					}
-					if (character_start_offset != 0)
-					{
-						font_offset_x += (character_start_offset * max_font_width);
-						if (font_offset_x >= surface_descriptor->rect.width)
-						{
-							size_t new_font_offset_x = font_offset_x % surface_descriptor->rect.width;
-							size_t row_count = font_offset_x / surface_descriptor->rect.width;
-							font_offset_x = new_font_offset_x;
-							font_offset_y += row_count * max_font_height;
-							if (font_offset_y >= surface_descriptor->rect.height)
-							{
-								return MSBTFONT_SUCCESS;
-							}
-						}
-					}
-					switch (surface_descriptor->format)
-					{
-						case MSBTFONT_SURFACE_FORMAT_8:
-						{
-							size_t stride_check = surface_descriptor->rect.width % 4;
-							switch (surface_descriptor->origin)
-							{
-								case MSBTFONT_SURFACE_ORIGIN_UPPERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x + ((stride_check ? (4 - stride_check) : 0) * (y + font_offset_y))] = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x + ((stride_check ? (4 - stride_check) : 0) * (y + font_offset_y))] = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-								case MSBTFONT_SURFACE_ORIGIN_LOWERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data[((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x + ((stride_check ? (4 - stride_check) : 0) * (surface_descriptor->rect.height - 1 - font_offset_y - y))] = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (characters_per_row != 0)
-												{
-													size_t index_mod = character_start_offset + i;
-													if (index_mod != 0 && (index_mod % characters_per_row == 0))
-													{
-														font_offset_x = surface_descriptor->rect.x;
-														font_offset_y += max_font_height;
-														if (font_offset_y >= surface_descriptor->rect.height)
-														{
-															break;
-														}
-													}
-												}
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data[((max_font_height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x + ((stride_check ? (4 - stride_check) : 0) * (surface_descriptor->rect.height - 1 - font_offset_y - y))] = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-							}
-							break;
-						}
-						case MSBTFONT_SURFACE_FORMAT_16_8:
-						{
-							typedef struct rg8
-							{
-								unsigned char r;
-								unsigned char g;
-							} rg8;
-							rg8 *surface_data_rg8 = (rg8 *)(surface_data);
-							size_t stride_check = surface_descriptor->rect.width % 2;
-							switch (surface_descriptor->origin)
-							{
-								case MSBTFONT_SURFACE_ORIGIN_UPPERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data_rg8[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x + (stride_check * (font_offset_y + y))].r = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data_rg8[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x].r = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x + (stride_check * (font_offset_y + y))];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-								case MSBTFONT_SURFACE_ORIGIN_LOWERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data_rg8[((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x + (stride_check * (surface_descriptor->rect.height - 1 - font_offset_y - y))].r = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data_rg8[((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x].r = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x + (stride_check * (surface_descriptor->rect.height - 1 - font_offset_y - y))];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-							}
-							break;
-						}
-						case MSBTFONT_SURFACE_FORMAT_24_8:
-						{
-							size_t stride_check = (surface_descriptor->rect.width * 3) % 4;
-							switch (surface_descriptor->origin)
-							{
-								case MSBTFONT_SURFACE_ORIGIN_UPPERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data[(((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x) * 3 + ((stride_check ? 4 - stride_check : 0) * (y + font_offset_y))] = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data[(((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x) * 3 + ((stride_check ? (4 - stride_check) : 0) * (y + font_offset_y))] = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-								case MSBTFONT_SURFACE_ORIGIN_LOWERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data[(((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x) * 3 + ((stride_check ? (4 - stride_check) : 0) * (surface_descriptor->rect.height - 1 - font_offset_y - y))] = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data[(((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x) * 3 + ((stride_check ? 4 - stride_check : 0) * (surface_descriptor->rect.height - 1 - font_offset_y - y))] = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-							}
-							break;
-						}
-						case MSBTFONT_SURFACE_FORMAT_32_8:
-						{
-							typedef struct rgba8
-							{
-								unsigned char r;
-								unsigned char g;
-								unsigned char b;
-								unsigned char a;
-							} rgba8;
-							rgba8 *surface_data_rgba8 = (rgba8 *)(surface_data);
-							switch (surface_descriptor->origin)
-							{
-								case MSBTFONT_SURFACE_ORIGIN_UPPERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % 8);
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / 8)];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data_rgba8[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x].r = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data_rgba8[((y + font_offset_y) * surface_descriptor->rect.width) + font_offset_x + x].r = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-								case MSBTFONT_SURFACE_ORIGIN_LOWERLEFT:
-								{
-									if (header->palette_format < 7)
-									{
-										unsigned char bitmask = (0xFF << (7 - header->palette_format));
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											size_t c_offset = 0;
-											unsigned char bit_offset = ((i * (header->palette_format + 1) * max_font_width * max_font_height) % (8 - header->palette_format));
-											unsigned char *base_chardata = &filedata->font_data[((i * (header->palette_format + 1) * max_font_width * max_font_height) / (8 - header->palette_format))];
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													size_t bits_left = (header->palette_format + 1);
-													unsigned char pixel = ((base_chardata[c_offset] & (bitmask >> bit_offset)) << bit_offset);
-													unsigned char bit_offset_s = bit_offset;
-													bit_offset += bits_left;
-													if (bit_offset > 7)
-													{
-														bits_left -= (8 - bit_offset_s);
-														bit_offset -= 8;
-														++c_offset;
-														if (bits_left > 0)
-														{
-															pixel |= ((base_chardata[c_offset] >> (8 - bits_left)) << (7 - header->palette_format));
-														}
-													}
-													pixel >>= (7 - header->palette_format);
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														continue;
-													}
-													surface_data_rgba8[((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x].r = pixel;
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									else
-									{
-										for (unsigned int i = 0; i < font_character_count; ++i)
-										{
-											if (characters_per_row != 0)
-											{
-												size_t index_mod = character_start_offset + i;
-												if (index_mod != 0 && (index_mod % characters_per_row == 0))
-												{
-													font_offset_x = surface_descriptor->rect.x;
-													font_offset_y += max_font_height;
-													if (font_offset_y >= surface_descriptor->rect.height)
-													{
-														break;
-													}
-												}
-											}
-											for (unsigned short y = 0; y < max_font_height; ++y)
-											{
-												if (font_offset_y + y >= surface_descriptor->rect.height)
-												{
-													break;
-												}
-												for (unsigned short x = 0; x < max_font_width; ++x)
-												{
-													if (font_offset_x + x >= surface_descriptor->rect.width)
-													{
-														break;
-													}
-													surface_data_rgba8[((surface_descriptor->rect.height - 1 - font_offset_y - y) * surface_descriptor->rect.width) + font_offset_x + x].r = filedata->font_data[(i * max_font_width * max_font_height) + (y * max_font_width) + x];
-												}
-											}
-											font_offset_x += max_font_width;
-											if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
-											{
-												font_offset_x = surface_descriptor->rect.x;
-												font_offset_y += max_font_height;
-											}
-											if (font_offset_y >= surface_descriptor->rect.height)
-											{
-												break;
-											}
-										}
-									}
-									break;
-								}
-							}
-							break;
-						}
-						default:
-						{
-							return MSBTFONT_UNSUPPORTED_SURFACE_FORMAT;
-						}
-					}
-					return MSBTFONT_SUCCESS;
-				}
-				else
-				{
-					return MSBTFONT_MISSING_SURFACE_DATA;
-				}
+				blend_table->sources[index][component] = (unsigned char)((component == 3) ? weight : value);
 			}
 			else
 			{
-				return MSBTFONT_MISSING_SURFACE_DESCRIPTOR;
+				blend_table->sources[index][component] = (unsigned char)(msbtfont_div255(value * weight));
 			}
 		}
+		blend_table->weights[index] = (unsigned char)(255 - weight);
+	}
+}
+
+static void msbtfont_blend_surface_row(unsigned char *surface_row, const msbtfont_blend_table *blend_table, const unsigned char *pixels, size_t count)
+{
+	size_t x = 0;
+	if (blend_table->mode == MSBTFONT_BLEND_COLORIZE)
+	{
+		for (; x < count; ++x)
+		{
+			memcpy(&surface_row[x * 4], blend_table->sources[pixels[x]], 4);
+		}
+		return;
+	}
+#if defined(MSBTFONT_SSE2)
+	// 4 pixels at a time; Groups without coverage (most of a glyph) are skipped untouched
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(128);
+	for (; x + 4 <= count; x += 4)
+	{
+		if ((pixels[x] | pixels[x + 1] | pixels[x + 2] | pixels[x + 3]) == 0)
+		{
+			continue;
+		}
+		int sources[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			memcpy(&sources[i], blend_table->sources[pixels[x + i]], 4);
+		}
+		__m128i source = _mm_setr_epi32(sources[0], sources[1], sources[2], sources[3]);
+		__m128i destination = _mm_loadu_si128((const __m128i *)(&surface_row[x * 4]));
+		if (blend_table->mode == MSBTFONT_BLEND_ADDITIVE)
+		{
+			destination = _mm_adds_epu8(destination, source);
+		}
 		else
 		{
-			return MSBTFONT_MISSING_FILEDATA;
+			short weight_0 = blend_table->weights[pixels[x]];
+			short weight_1 = blend_table->weights[pixels[x + 1]];
+			short weight_2 = blend_table->weights[pixels[x + 2]];
+			short weight_3 = blend_table->weights[pixels[x + 3]];
+			__m128i low = _mm_mullo_epi16(_mm_unpacklo_epi8(destination, zero), _mm_setr_epi16(weight_0, weight_0, weight_0, weight_0, weight_1, weight_1, weight_1, weight_1));
+			__m128i high = _mm_mullo_epi16(_mm_unpackhi_epi8(destination, zero), _mm_setr_epi16(weight_2, weight_2, weight_2, weight_2, weight_3, weight_3, weight_3, weight_3));
+			low = _mm_add_epi16(low, rounding);
+			high = _mm_add_epi16(high, rounding);
+			low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+			high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+			destination = _mm_add_epi8(_mm_packus_epi16(low, high), source);
 		}
+		_mm_storeu_si128((__m128i *)(&surface_row[x * 4]), destination);
 	}
-	else
+#endif
+	for (; x < count; ++x)
 	{
-		return MSBTFONT_MISSING_HEADER;
+		unsigned char index = pixels[x];
+		if (index == 0)
+		{
+			continue;
+		}
+		unsigned char *destination = &surface_row[x * 4];
+		for (unsigned int component = 0; component < 4; ++component)
+		{
+			unsigned int value = blend_table->sources[index][component];
+			if (blend_table->mode == MSBTFONT_BLEND_ADDITIVE)
+			{
+				value += destination[component];
+				destination[component] = (unsigned char)((value > 255) ? 255 : value);
+			}
+			else
+			{
+				destination[component] = (unsigned char)(value + msbtfont_div255(destination[component] * (unsigned int)(blend_table->weights[index])));
+			}
+		}
+	}
+}
+
+static void msbtfont_read_surface_row(const unsigned char *surface_row, size_t pixel_size, unsigned char max_index, unsigned char *pixels, size_t count)
+{
+	for (size_t x = 0; x < count; ++x)
+	{
+		unsigned char pixel = surface_row[x * pixel_size];
+		pixels[x] = (pixel > max_index) ? max_index : pixel;
+	}
+}
+
+typedef void (*msbtfont_character_callback)(void *context, unsigned int index, size_t offset_x, size_t offset_y);
+
+static void msbtfont_walk_surface_grid(unsigned int font_character_count, unsigned short max_font_width, unsigned short max_font_height, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, msbtfont_character_callback callback, void *context)
+{
+	size_t font_offset_x = surface_descriptor->rect.x;
+	size_t font_offset_y = surface_descriptor->rect.y;
+	if (character_start_offset != 0)
+	{
+		font_offset_x += ((size_t)(character_start_offset) * max_font_width);
+		if (font_offset_x >= surface_descriptor->rect.width)
+		{
+			size_t new_font_offset_x = font_offset_x % surface_descriptor->rect.width;
+			size_t row_count = font_offset_x / surface_descriptor->rect.width;
+			font_offset_x = new_font_offset_x;
+			font_offset_y += row_count * max_font_height;
+			if (font_offset_y >= surface_descriptor->rect.height)
+			{
+				return;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < font_character_count; ++i)
+	{
+		if (characters_per_row != 0)
+		{
+			size_t index_mod = (size_t)(character_start_offset) + i;
+			if (index_mod != 0 && (index_mod % characters_per_row == 0))
+			{
+				font_offset_x = surface_descriptor->rect.x;
+				font_offset_y += max_font_height;
+				if (font_offset_y >= surface_descriptor->rect.height)
+				{
+					break;
+				}
+			}
+		}
+		callback(context, i, font_offset_x, font_offset_y);
+		font_offset_x += max_font_width;
+		if (characters_per_row == 0 && font_offset_x >= surface_descriptor->rect.width)
+		{
+			font_offset_x = surface_descriptor->rect.x;
+			font_offset_y += max_font_height;
+		}
+		if (font_offset_y >= surface_descriptor->rect.height)
+		{
+			break;
+		}
 	}
 }
+
+// Rows of the grid 'msbtfont_walk_surface_grid' lays characters out on.  Character 0 sits at
+// (first_x, first_y), the first row holds 'first_row_count' characters (0 if the start offset
+// lands on a row break) and every later row holds 'row_count' characters from 'rect.x' on.
+typedef struct msbtfont_grid_rows
+{
+	size_t first_x;
+	size_t first_y;
+	size_t first_row_count;
+	size_t row_count;
+} msbtfont_grid_rows;
+
+static void msbtfont_get_grid_rows(unsigned short max_font_width, unsigned short max_font_height, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, msbtfont_grid_rows *grid_rows)
+{
+	size_t surface_width = surface_descriptor->rect.width;
+	grid_rows->first_x = surface_descriptor->rect.x;
+	grid_rows->first_y = surface_descriptor->rect.y;
+	if (character_start_offset != 0)
+	{
+		grid_rows->first_x += ((size_t)(character_start_offset) * max_font_width);
+		if (grid_rows->first_x >= surface_width)
+		{
+			grid_rows->first_y += (grid_rows->first_x / surface_width) * max_font_height;
+			grid_rows->first_x %= surface_width;
+		}
+	}
+	if (characters_per_row != 0)
+	{
+		// Rows break whenever 'character_start_offset + index' reaches a non-zero multiple of 'characters_per_row'
+		grid_rows->first_row_count = (character_start_offset == 0) ? characters_per_row : (characters_per_row - (character_start_offset % characters_per_row)) % characters_per_row;
+		grid_rows->row_count = characters_per_row;
+		return;
+	}
+	// Without a fixed row length, rows wrap once the next character would start past the width
+	grid_rows->first_row_count = (grid_rows->first_x < surface_width) ? (surface_width - grid_rows->first_x + max_font_width - 1) / max_font_width : 1;
+	grid_rows->row_count = (surface_descriptor->rect.x < surface_width) ? (surface_width - surface_descriptor->rect.x + max_font_width - 1) / max_font_width : 1;
+}
+
+// Position 'msbtfont_walk_surface_grid' hands to character 'index', computed directly so a few
+// characters can be placed without walking the whole font.
+static void msbtfont_get_grid_position(unsigned short max_font_width, unsigned short max_font_height, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned int index, size_t *offset_x, size_t *offset_y)
+{
+	msbtfont_grid_rows grid_rows;
+	msbtfont_get_grid_rows(max_font_width, max_font_height, characters_per_row, character_start_offset, surface_descriptor, &grid_rows);
+	if (index < grid_rows.first_row_count)
+	{
+		*offset_x = grid_rows.first_x + ((size_t)(index) * max_font_width);
+		*offset_y = grid_rows.first_y;
+		return;
+	}
+	size_t remaining = index - grid_rows.first_row_count;
+	*offset_x = surface_descriptor->rect.x + ((remaining % grid_rows.row_count) * max_font_width);
+	*offset_y = grid_rows.first_y + ((1 + (remaining / grid_rows.row_count)) * max_font_height);
+}
+
+// Same as 'msbtfont_walk_surface_grid', but only hands out the characters whose cells overlap
+// 'clip_rect' (in grid coordinates and within the surface).  Rows and columns outside it are
+// skipped arithmetically, so the cost depends on the size of the clip rect rather than the
+// number of characters.
+static void msbtfont_walk_clipped_grid(unsigned int font_character_count, unsigned short max_font_width, unsigned short max_font_height, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_rect *clip_rect, msbtfont_character_callback callback, void *context)
+{
+	msbtfont_grid_rows grid_rows;
+	msbtfont_get_grid_rows(max_font_width, max_font_height, characters_per_row, character_start_offset, surface_descriptor, &grid_rows);
+	size_t clip_left = clip_rect->x;
+	size_t clip_top = clip_rect->y;
+	size_t clip_right = clip_left + clip_rect->width;
+	size_t clip_bottom = clip_top + clip_rect->height;
+	if (clip_bottom <= grid_rows.first_y)
+	{
+		return;
+	}
+	size_t first_row = (clip_top > grid_rows.first_y) ? (clip_top - grid_rows.first_y) / max_font_height : 0;
+	size_t end_row = (clip_bottom - grid_rows.first_y + max_font_height - 1) / max_font_height;
+	for (size_t row = first_row; row < end_row; ++row)
+	{
+		size_t first_index = 0;
+		size_t count = grid_rows.first_row_count;
+		size_t row_x = grid_rows.first_x;
+		if (row != 0)
+		{
+			if (grid_rows.first_row_count >= font_character_count || row - 1 > (font_character_count - grid_rows.first_row_count) / grid_rows.row_count)
+			{
+				break;
+			}
+			first_index = grid_rows.first_row_count + ((row - 1) * grid_rows.row_count);
+			count = grid_rows.row_count;
+			row_x = surface_descriptor->rect.x;
+		}
+		if (first_index >= font_character_count)
+		{
+			break;
+		}
+		if (count > font_character_count - first_index)
+		{
+			count = font_character_count - first_index;
+		}
+		size_t first_column = (clip_left > row_x) ? (clip_left - row_x) / max_font_width : 0;
+		size_t end_column = (clip_right > row_x) ? (clip_right - row_x + max_font_width - 1) / max_font_width : 0;
+		if (end_column > count)
+		{
+			end_column = count;
+		}
+		for (size_t column = first_column; column < end_column; ++column)
+		{
+			callback(context, (unsigned int)(first_index + column), row_x + (column * max_font_width), grid_rows.first_y + (row * max_font_height));
+		}
+	}
+}
+
+typedef struct msbtfont_character_blit
+{
+	const unsigned char *font_data;
+	const unsigned char *glyph_table; // NULL when copying glyphs directly (or the font isn't deduplicated)
+	unsigned char bits_per_pixel;
+	unsigned short max_font_width;
+	unsigned short max_font_height;
+	const msbtfont_surface_descriptor *surface_descriptor;
+	msbtfont_surface_layout layout;
+	const msbtfont_effect_descriptor *effect_descriptor;
+	unsigned char *surface_data;
+	msbtfont_rect clip_rect; // Area that may be written in grid coordinates (the whole surface unless clipped)
+	const msbtfont_blend_table *blend_table; // NULL to write palette indices
+} msbtfont_character_blit;
+
+static void msbtfont_output_surface_row(const msbtfont_character_blit *blit, unsigned char *surface_row, const unsigned char *pixels, size_t count)
+{
+	if (blit->blend_table != NULL)
+	{
+		msbtfont_blend_surface_row(surface_row, blit->blend_table, pixels, count);
+		return;
+	}
+	msbtfont_write_surface_row(surface_row, blit->layout.pixel_size, pixels, count);
+}
+
+#define MSBTFONT_EFFECT_ROW_COUNT (MSBTFONT_MAX_EFFECT_RADIUS * 2 + 1)
+
+static void msbtfont_decode_effect_row(const msbtfont_character_blit *blit, unsigned long long character_bit_offset, unsigned short y, unsigned char *dstdata)
+{
+	unsigned char row[256];
+	unsigned char bold = blit->effect_descriptor->bold;
+	msbtfont_decode_pixels(blit->font_data, character_bit_offset + ((unsigned long long)(y) * blit->max_font_width * blit->bits_per_pixel), blit->bits_per_pixel, blit->max_font_width, row);
+	if (bold == 0)
+	{
+		memcpy(dstdata, row, blit->max_font_width);
+		return;
+	}
+	for (unsigned short x = 0; x < blit->max_font_width; ++x)
+	{
+		unsigned char pixel = row[x];
+		for (unsigned short d = 1; d <= bold && d <= x; ++d)
+		{
+			if (row[x - d] > pixel)
+			{
+				pixel = row[x - d];
+			}
+		}
+		dstdata[x] = pixel;
+	}
+}
+
+static void msbtfont_blit_character(void *context, unsigned int index, size_t offset_x, size_t offset_y)
+{
+	const msbtfont_character_blit *blit = (const msbtfont_character_blit *)(context);
+	const msbtfont_surface_descriptor *surface_descriptor = blit->surface_descriptor;
+	unsigned short max_font_width = blit->max_font_width;
+	unsigned short max_font_height = blit->max_font_height;
+	size_t clip_left = blit->clip_rect.x;
+	size_t clip_top = blit->clip_rect.y;
+	size_t clip_right = clip_left + blit->clip_rect.width;
+	size_t clip_bottom = clip_top + blit->clip_rect.height;
+	// Cull the whole cell before touching the font data, then only decode its visible span
+	if (offset_x >= clip_right || offset_y >= clip_bottom || offset_x + max_font_width <= clip_left || offset_y + max_font_height <= clip_top)
+	{
+		return;
+	}
+	unsigned int glyph = msbtfont_get_glyph(blit->glyph_table, index);
+	if (glyph == MSBTFONT_NO_GLYPH)
+	{
+		return;
+	}
+	unsigned long long character_bit_offset = (unsigned long long)(glyph) * blit->bits_per_pixel * max_font_width * max_font_height;
+	size_t first_x = (offset_x < clip_left) ? clip_left - offset_x : 0;
+	size_t first_y = (offset_y < clip_top) ? clip_top - offset_y : 0;
+	size_t end_x = (offset_x + max_font_width > clip_right) ? clip_right - offset_x : max_font_width;
+	size_t end_y = (offset_y + max_font_height > clip_bottom) ? clip_bottom - offset_y : max_font_height;
+	size_t visible_width = end_x - first_x;
+	unsigned char *surface_origin = &blit->surface_data[(offset_x + first_x) * blit->layout.pixel_size];
+	MSBTFONT_STATS_ADD(characters_decoded, 1);
+	MSBTFONT_STATS_ADD(pixels_written, visible_width * (end_y - first_y));
+	MSBTFONT_STATS_ADD(font_data_bytes_read, (((blit->effect_descriptor != NULL) ? (size_t)(blit->bits_per_pixel) * max_font_width * max_font_height : (size_t)(blit->bits_per_pixel) * visible_width * (end_y - first_y)) + 7) / 8);
+	if (blit->effect_descriptor == NULL)
+	{
+		unsigned char row[256];
+		for (size_t y = first_y; y < end_y; ++y)
+		{
+			size_t surface_y = (surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? (surface_descriptor->rect.height - 1 - offset_y - y) : (offset_y + y);
+			msbtfont_decode_pixels(blit->font_data, character_bit_offset + ((((unsigned long long)(y) * max_font_width) + first_x) * blit->bits_per_pixel), blit->bits_per_pixel, visible_width, row);
+			msbtfont_output_surface_row(blit, &surface_origin[surface_y * blit->layout.pitch], row, visible_width);
+		}
+		return;
+	}
+	// Effects run over a ring of decoded (and emboldened) rows covering every row the outline
+	// and shadow stages can reach, so no full-glyph intermediate buffer is needed.
+	const msbtfont_effect_descriptor *effect_descriptor = blit->effect_descriptor;
+	unsigned char rows[MSBTFONT_EFFECT_ROW_COUNT][256];
+	unsigned char column_max[256];
+	unsigned char output[256];
+	int outline = effect_descriptor->outline;
+	int shadow = (effect_descriptor->shadow_x != 0 || effect_descriptor->shadow_y != 0);
+	int lookahead = outline;
+	int lookbehind = outline;
+	if (shadow && -effect_descriptor->shadow_y > lookahead)
+	{
+		lookahead = -effect_descriptor->shadow_y;
+	}
+	if (shadow && effect_descriptor->shadow_y > lookbehind)
+	{
+		lookbehind = effect_descriptor->shadow_y;
+	}
+	// Rows above the clip area are only decoded as far as the effects reach into the visible ones
+	int decoded_rows = ((int)(first_y) > lookbehind) ? (int)(first_y) - lookbehind : 0;
+	for (int y = (int)(first_y); y < (int)(end_y); ++y)
+	{
+		while (decoded_rows < max_font_height && decoded_rows <= y + lookahead)
+		{
+			msbtfont_decode_effect_row(blit, character_bit_offset, (unsigned short)(decoded_rows), rows[decoded_rows % MSBTFONT_EFFECT_ROW_COUNT]);
+			++decoded_rows;
+		}
+		const unsigned char *glyph_row = rows[y % MSBTFONT_EFFECT_ROW_COUNT];
+		memcpy(output, glyph_row, max_font_width);
+		if (outline)
+		{
+			memset(column_max, 0, max_font_width);
+			for (int dy = -outline; dy <= outline; ++dy)
+			{
+				if (y + dy < 0 || y + dy >= max_font_height)
+				{
+					continue;
+				}
+				const unsigned char *neighbor_row = rows[(y + dy) % MSBTFONT_EFFECT_ROW_COUNT];
+				for (unsigned short x = 0; x < max_font_width; ++x)
+				{
+					column_max[x] |= neighbor_row[x];
+				}
+			}
+			for (int x = 0; x < max_font_width; ++x)
+			{
+				if (output[x] != 0)
+				{
+					continue;
+				}
+				for (int dx = -outline; dx <= outline; ++dx)
+				{
+					if (x + dx >= 0 && x + dx < max_font_width && column_max[x + dx] != 0)
+					{
+						output[x] = effect_descriptor->outline_index;
+						break;
+					}
+				}
+			}
+		}
+		if (shadow)
+		{
+			int source_y = y - effect_descriptor->shadow_y;
+			if (source_y >= 0 && source_y < max_font_height)
+			{
+				const unsigned char *shadow_row = rows[source_y % MSBTFONT_EFFECT_ROW_COUNT];
+				for (int x = 0; x < max_font_width; ++x)
+				{
+					int source_x = x - effect_descriptor->shadow_x;
+					if (output[x] == 0 && source_x >= 0 && source_x < max_font_width && shadow_row[source_x] != 0)
+					{
+						output[x] = effect_descriptor->shadow_index;
+					}
+				}
+			}
+		}
+		size_t surface_y = (surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? (surface_descriptor->rect.height - 1 - offset_y - y) : (offset_y + y);
+		msbtfont_output_surface_row(blit, &surface_origin[surface_y * blit->layout.pitch], &output[first_x], visible_width);
+	}
+}
+
+typedef struct msbtfont_character_import
+{
+	unsigned char *font_data;
+	unsigned char bits_per_pixel;
+	unsigned short max_font_width;
+	unsigned short max_font_height;
+	const msbtfont_surface_descriptor *surface_descriptor;
+	msbtfont_surface_layout layout;
+	const unsigned char *surface_data;
+	struct msbtfont_dirty_tracker *dirty_tracker;
+} msbtfont_character_import;
+
+static void msbtfont_import_character(void *context, unsigned int index, size_t offset_x, size_t offset_y)
+{
+	const msbtfont_character_import *import = (const msbtfont_character_import *)(context);
+	const msbtfont_surface_descriptor *surface_descriptor = import->surface_descriptor;
+	unsigned short max_font_width = import->max_font_width;
+	unsigned short max_font_height = import->max_font_height;
+	unsigned char max_index = (unsigned char)((1 << import->bits_per_pixel) - 1);
+	unsigned long long character_bit_offset = (unsigned long long)(index) * import->bits_per_pixel * max_font_width * max_font_height;
+	size_t visible_width = max_font_width;
+	size_t visible_height = max_font_height;
+	unsigned char row[256];
+	if (offset_x >= surface_descriptor->rect.width || offset_y >= surface_descriptor->rect.height)
+	{
+		return;
+	}
+	if (offset_x + visible_width > surface_descriptor->rect.width)
+	{
+		visible_width = surface_descriptor->rect.width - offset_x;
+	}
+	if (offset_y + visible_height > surface_descriptor->rect.height)
+	{
+		visible_height = surface_descriptor->rect.height - offset_y;
+	}
+	const unsigned char *surface_origin = &import->surface_data[offset_x * import->layout.pixel_size];
+	for (size_t y = 0; y < visible_height; ++y)
+	{
+		size_t surface_y = (surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? (surface_descriptor->rect.height - 1 - offset_y - y) : (offset_y + y);
+		msbtfont_read_surface_row(&surface_origin[surface_y * import->layout.pitch], import->layout.pixel_size, max_index, row, visible_width);
+		msbtfont_encode_pixels(import->font_data, character_bit_offset + ((unsigned long long)(y) * max_font_width * import->bits_per_pixel), import->bits_per_pixel, visible_width, row);
+	}
+	msbtfont_mark_dirty(import->dirty_tracker, index, 1);
+}
+
+// Checks the arguments of the copies to surfaces and fills in 'blit' and the number of
+// characters (or glyphs if 'copy_glyphs' is set, which only differs for deduplicated fonts).
+static msbtfont_retcode msbtfont_prepare_blit(const msbtfont_header *header, const msbtfont_filedata *filedata, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, unsigned char *surface_data, int copy_glyphs, msbtfont_character_blit *blit, unsigned int *font_character_count)
+{
+	if (header != NULL)
+	{
+		if (filedata != NULL)
+		{
+			if (surface_descriptor != NULL)
+			{
+				if (surface_data != NULL)
+				{
+					if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+					{
+						return MSBTFONT_INVALID_HEADER;
+					}
+					*font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+					if (surface_descriptor->rect.width == 0 || surface_descriptor->rect.height == 0)
+					{
+						return MSBTFONT_NO_SURFACE_AREA;
+					}
+					if (filedata->font_data == NULL)
+					{
+						return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+					}
+					msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+					if (retcode != MSBTFONT_SUCCESS)
+					{
+						return retcode;
+					}
+					if (!msbtfont_get_surface_layout(surface_descriptor, &blit->layout))
+					{
+						return MSBTFONT_UNSUPPORTED_SURFACE_FORMAT;
+					}
+					if (effect_descriptor != NULL)
+					{
+						if (effect_descriptor->bold > MSBTFONT_MAX_EFFECT_RADIUS || effect_descriptor->outline > MSBTFONT_MAX_EFFECT_RADIUS || effect_descriptor->shadow_x > MSBTFONT_MAX_EFFECT_RADIUS || effect_descriptor->shadow_x < -MSBTFONT_MAX_EFFECT_RADIUS || effect_descriptor->shadow_y > MSBTFONT_MAX_EFFECT_RADIUS || effect_descriptor->shadow_y < -MSBTFONT_MAX_EFFECT_RADIUS)
+						{
+							return MSBTFONT_INVALID_EFFECT;
+						}
+						if (effect_descriptor->bold == 0 && effect_descriptor->outline == 0 && effect_descriptor->shadow_x == 0 && effect_descriptor->shadow_y == 0)
+						{
+							effect_descriptor = NULL;
+						}
+					}
+					blit->font_data = filedata->font_data;
+					blit->glyph_table = copy_glyphs ? NULL : msbtfont_get_glyph_table(header, filedata);
+					if (copy_glyphs && (header->flags & MSBTFONT_FLAG_DEDUPLICATED))
+					{
+						*font_character_count = msbtfont_read_le32(filedata->glyph_table);
+					}
+					blit->bits_per_pixel = header->palette_format + 1;
+					blit->max_font_width = header->max_font_width + 1;
+					blit->max_font_height = header->max_font_height + 1;
+					blit->surface_descriptor = surface_descriptor;
+					blit->effect_descriptor = effect_descriptor;
+					blit->surface_data = surface_data;
+					blit->clip_rect.width = surface_descriptor->rect.width;
+					blit->clip_rect.height = surface_descriptor->rect.height;
+					blit->clip_rect.x = 0;
+					blit->clip_rect.y = 0;
+					blit->blend_table = NULL;
+					return MSBTFONT_SUCCESS;
+				}
+				else
+				{
+					return MSBTFONT_MISSING_SURFACE_DATA;
+				}
+			}
+			else
+			{
+				return MSBTFONT_MISSING_SURFACE_DESCRIPTOR;
+			}
+		}
+		else
+		{
+			return MSBTFONT_MISSING_FILEDATA;
+		}
+	}
+	else
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+}
+
+static msbtfont_retcode msbtfont_copy_characters_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, const msbtfont_blend_descriptor *blend_descriptor, const msbtfont_rect *clip_rect, unsigned char *surface_data, int copy_glyphs)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_COPY_TO_SURFACE);
+	msbtfont_character_blit blit;
+	msbtfont_blend_table blend_table;
+	unsigned int font_character_count = 0;
+	msbtfont_retcode retcode = msbtfont_prepare_blit(header, filedata, surface_descriptor, effect_descriptor, surface_data, copy_glyphs, &blit, &font_character_count);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (blend_descriptor != NULL)
+	{
+		if (blend_descriptor->mode != MSBTFONT_BLEND_ALPHA_OVER && blend_descriptor->mode != MSBTFONT_BLEND_ADDITIVE && blend_descriptor->mode != MSBTFONT_BLEND_COLORIZE)
+		{
+			return MSBTFONT_INVALID_MODE;
+		}
+		if (surface_descriptor->format != MSBTFONT_SURFACE_FORMAT_32_8)
+		{
+			return MSBTFONT_UNSUPPORTED_SURFACE_FORMAT;
+		}
+		msbtfont_build_blend_table(blend_descriptor, (unsigned char)((1 << blit.bits_per_pixel) - 1), &blend_table);
+		blit.blend_table = &blend_table;
+	}
+	if (clip_rect != NULL)
+	{
+		// Clip rects address rows of the surface data (like the rects of 'msbtfont_update_surface'), so lower left surfaces are flipped here
+		if (clip_rect->x >= blit.clip_rect.width || clip_rect->y >= blit.clip_rect.height)
+		{
+			blit.clip_rect.width = 0;
+			blit.clip_rect.height = 0;
+		}
+		else
+		{
+			unsigned int width = (clip_rect->width > blit.clip_rect.width - clip_rect->x) ? blit.clip_rect.width - clip_rect->x : clip_rect->width;
+			unsigned int height = (clip_rect->height > blit.clip_rect.height - clip_rect->y) ? blit.clip_rect.height - clip_rect->y : clip_rect->height;
+			blit.clip_rect.x = clip_rect->x;
+			blit.clip_rect.y = (surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? blit.clip_rect.height - clip_rect->y - height : clip_rect->y;
+			blit.clip_rect.width = width;
+			blit.clip_rect.height = height;
+		}
+	}
+	if (blit.clip_rect.width != 0 && blit.clip_rect.height != 0)
+	{
+		msbtfont_walk_clipped_grid(font_character_count, blit.max_font_width, blit.max_font_height, characters_per_row, character_start_offset, surface_descriptor, &blit.clip_rect, msbtfont_blit_character, &blit);
+	}
+	MSBTFONT_STATS_END(MSBTFONT_STATS_COPY_TO_SURFACE);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_copy_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data)
+{
+	return msbtfont_copy_characters_to_surface(header, filedata, characters_per_row, character_start_offset, surface_descriptor, NULL, NULL, NULL, surface_data, 0);
+}
+
+msbtfont_retcode msbtfont_copy_to_surface_with_effects(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, unsigned char *surface_data)
+{
+	return msbtfont_copy_characters_to_surface(header, filedata, characters_per_row, character_start_offset, surface_descriptor, effect_descriptor, NULL, NULL, surface_data, 0);
+}
+
+msbtfont_retcode msbtfont_copy_to_surface_clipped(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, const msbtfont_rect *clip_rect, unsigned char *surface_data)
+{
+	return msbtfont_copy_characters_to_surface(header, filedata, characters_per_row, character_start_offset, surface_descriptor, effect_descriptor, NULL, clip_rect, surface_data, 0);
+}
+
+msbtfont_retcode msbtfont_blend_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, const msbtfont_blend_descriptor *blend_descriptor, const msbtfont_rect *clip_rect, unsigned char *surface_data)
+{
+	return msbtfont_copy_characters_to_surface(header, filedata, characters_per_row, character_start_offset, surface_descriptor, effect_descriptor, blend_descriptor, clip_rect, surface_data, 0);
+}
+
+msbtfont_retcode msbtfont_copy_glyphs_to_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int glyphs_per_row, unsigned int glyph_start_offset, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data)
+{
+	return msbtfont_copy_characters_to_surface(header, filedata, glyphs_per_row, glyph_start_offset, surface_descriptor, NULL, NULL, NULL, surface_data, 1);
+}
+
+msbtfont_retcode msbtfont_track_dirty_characters(const msbtfont_header *header, msbtfont_filedata *filedata, int enable)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (filedata->data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	size_t byte_count = ((size_t)(font_character_count) + 7) / 8;
+	struct msbtfont_dirty_tracker *tracker = msbtfont_get_dirty_tracker(filedata);
+	if (!enable)
+	{
+		msbtfont_free_dirty_tracker(filedata);
+		return MSBTFONT_SUCCESS;
+	}
+	size_t size = sizeof(struct msbtfont_dirty_tracker) + byte_count;
+	if (tracker == NULL)
+	{
+		// File data without an allocator of its own (borrowed, embedded or set up by hand) gets
+		// its tracker from the global allocator, which is recorded so the tracker is freed with it
+		const msbtfont_allocator *allocator = msbtfont_get_filedata_allocator(filedata);
+		tracker = (struct msbtfont_dirty_tracker *)(msbtfont_allocate(allocator, size));
+		if (tracker == NULL)
+		{
+			return MSBTFONT_OUT_OF_MEMORY;
+		}
+		tracker->allocator = *allocator;
+	}
+	else if (tracker->size != size)
+	{
+		// The character count changed since tracking started
+		msbtfont_allocator allocator = tracker->allocator;
+		tracker = (struct msbtfont_dirty_tracker *)(msbtfont_reallocate(&allocator, tracker, tracker->size, size));
+		if (tracker == NULL)
+		{
+			return MSBTFONT_OUT_OF_MEMORY;
+		}
+	}
+	tracker->size = size;
+	tracker->font_character_count = font_character_count;
+	tracker->bits = (unsigned char *)(&tracker[1]);
+	memset(tracker->bits, 0, byte_count);
+	filedata->dirty_tracker = tracker;
+	filedata->dirty_tracker_key = msbtfont_get_dirty_tracker_key(tracker);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_mark_dirty_characters(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int first_index, unsigned int count)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	struct msbtfont_dirty_tracker *tracker = msbtfont_get_dirty_tracker(filedata);
+	if (tracker == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	unsigned int font_character_count = tracker->font_character_count;
+	if (first_index > font_character_count || count > font_character_count - first_index)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	msbtfont_mark_dirty(tracker, first_index, count);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_update_surface(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const msbtfont_effect_descriptor *effect_descriptor, unsigned char *surface_data, msbtfont_rect *rects, unsigned int capacity, unsigned int *rect_count)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_COPY_TO_SURFACE);
+	msbtfont_character_blit blit;
+	unsigned int font_character_count = 0;
+	msbtfont_retcode retcode = msbtfont_prepare_blit(header, filedata, surface_descriptor, effect_descriptor, surface_data, 0, &blit, &font_character_count);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (rect_count == NULL || (rects == NULL && capacity != 0))
+	{
+		return MSBTFONT_MISSING_DESTINATION_DATA;
+	}
+	struct msbtfont_dirty_tracker *tracker = msbtfont_get_dirty_tracker(filedata);
+	if (tracker == NULL || tracker->font_character_count != font_character_count)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	unsigned char *bits = tracker->bits;
+	size_t byte_count = ((size_t)(font_character_count) + 7) / 8;
+	size_t surface_width = surface_descriptor->rect.width;
+	size_t surface_height = surface_descriptor->rect.height;
+	msbtfont_rect rect = { 0, 0, 0, 0 };
+	unsigned int count = 0;
+	for (size_t byte = 0; byte < byte_count; ++byte)
+	{
+		// Skip clean stretches a word at a time; Edits usually touch a handful of characters
+		if ((byte % 8) == 0 && byte + 8 <= byte_count)
+		{
+			unsigned long long word;
+			memcpy(&word, &bits[byte], sizeof(word));
+			if (word == 0)
+			{
+				byte += 7;
+				continue;
+			}
+		}
+		if (bits[byte] == 0)
+		{
+			continue;
+		}
+		for (unsigned int bit = 0; bit < 8; ++bit)
+		{
+			if (!(bits[byte] & (0x80 >> bit)))
+			{
+				continue;
+			}
+			unsigned int index = (unsigned int)((byte * 8) + bit);
+			size_t offset_x = 0;
+			size_t offset_y = 0;
+			msbtfont_get_grid_position(blit.max_font_width, blit.max_font_height, characters_per_row, character_start_offset, surface_descriptor, index, &offset_x, &offset_y);
+			if (offset_x >= surface_width || offset_y >= surface_height)
+			{
+				continue;
+			}
+			msbtfont_blit_character(&blit, index, offset_x, offset_y);
+			// Rects address rows of the surface data, so lower left surfaces are flipped here
+			unsigned int width = (unsigned int)((offset_x + blit.max_font_width > surface_width) ? surface_width - offset_x : blit.max_font_width);
+			unsigned int height = (unsigned int)((offset_y + blit.max_font_height > surface_height) ? surface_height - offset_y : blit.max_font_height);
+			unsigned int x = (unsigned int)(offset_x);
+			unsigned int y = (unsigned int)((surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? surface_height - offset_y - height : offset_y);
+			if (rect.width != 0 && rect.y == y && rect.height == height && rect.x + rect.width == x)
+			{
+				rect.width += width;
+				continue;
+			}
+			if (rect.width != 0)
+			{
+				if (count < capacity)
+				{
+					rects[count] = rect;
+				}
+				++count;
+			}
+			rect.x = x;
+			rect.y = y;
+			rect.width = width;
+			rect.height = height;
+		}
+		bits[byte] = 0;
+	}
+	if (rect.width != 0)
+	{
+		if (count < capacity)
+		{
+			rects[count] = rect;
+		}
+		++count;
+	}
+	*rect_count = count;
+	MSBTFONT_STATS_END(MSBTFONT_STATS_COPY_TO_SURFACE);
+	return MSBTFONT_SUCCESS;
+}
+
+#define MSBTFONT_CELL_PALETTE_COUNT 4
+
+// Surface pixel for every palette index of a cell.  Each byte of the colors is blended
+// linearly, so fonts with more than 1 bit per pixel keep their antialiasing.
+static void msbtfont_build_cell_palette(unsigned int foreground, unsigned int background, unsigned char max_index, size_t pixel_size, unsigned char *palette)
+{
+	for (unsigned int index = 0; index <= max_index; ++index)
+	{
+		for (size_t component = 0; component < pixel_size; ++component)
+		{
+			unsigned int foreground_component = (foreground >> (component * 8)) & 0xFF;
+			unsigned int background_component = (background >> (component * 8)) & 0xFF;
+			palette[(index * pixel_size) + component] = (unsigned char)(((foreground_component * index) + (background_component * (max_index - index)) + (max_index / 2)) / max_index);
+		}
+	}
+}
+
+// Decodes a row of a character and writes the palette entry of each pixel, pulling the packed
+// pixels through a bit buffer instead of locating each one separately.
+static void msbtfont_write_cell_row(unsigned char *surface_row, size_t pixel_size, const unsigned char *palette, const unsigned char *font_data, unsigned long long bit_offset, unsigned char bits_per_pixel, size_t count)
+{
+	const unsigned char *src = &font_data[(size_t)(bit_offset / 8)];
+	unsigned int pixel_mask = (1u << bits_per_pixel) - 1;
+	unsigned int buffered = 8 - (unsigned int)(bit_offset % 8);
+	unsigned int buffer = *src++ & (0xFFu >> (bit_offset % 8));
+	for (size_t x = 0; x < count; ++x)
+	{
+		if (buffered < bits_per_pixel)
+		{
+			buffer = ((buffer << 8) | *src++) & 0xFFFF;
+			buffered += 8;
+		}
+		buffered -= bits_per_pixel;
+		size_t index = (buffer >> buffered) & pixel_mask;
+		if (pixel_size == 4)
+		{
+			memcpy(&surface_row[x * 4], &palette[index * 4], 4);
+		}
+		else
+		{
+			memcpy(&surface_row[x * pixel_size], &palette[index * pixel_size], pixel_size);
+		}
+	}
+}
+
+msbtfont_retcode msbtfont_render_cells(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int columns, unsigned int rows, const msbtfont_cell *cells, msbtfont_cell *previous_cells, const msbtfont_surface_descriptor *surface_descriptor, unsigned char *surface_data, msbtfont_rect *rects, unsigned int capacity, unsigned int *rect_count)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_RENDER_CELLS);
+	msbtfont_character_blit blit;
+	unsigned int font_character_count = 0;
+	msbtfont_retcode retcode = msbtfont_prepare_blit(header, filedata, surface_descriptor, NULL, surface_data, 0, &blit, &font_character_count);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (cells == NULL && columns != 0 && rows != 0)
+	{
+		return MSBTFONT_MISSING_SOURCE_DATA;
+	}
+	if (rect_count == NULL || (rects == NULL && capacity != 0))
+	{
+		return MSBTFONT_MISSING_DESTINATION_DATA;
+	}
+	unsigned short max_font_width = blit.max_font_width;
+	unsigned short max_font_height = blit.max_font_height;
+	unsigned char max_index = (unsigned char)((1 << blit.bits_per_pixel) - 1);
+	size_t pixel_size = blit.layout.pixel_size;
+	size_t surface_width = surface_descriptor->rect.width;
+	size_t surface_height = surface_descriptor->rect.height;
+	// A few color pairs are kept built, since neighboring cells tend to alternate between them
+	unsigned char palettes[MSBTFONT_CELL_PALETTE_COUNT][256 * 4];
+	unsigned int palette_foregrounds[MSBTFONT_CELL_PALETTE_COUNT];
+	unsigned int palette_backgrounds[MSBTFONT_CELL_PALETTE_COUNT];
+	unsigned int palette_count = 0;
+	unsigned int next_palette = 0;
+	msbtfont_rect rect = { 0, 0, 0, 0 };
+	unsigned int count = 0;
+	for (unsigned int row = 0; row < rows; ++row)
+	{
+		const msbtfont_cell *row_cells = &cells[(size_t)(row) * columns];
+		msbtfont_cell *previous_row = (previous_cells != NULL) ? &previous_cells[(size_t)(row) * columns] : NULL;
+		size_t offset_y = surface_descriptor->rect.y + ((size_t)(row) * max_font_height);
+		// Most rows of a terminal don't change between frames, so compare whole rows first
+		if (previous_row != NULL && memcmp(row_cells, previous_row, (size_t)(columns) * sizeof(msbtfont_cell)) == 0)
+		{
+			continue;
+		}
+		for (unsigned int column = 0; column < columns && offset_y < surface_height; ++column)
+		{
+			const msbtfont_cell *cell = &row_cells[column];
+			size_t offset_x = surface_descriptor->rect.x + ((size_t)(column) * max_font_width);
+			if (offset_x >= surface_width)
+			{
+				break;
+			}
+			if (previous_row != NULL && cell->character == previous_row[column].character && cell->foreground == previous_row[column].foreground && cell->background == previous_row[column].background)
+			{
+				continue;
+			}
+			unsigned int palette_index = 0;
+			while (palette_index < palette_count && (palette_foregrounds[palette_index] != cell->foreground || palette_backgrounds[palette_index] != cell->background))
+			{
+				++palette_index;
+			}
+			if (palette_index == palette_count)
+			{
+				palette_index = next_palette;
+				next_palette = (next_palette + 1) % MSBTFONT_CELL_PALETTE_COUNT;
+				if (palette_count < MSBTFONT_CELL_PALETTE_COUNT)
+				{
+					++palette_count;
+				}
+				msbtfont_build_cell_palette(cell->foreground, cell->background, max_index, pixel_size, palettes[palette_index]);
+				palette_foregrounds[palette_index] = cell->foreground;
+				palette_backgrounds[palette_index] = cell->background;
+			}
+			const unsigned char *palette = palettes[palette_index];
+			unsigned int glyph = (cell->character < font_character_count) ? msbtfont_get_glyph(blit.glyph_table, cell->character) : MSBTFONT_NO_GLYPH;
+			unsigned long long character_bit_offset = (unsigned long long)(glyph) * blit.bits_per_pixel * max_font_width * max_font_height;
+			size_t visible_width = (offset_x + max_font_width > surface_width) ? surface_width - offset_x : max_font_width;
+			size_t visible_height = (offset_y + max_font_height > surface_height) ? surface_height - offset_y : max_font_height;
+			for (size_t y = 0; y < visible_height; ++y)
+			{
+				size_t surface_y = (surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? (surface_height - 1 - offset_y - y) : (offset_y + y);
+				unsigned char *surface_row = &surface_data[(surface_y * blit.layout.pitch) + (offset_x * pixel_size)];
+				if (glyph == MSBTFONT_NO_GLYPH)
+				{
+					// Blank cells are filled with the background
+					for (size_t x = 0; x < visible_width; ++x)
+					{
+						memcpy(&surface_row[x * pixel_size], palette, pixel_size);
+					}
+					continue;
+				}
+				msbtfont_write_cell_row(surface_row, pixel_size, palette, blit.font_data, character_bit_offset + ((unsigned long long)(y) * max_font_width * blit.bits_per_pixel), blit.bits_per_pixel, visible_width);
+			}
+			MSBTFONT_STATS_ADD(characters_decoded, 1);
+			MSBTFONT_STATS_ADD(pixels_written, visible_width * visible_height);
+			MSBTFONT_STATS_ADD(font_data_bytes_read, ((size_t)(blit.bits_per_pixel) * visible_width * visible_height + 7) / 8);
+			// Only drawn cells are recorded, so cells clipped away are still drawn once they're visible
+			if (previous_row != NULL)
+			{
+				previous_row[column] = *cell;
+			}
+			// Rects address rows of the surface data, so lower left surfaces are flipped here
+			unsigned int x = (unsigned int)(offset_x);
+			unsigned int y = (unsigned int)((surface_descriptor->origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? surface_height - offset_y - visible_height : offset_y);
+			if (rect.width != 0 && rect.y == y && rect.height == visible_height && rect.x + rect.width == x)
+			{
+				rect.width += (unsigned int)(visible_width);
+				continue;
+			}
+			if (rect.width != 0)
+			{
+				if (count < capacity)
+				{
+					rects[count] = rect;
+				}
+				++count;
+			}
+			rect.x = x;
+			rect.y = y;
+			rect.width = (unsigned int)(visible_width);
+			rect.height = (unsigned int)(visible_height);
+		}
+	}
+	if (rect.width != 0)
+	{
+		if (count < capacity)
+		{
+			rects[count] = rect;
+		}
+		++count;
+	}
+	*rect_count = count;
+	MSBTFONT_STATS_END(MSBTFONT_STATS_RENDER_CELLS);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_copy_from_surface(const msbtfont_header *header, msbtfont_filedata *filedata, unsigned int characters_per_row, unsigned int character_start_offset, const msbtfont_surface_descriptor *surface_descriptor, const unsigned char *surface_data)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_COPY_FROM_SURFACE);
+	if (header != NULL)
+	{
+		if (filedata != NULL)
+		{
+			if (surface_descriptor != NULL)
+			{
+				if (surface_data != NULL)
+				{
+					unsigned int font_character_count = 0;
+					unsigned short max_font_width = header->max_font_width + 1;
+					unsigned short max_font_height = header->max_font_height + 1;
+					msbtfont_character_import import;
+					if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+					{
+						return MSBTFONT_INVALID_HEADER;
+					}
+					if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+					{
+						return MSBTFONT_DEDUPLICATED_FONT;
+					}
+					font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+					if (surface_descriptor->rect.width == 0 || surface_descriptor->rect.height == 0)
+					{
+						return MSBTFONT_NO_SURFACE_AREA;
+					}
+					if (filedata->font_data == NULL)
+					{
+						return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+					}
+					msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+					if (retcode != MSBTFONT_SUCCESS)
+					{
+						return retcode;
+					}
+					if (!msbtfont_get_surface_layout(surface_descriptor, &import.layout))
+					{
+						return MSBTFONT_UNSUPPORTED_SURFACE_FORMAT;
+					}
+					import.font_data = filedata->font_data;
+					import.bits_per_pixel = header->palette_format + 1;
+					import.max_font_width = max_font_width;
+					import.max_font_height = max_font_height;
+					import.surface_descriptor = surface_descriptor;
+					import.surface_data = surface_data;
+					import.dirty_tracker = msbtfont_get_dirty_tracker(filedata);
+					msbtfont_walk_surface_grid(font_character_count, max_font_width, max_font_height, characters_per_row, character_start_offset, surface_descriptor, msbtfont_import_character, &import);
+					MSBTFONT_STATS_END(MSBTFONT_STATS_COPY_FROM_SURFACE);
+					return MSBTFONT_SUCCESS;
+				}
+				else
+				{
+					return MSBTFONT_MISSING_SURFACE_DATA;
+				}
+			}
+			else
+			{
+				return MSBTFONT_MISSING_SURFACE_DESCRIPTOR;
+			}
+		}
+		else
+		{
+			return MSBTFONT_MISSING_FILEDATA;
+		}
+	}
+	else
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+}
+
+static const unsigned char msbtfont_bayer_matrix[4][4] =
+{
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
+static unsigned char msbtfont_repack_value(unsigned int value, unsigned int src_max, unsigned int dst_max, msbtfont_repack_mode mode, unsigned int bayer)
+{
+	unsigned int result = 0;
+	switch (mode)
+	{
+		case MSBTFONT_REPACK_THRESHOLD:
+		{
+			// Buckets only make sense when reducing bits; Widening scales so the maximum stays the maximum
+			if (dst_max <= src_max)
+			{
+				result = (value * (dst_max + 1)) / (src_max + 1);
+			}
+			else
+			{
+				result = ((value * dst_max) + (src_max / 2)) / src_max;
+			}
+			break;
+		}
+		case MSBTFONT_REPACK_SCALE:
+		{
+			result = ((value * dst_max) + (src_max / 2)) / src_max;
+			break;
+		}
+		case MSBTFONT_REPACK_ORDERED_DITHER:
+		{
+			result = ((value * dst_max * 32) + ((bayer * 2 + 1) * src_max)) / (src_max * 32);
+			break;
+		}
+	}
+	return (unsigned char)((result > dst_max) ? dst_max : result);
+}
+
+msbtfont_retcode msbtfont_repack_characters(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, const msbtfont_header *dst_header, msbtfont_filedata *dst_filedata, msbtfont_repack_mode mode, unsigned int first_index, unsigned int count)
+{
+	MSBTFONT_STATS_BEGIN(MSBTFONT_STATS_REPACK);
+	if (src_header == NULL || dst_header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (src_filedata == NULL || dst_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(src_header, magicword) != MSBTFONT_MSBT || MSBTFONT_NATIVE(dst_header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if ((src_header->flags | dst_header->flags) & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		return MSBTFONT_DEDUPLICATED_FONT;
+	}
+	if (src_filedata->font_data == NULL || dst_filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(src_header, src_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	retcode = msbtfont_check_filedata(dst_header, dst_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (src_header->max_font_width != dst_header->max_font_width || src_header->max_font_height != dst_header->max_font_height || MSBTFONT_NATIVE(src_header, font_character_count) != MSBTFONT_NATIVE(dst_header, font_character_count))
+	{
+		return MSBTFONT_INCOMPATIBLE_FONTS;
+	}
+	if (mode != MSBTFONT_REPACK_THRESHOLD && mode != MSBTFONT_REPACK_SCALE && mode != MSBTFONT_REPACK_ORDERED_DITHER)
+	{
+		return MSBTFONT_INVALID_MODE;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(src_header, font_character_count);
+	if (first_index > font_character_count || count > font_character_count - first_index)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	MSBTFONT_STATS_ADD(characters_decoded, count);
+	MSBTFONT_STATS_ADD(font_data_bytes_read, ((size_t)(src_header->palette_format + 1) * (src_header->max_font_width + 1) * (src_header->max_font_height + 1) * count + 7) / 8);
+	msbtfont_mark_dirty(msbtfont_get_dirty_tracker(dst_filedata), first_index, count);
+	unsigned short max_font_width = src_header->max_font_width + 1;
+	unsigned short max_font_height = src_header->max_font_height + 1;
+	unsigned char src_bits_per_pixel = src_header->palette_format + 1;
+	unsigned char dst_bits_per_pixel = dst_header->palette_format + 1;
+	unsigned long long src_character_bits = (unsigned long long)(src_bits_per_pixel) * max_font_width * max_font_height;
+	unsigned long long dst_character_bits = (unsigned long long)(dst_bits_per_pixel) * max_font_width * max_font_height;
+	if (src_bits_per_pixel == dst_bits_per_pixel && ((first_index * src_character_bits) % 8) == 0)
+	{
+		msbtfont_unpack_bits(&dst_filedata->font_data[(size_t)((first_index * dst_character_bits) / 8)], src_filedata->font_data, first_index * src_character_bits, count * src_character_bits);
+		MSBTFONT_STATS_END(MSBTFONT_STATS_REPACK);
+		return MSBTFONT_SUCCESS;
+	}
+	// Each source value maps to a destination value through a table (one per dither matrix
+	// cell), so conversion is a decode, a lookup and an encode per run of pixels.
+	unsigned int src_max = (1u << src_bits_per_pixel) - 1;
+	unsigned int dst_max = (1u << dst_bits_per_pixel) - 1;
+	unsigned int table_count = (mode == MSBTFONT_REPACK_ORDERED_DITHER) ? 16 : 1;
+	unsigned char tables[16][256];
+	unsigned char src_pixels[256];
+	unsigned char dst_pixels[256];
+	for (unsigned int t = 0; t < table_count; ++t)
+	{
+		for (unsigned int value = 0; value <= src_max; ++value)
+		{
+			tables[t][value] = msbtfont_repack_value(value, src_max, dst_max, mode, msbtfont_bayer_matrix[t / 4][t % 4]);
+		}
+	}
+	if (table_count == 1)
+	{
+		unsigned long long pixel_count = (unsigned long long)(count) * max_font_width * max_font_height;
+		unsigned long long src_bit_offset = first_index * src_character_bits;
+		unsigned long long dst_bit_offset = first_index * dst_character_bits;
+		while (pixel_count > 0)
+		{
+			size_t run = (pixel_count > sizeof(src_pixels)) ? sizeof(src_pixels) : (size_t)(pixel_count);
+			msbtfont_decode_pixels(src_filedata->font_data, src_bit_offset, src_bits_per_pixel, run, src_pixels);
+			for (size_t i = 0; i < run; ++i)
+			{
+				dst_pixels[i] = tables[0][src_pixels[i]];
+			}
+			msbtfont_encode_pixels(dst_filedata->font_data, dst_bit_offset, dst_bits_per_pixel, run, dst_pixels);
+			src_bit_offset += run * src_bits_per_pixel;
+			dst_bit_offset += run * dst_bits_per_pixel;
+			pixel_count -= run;
+		}
+		MSBTFONT_STATS_END(MSBTFONT_STATS_REPACK);
+		return MSBTFONT_SUCCESS;
+	}
+	for (unsigned int i = first_index; i < first_index + count; ++i)
+	{
+		for (unsigned short y = 0; y < max_font_height; ++y)
+		{
+			unsigned char (*row_tables)[256] = &tables[(y % 4) * 4];
+			unsigned long long pixel_offset = ((unsigned long long)(i) * max_font_height + y) * max_font_width;
+			msbtfont_decode_pixels(src_filedata->font_data, pixel_offset * src_bits_per_pixel, src_bits_per_pixel, max_font_width, src_pixels);
+			for (unsigned short x = 0; x < max_font_width; ++x)
+			{
+				dst_pixels[x] = row_tables[x % 4][src_pixels[x]];
+			}
+			msbtfont_encode_pixels(dst_filedata->font_data, pixel_offset * dst_bits_per_pixel, dst_bits_per_pixel, max_font_width, dst_pixels);
+		}
+	}
+	MSBTFONT_STATS_END(MSBTFONT_STATS_REPACK);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_repack(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, msbtfont_header *dst_header, msbtfont_filedata *dst_filedata, unsigned char dst_palette_format, msbtfont_repack_mode mode)
+{
+	if (src_header == NULL || dst_header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (src_filedata == NULL || dst_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(src_header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (src_filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(src_header, src_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (dst_palette_format > 7)
+	{
+		return MSBTFONT_INVALID_PALETTE_FORMAT;
+	}
+	if (mode != MSBTFONT_REPACK_THRESHOLD && mode != MSBTFONT_REPACK_SCALE && mode != MSBTFONT_REPACK_ORDERED_DITHER)
+	{
+		return MSBTFONT_INVALID_MODE;
+	}
+	msbtfont_header header = *src_header;
+	header.palette_format = dst_palette_format;
+	// Built aside, so the destination is only touched once the repack succeeded
+	msbtfont_filedata filedata;
+	retcode = msbtfont_create_filedata_with_allocator(&header, &filedata, msbtfont_get_filedata_allocator(src_filedata));
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (filedata.variable_table != NULL && src_filedata->variable_table != NULL)
+	{
+		memcpy(filedata.variable_table, src_filedata->variable_table, MSBTFONT_NATIVE(src_header, font_character_count));
+	}
+	retcode = msbtfont_repack_characters(src_header, src_filedata, &header, &filedata, mode, 0, MSBTFONT_NATIVE(src_header, font_character_count));
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		msbtfont_delete_filedata(&filedata);
+		return retcode;
+	}
+	*dst_header = header;
+	*dst_filedata = filedata;
+	return MSBTFONT_SUCCESS;
+}
+
+#define MSBTFONT_HASH_PRIME1 0x9E3779B185EBCA87ull
+#define MSBTFONT_HASH_PRIME2 0xC2B2AE3D27D4EB4Full
+#define MSBTFONT_HASH_PRIME3 0x165667B19E3779F9ull
+#define MSBTFONT_HASH_PRIME4 0x85EBCA77C2B2AE63ull
+#define MSBTFONT_HASH_PRIME5 0x27D4EB2F165667C5ull
+
+static unsigned long long msbtfont_read_le64(const unsigned char *data)
+{
+#if defined(MSBTFONT_BIG_ENDIAN) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+	return (unsigned long long)(msbtfont_read_le32(data)) | ((unsigned long long)(msbtfont_read_le32(&data[4])) << 32);
+#else
+	unsigned long long value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+#endif
+}
+
+static unsigned long long msbtfont_rotate_left(unsigned long long value, unsigned int count)
+{
+	return (value << count) | (value >> (64 - count));
+}
+
+static unsigned long long msbtfont_hash_round(unsigned long long accumulator, unsigned long long input)
+{
+	return msbtfont_rotate_left(accumulator + (input * MSBTFONT_HASH_PRIME2), 31) * MSBTFONT_HASH_PRIME1;
+}
+
+static unsigned long long msbtfont_hash_merge(unsigned long long hash, unsigned long long accumulator)
+{
+	return ((hash ^ msbtfont_hash_round(0, accumulator)) * MSBTFONT_HASH_PRIME1) + MSBTFONT_HASH_PRIME4;
+}
+
+// XXH64 of 'size' bytes.  Input is read as little endian 64-bit words in four independent lanes,
+// so the result is the same on every host and the lanes run in parallel on modern processors.
+static unsigned long long msbtfont_hash_bytes(const unsigned char *data, size_t size, unsigned long long seed)
+{
+	const unsigned char *end = &data[size];
+	unsigned long long hash;
+	if (size >= 32)
+	{
+		unsigned long long lanes[4] = { seed + MSBTFONT_HASH_PRIME1 + MSBTFONT_HASH_PRIME2, seed + MSBTFONT_HASH_PRIME2, seed, seed - MSBTFONT_HASH_PRIME1 };
+		do
+		{
+			lanes[0] = msbtfont_hash_round(lanes[0], msbtfont_read_le64(data));
+			lanes[1] = msbtfont_hash_round(lanes[1], msbtfont_read_le64(&data[8]));
+			lanes[2] = msbtfont_hash_round(lanes[2], msbtfont_read_le64(&data[16]));
+			lanes[3] = msbtfont_hash_round(lanes[3], msbtfont_read_le64(&data[24]));
+			data = &data[32];
+		}
+		while ((size_t)(end - data) >= 32);
+		hash = msbtfont_rotate_left(lanes[0], 1) + msbtfont_rotate_left(lanes[1], 7) + msbtfont_rotate_left(lanes[2], 12) + msbtfont_rotate_left(lanes[3], 18);
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			hash = msbtfont_hash_merge(hash, lanes[lane]);
+		}
+	}
+	else
+	{
+		hash = seed + MSBTFONT_HASH_PRIME5;
+	}
+	hash += (unsigned long long)(size);
+	for (; (size_t)(end - data) >= 8; data = &data[8])
+	{
+		hash = (msbtfont_rotate_left(hash ^ msbtfont_hash_round(0, msbtfont_read_le64(data)), 27) * MSBTFONT_HASH_PRIME1) + MSBTFONT_HASH_PRIME4;
+	}
+	if ((size_t)(end - data) >= 4)
+	{
+		hash = (msbtfont_rotate_left(hash ^ ((unsigned long long)(msbtfont_read_le32(data)) * MSBTFONT_HASH_PRIME1), 23) * MSBTFONT_HASH_PRIME2) + MSBTFONT_HASH_PRIME3;
+		data = &data[4];
+	}
+	for (; data != end; data = &data[1])
+	{
+		hash = msbtfont_rotate_left(hash ^ (*data * MSBTFONT_HASH_PRIME5), 11) * MSBTFONT_HASH_PRIME1;
+	}
+	hash ^= hash >> 33;
+	hash *= MSBTFONT_HASH_PRIME2;
+	hash ^= hash >> 29;
+	hash *= MSBTFONT_HASH_PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+// Packed pixels of a glyph, byte aligned and with unused trailing bits cleared.  Glyphs whose
+// size is a whole number of bytes are returned in place; Others are unpacked into 'scratch'
+// (which must start out cleared and hold at least one byte more than the character).
+static const unsigned char *msbtfont_glyph_bytes(const unsigned char *font_data, unsigned int glyph, unsigned long long character_bits, unsigned char *scratch)
+{
+	if (character_bits % 8 == 0)
+	{
+		return &font_data[(size_t)((glyph * character_bits) / 8)];
+	}
+	msbtfont_unpack_bits(scratch, font_data, glyph * character_bits, character_bits);
+	return scratch;
+}
+
+msbtfont_retcode msbtfont_deduplicate(const msbtfont_header *src_header, const msbtfont_filedata *src_filedata, msbtfont_header *dst_header, msbtfont_filedata *dst_filedata)
+{
+	if (src_header == NULL || dst_header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (src_filedata == NULL || dst_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(src_header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (src_header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		return MSBTFONT_DEDUPLICATED_FONT;
+	}
+	if (src_filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(src_header, src_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(src_header, font_character_count);
+	unsigned long long character_bits = (unsigned long long)(src_header->palette_format + 1) * (src_header->max_font_width + 1) * (src_header->max_font_height + 1);
+	size_t character_size = (size_t)((character_bits + 7) / 8);
+	size_t slot_count = 16;
+	while (slot_count < (size_t)(font_character_count) * 2)
+	{
+		slot_count *= 2;
+	}
+	// Glyph of every character, first character using each glyph, hash of each glyph, the hash
+	// table (glyph per slot) and two unpacked characters, all in one allocation
+	size_t scratch_size = 2 * (character_size + 1);
+	size_t work_size = ((size_t)(font_character_count) * 2 * sizeof(unsigned int)) + ((size_t)(font_character_count) * sizeof(unsigned long long)) + (slot_count * sizeof(unsigned int)) + scratch_size;
+	const msbtfont_allocator *allocator = msbtfont_get_filedata_allocator(src_filedata);
+	unsigned char *work = (unsigned char *)(msbtfont_allocate(allocator, work_size));
+	if (work == NULL)
+	{
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	unsigned long long *glyph_hashes = (unsigned long long *)(work);
+	unsigned int *character_glyphs = (unsigned int *)(&glyph_hashes[font_character_count]);
+	unsigned int *glyph_characters = &character_glyphs[font_character_count];
+	unsigned int *slots = &glyph_characters[font_character_count];
+	unsigned char *character = (unsigned char *)(&slots[slot_count]);
+	unsigned char *candidate = &character[character_size + 1];
+	unsigned int glyph_count = 0;
+	memset(slots, 0xFF, slot_count * sizeof(unsigned int));
+	memset(character, 0, scratch_size);
+	for (unsigned int i = 0; i < font_character_count; ++i)
+	{
+		msbtfont_unpack_bits(character, src_filedata->font_data, i * character_bits, character_bits);
+		unsigned long long hash = msbtfont_hash_bytes(character, character_size, 0);
+		size_t slot = (size_t)(hash) & (slot_count - 1);
+		unsigned int glyph = MSBTFONT_NO_GLYPH;
+		while (slots[slot] != MSBTFONT_NO_GLYPH)
+		{
+			unsigned int existing = slots[slot];
+			if (glyph_hashes[existing] == hash)
+			{
+				msbtfont_unpack_bits(candidate, src_filedata->font_data, glyph_characters[existing] * character_bits, character_bits);
+				if (memcmp(character, candidate, character_size) == 0)
+				{
+					glyph = existing;
+					break;
+				}
+			}
+			slot = (slot + 1) & (slot_count - 1);
+		}
+		if (glyph == MSBTFONT_NO_GLYPH)
+		{
+			glyph = glyph_count++;
+			glyph_hashes[glyph] = hash;
+			glyph_characters[glyph] = i;
+			slots[slot] = glyph;
+		}
+		character_glyphs[i] = glyph;
+	}
+	msbtfont_header header = *src_header;
+	header.flags |= MSBTFONT_FLAG_DEDUPLICATED;
+	size_t variable_table_size = 0;
+	size_t glyph_table_size = 0;
+	size_t font_data_size = 0;
+	retcode = msbtfont_compute_layout(&header, glyph_count, &variable_table_size, &glyph_table_size, &font_data_size);
+	unsigned char *data = NULL;
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		data = (unsigned char *)(msbtfont_allocate(allocator, variable_table_size + glyph_table_size + font_data_size));
+		retcode = (data != NULL) ? MSBTFONT_SUCCESS : MSBTFONT_OUT_OF_MEMORY;
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		msbtfont_deallocate(allocator, work, work_size);
+		return retcode;
+	}
+	dst_filedata->data = data;
+	dst_filedata->size = variable_table_size + glyph_table_size + font_data_size;
+	dst_filedata->variable_table = (variable_table_size != 0) ? data : NULL;
+	dst_filedata->glyph_table = &data[variable_table_size];
+	msbtfont_clear_dirty_tracker(dst_filedata);
+	dst_filedata->font_data = &data[variable_table_size + glyph_table_size];
+	dst_filedata->allocator = *allocator;
+	if (variable_table_size != 0)
+	{
+		memcpy(dst_filedata->variable_table, src_filedata->variable_table, variable_table_size);
+	}
+	msbtfont_write_le32(dst_filedata->glyph_table, glyph_count);
+	for (unsigned int i = 0; i < font_character_count; ++i)
+	{
+		msbtfont_write_le32(&dst_filedata->glyph_table[4 + ((size_t)(i) * 4)], character_glyphs[i]);
+	}
+	if (font_data_size != 0)
+	{
+		dst_filedata->font_data[font_data_size - 1] = 0;
+	}
+	for (unsigned int glyph = 0; glyph < glyph_count; ++glyph)
+	{
+		msbtfont_unpack_bits(character, src_filedata->font_data, glyph_characters[glyph] * character_bits, character_bits);
+		msbtfont_pack_bits(dst_filedata->font_data, glyph * character_bits, character, character_bits);
+	}
+	msbtfont_deallocate(allocator, work, work_size);
+	*dst_header = header;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_glyph_count(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int *glyph_count)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (glyph_count == NULL)
+	{
+		return MSBTFONT_MISSING_DESTINATION_DATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (filedata->data == NULL || filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	*glyph_count = (header->flags & MSBTFONT_FLAG_DEDUPLICATED) ? msbtfont_read_le32(filedata->glyph_table) : MSBTFONT_NATIVE(header, font_character_count);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_glyph_index(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int index, unsigned int *glyph_index)
+{
+	unsigned int glyph_count = 0;
+	msbtfont_retcode retcode = msbtfont_get_glyph_count(header, filedata, (glyph_index != NULL) ? &glyph_count : NULL);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (index >= MSBTFONT_NATIVE(header, font_character_count))
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	unsigned int glyph = msbtfont_get_glyph(msbtfont_get_glyph_table(header, filedata), index);
+	if (glyph == MSBTFONT_NO_GLYPH)
+	{
+		return MSBTFONT_INVALID_FILEDATA;
+	}
+	*glyph_index = glyph;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_glyph_surface_size(const msbtfont_header *header, const msbtfont_filedata *filedata, msbtfont_rect *surface_size, unsigned int glyphs_per_row)
+{
+	unsigned int glyph_count = 0;
+	msbtfont_retcode retcode = msbtfont_get_glyph_count(header, filedata, &glyph_count);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	// A font holding only the glyphs has the same surface as the glyph atlas
+	msbtfont_header glyph_header = *header;
+	MSBTFONT_NATIVE(&glyph_header, font_character_count) = glyph_count;
+	return msbtfont_get_surface_size(&glyph_header, surface_size, glyphs_per_row);
+}
+
+msbtfont_retcode msbtfont_hash_font(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned long long *hash)
+{
+	unsigned int glyph_count = 0;
+	msbtfont_retcode retcode = msbtfont_get_glyph_count(header, filedata, (hash != NULL) ? &glyph_count : NULL);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	size_t variable_table_size = 0;
+	size_t glyph_table_size = 0;
+	size_t font_data_size = 0;
+	retcode = msbtfont_compute_layout(header, glyph_count, &variable_table_size, &glyph_table_size, &font_data_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	// Only the fields that affect the pixels take part, so renaming a font keeps its hash
+	unsigned char fields[8];
+	msbtfont_write_le32(fields, MSBTFONT_NATIVE(header, font_character_count));
+	fields[4] = header->palette_format;
+	fields[5] = header->max_font_width;
+	fields[6] = header->max_font_height;
+	fields[7] = header->flags & (MSBTFONT_FLAG_VARIABLE_WIDTH | MSBTFONT_FLAG_DEDUPLICATED);
+	unsigned long long result = msbtfont_hash_bytes(fields, sizeof(fields), 0);
+	if (variable_table_size != 0)
+	{
+		result = msbtfont_hash_bytes(filedata->variable_table, variable_table_size, result);
+	}
+	if (glyph_table_size != 0)
+	{
+		result = msbtfont_hash_bytes(filedata->glyph_table, glyph_table_size, result);
+	}
+	if (font_data_size != 0)
+	{
+		// Bits past the last glyph are left alone by stores, so they are masked off
+		unsigned int tail_bits = (unsigned int)(((unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1) * glyph_count) % 8);
+		unsigned char last_byte = filedata->font_data[font_data_size - 1] & (unsigned char)(tail_bits ? 0xFF << (8 - tail_bits) : 0xFF);
+		result = msbtfont_hash_bytes(filedata->font_data, font_data_size - 1, result);
+		result = msbtfont_hash_bytes(&last_byte, 1, result);
+	}
+	*hash = result;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_hash_characters(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int first_index, unsigned int count, unsigned long long *hashes)
+{
+	unsigned int glyph_count = 0;
+	msbtfont_retcode retcode = msbtfont_get_glyph_count(header, filedata, (hashes != NULL) ? &glyph_count : NULL);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (count > font_character_count || first_index > font_character_count - count)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	size_t character_size = (size_t)((character_bits + 7) / 8);
+	size_t scratch_size = (character_bits % 8) ? character_size + 1 : 0;
+	const msbtfont_allocator *allocator = msbtfont_get_filedata_allocator(filedata);
+	unsigned char *scratch = NULL;
+	if (scratch_size != 0)
+	{
+		scratch = (unsigned char *)(msbtfont_allocate(allocator, scratch_size));
+		if (scratch == NULL)
+		{
+			return MSBTFONT_OUT_OF_MEMORY;
+		}
+		memset(scratch, 0, scratch_size);
+	}
+	const unsigned char *glyph_table = msbtfont_get_glyph_table(header, filedata);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		unsigned int index = first_index + i;
+		unsigned int glyph = msbtfont_get_glyph(glyph_table, index);
+		if (glyph == MSBTFONT_NO_GLYPH)
+		{
+			retcode = MSBTFONT_INVALID_FILEDATA;
+			break;
+		}
+		// The width seeds the hash, so a character whose advance changed gets a new hash too
+		unsigned int width = (filedata->variable_table != NULL) ? filedata->variable_table[index] + 1u : header->max_font_width + 1u;
+		hashes[i] = msbtfont_hash_bytes(msbtfont_glyph_bytes(filedata->font_data, glyph, character_bits, scratch), character_size, width);
+	}
+	if (scratch != NULL)
+	{
+		msbtfont_deallocate(allocator, scratch, scratch_size);
+	}
+	return retcode;
+}
+
+msbtfont_retcode msbtfont_diff_fonts(const msbtfont_header *header_a, const msbtfont_filedata *filedata_a, const msbtfont_header *header_b, const msbtfont_filedata *filedata_b, unsigned int *changed_indices, unsigned int capacity, unsigned int *changed_count)
+{
+	unsigned int glyph_count = 0;
+	int has_destination = (changed_count != NULL && (changed_indices != NULL || capacity == 0));
+	msbtfont_retcode retcode = msbtfont_get_glyph_count(header_a, filedata_a, has_destination ? &glyph_count : NULL);
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		retcode = msbtfont_get_glyph_count(header_b, filedata_b, &glyph_count);
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (header_a->palette_format != header_b->palette_format || header_a->max_font_width != header_b->max_font_width || header_a->max_font_height != header_b->max_font_height)
+	{
+		return MSBTFONT_INCOMPATIBLE_FONTS;
+	}
+	unsigned int count_a = MSBTFONT_NATIVE(header_a, font_character_count);
+	unsigned int count_b = MSBTFONT_NATIVE(header_b, font_character_count);
+	unsigned int common_count = (count_a < count_b) ? count_a : count_b;
+	unsigned long long character_bits = (unsigned long long)(header_a->palette_format + 1) * (header_a->max_font_width + 1) * (header_a->max_font_height + 1);
+	size_t character_size = (size_t)((character_bits + 7) / 8);
+	size_t scratch_size = (character_bits % 8) ? 2 * (character_size + 1) : 0;
+	// Scratch memory comes from the allocator of the first font
+	const msbtfont_allocator *allocator = msbtfont_get_filedata_allocator(filedata_a);
+	unsigned char *scratch = NULL;
+	if (scratch_size != 0)
+	{
+		scratch = (unsigned char *)(msbtfont_allocate(allocator, scratch_size));
+		if (scratch == NULL)
+		{
+			return MSBTFONT_OUT_OF_MEMORY;
+		}
+		memset(scratch, 0, scratch_size);
+	}
+	const unsigned char *glyph_table_a = msbtfont_get_glyph_table(header_a, filedata_a);
+	const unsigned char *glyph_table_b = msbtfont_get_glyph_table(header_b, filedata_b);
+	const unsigned char *variable_table_a = filedata_a->variable_table;
+	const unsigned char *variable_table_b = filedata_b->variable_table;
+	unsigned int max_width = header_a->max_font_width;
+	unsigned int changed = 0;
+	unsigned int index = 0;
+	while (index < common_count)
+	{
+		// Eight consecutive characters always end on a byte boundary, so when both fonts store
+		// every character, unchanged groups of eight are skipped with a single comparison.
+		unsigned int group_end = (common_count - index >= 8) ? index + 8 : common_count;
+		if (glyph_table_a == NULL && glyph_table_b == NULL && group_end == index + 8)
+		{
+			size_t group_offset = (size_t)((index / 8) * character_bits);
+			int widths_equal = (variable_table_a == NULL && variable_table_b == NULL) || (variable_table_a != NULL && variable_table_b != NULL && memcmp(&variable_table_a[index], &variable_table_b[index], 8) == 0);
+			if (widths_equal && memcmp(&filedata_a->font_data[group_offset], &filedata_b->font_data[group_offset], (size_t)(character_bits)) == 0)
+			{
+				index = group_end;
+				continue;
+			}
+		}
+		for (; index < group_end; ++index)
+		{
+			unsigned int glyph_a = msbtfont_get_glyph(glyph_table_a, index);
+			unsigned int glyph_b = msbtfont_get_glyph(glyph_table_b, index);
+			if (glyph_a == MSBTFONT_NO_GLYPH || glyph_b == MSBTFONT_NO_GLYPH)
+			{
+				retcode = MSBTFONT_INVALID_FILEDATA;
+				break;
+			}
+			unsigned int width_a = (variable_table_a != NULL) ? variable_table_a[index] : max_width;
+			unsigned int width_b = (variable_table_b != NULL) ? variable_table_b[index] : max_width;
+			if (width_a == width_b && memcmp(msbtfont_glyph_bytes(filedata_a->font_data, glyph_a, character_bits, scratch), msbtfont_glyph_bytes(filedata_b->font_data, glyph_b, character_bits, (scratch != NULL) ? &scratch[character_size + 1] : NULL), character_size) == 0)
+			{
+				continue;
+			}
+			if (changed < capacity)
+			{
+				changed_indices[changed] = index;
+			}
+			++changed;
+		}
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			break;
+		}
+	}
+	if (scratch != NULL)
+	{
+		msbtfont_deallocate(allocator, scratch, scratch_size);
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	// Characters only one of the fonts has count as changed
+	for (index = common_count; index < count_a || index < count_b; ++index)
+	{
+		if (changed < capacity)
+		{
+			changed_indices[changed] = index;
+		}
+		++changed;
+	}
+	*changed_count = changed;
+	return MSBTFONT_SUCCESS;
+}
+
+static msbtfont_retcode msbtfont_compute_collection_layout(const msbtfont_header *headers, unsigned int font_count, unsigned long long *offsets, size_t *size)
+{
+	unsigned long long offset = sizeof(msbtfont_collection_header) + ((unsigned long long)(font_count) * sizeof(msbtfont_collection_entry));
+	for (unsigned int current_font = 0; current_font < font_count; ++current_font)
+	{
+		size_t variable_table_size = 0;
+		size_t font_data_size = 0;
+		if (MSBTFONT_NATIVE(&headers[current_font], magicword) != MSBTFONT_MSBT)
+		{
+			return MSBTFONT_INVALID_HEADER;
+		}
+		msbtfont_retcode retcode = msbtfont_compute_filedata_size(&headers[current_font], &variable_table_size, &font_data_size);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			return retcode;
+		}
+		offset = (offset + (MSBTFONT_COLLECTION_ALIGNMENT - 1)) & ~(unsigned long long)(MSBTFONT_COLLECTION_ALIGNMENT - 1);
+		if (offset > SIZE_MAX || variable_table_size + font_data_size > SIZE_MAX - offset)
+		{
+			return MSBTFONT_FONT_TOO_LARGE;
+		}
+		if (offsets != NULL)
+		{
+			offsets[current_font] = offset;
+		}
+		offset += variable_table_size + font_data_size;
+	}
+	if (offset > SIZE_MAX)
+	{
+		return MSBTFONT_FONT_TOO_LARGE;
+	}
+	*size = (size_t)(offset);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_collection_size(const msbtfont_header *headers, unsigned int font_count, size_t *size)
+{
+	if (headers == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (size == NULL)
+	{
+		return MSBTFONT_MISSING_SIZE;
+	}
+	return msbtfont_compute_collection_layout(headers, font_count, NULL, size);
+}
+
+msbtfont_retcode msbtfont_build_collection(const msbtfont_header *headers, const msbtfont_filedata *filedata, unsigned int font_count, unsigned char *data, size_t size)
+{
+	if (headers == NULL || filedata == NULL)
+	{
+		return (headers == NULL) ? MSBTFONT_MISSING_HEADER : MSBTFONT_MISSING_FILEDATA;
+	}
+	if (data == NULL)
+	{
+		return MSBTFONT_MISSING_DESTINATION_DATA;
+	}
+	size_t collection_size = 0;
+	msbtfont_retcode retcode = msbtfont_compute_collection_layout(headers, font_count, NULL, &collection_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (size < collection_size)
+	{
+		return MSBTFONT_INVALID_FILEDATA;
+	}
+	for (unsigned int current_font = 0; current_font < font_count; ++current_font)
+	{
+		if (filedata[current_font].data == NULL || filedata[current_font].font_data == NULL || ((headers[current_font].flags & 0x01) && filedata[current_font].variable_table == NULL))
+		{
+			return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+		}
+		retcode = msbtfont_validate_filedata(&headers[current_font], &filedata[current_font]);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			return retcode;
+		}
+	}
+	const unsigned char version_le_data[] = { 0, 0, 1, 0 };
+	const unsigned char version_be_data[] = { 0, 0, 0, 1 };
+	msbtfont_collection_header collection_header;
+	MSBTFONT_NATIVE(&collection_header, magicword) = MSBTFONT_MSBC;
+	MSBTFONT_FOREIGN(&collection_header, magicword) = MSBTFONT_CBSM;
+	memcpy(&collection_header.version_le, version_le_data, sizeof(collection_header.version_le));
+	memcpy(&collection_header.version_be, version_be_data, sizeof(collection_header.version_be));
+	MSBTFONT_NATIVE(&collection_header, font_count) = font_count;
+	MSBTFONT_FOREIGN(&collection_header, font_count) = msbtfont_swap32(font_count);
+	memset(data, 0, collection_size);
+	memcpy(data, &collection_header, sizeof(msbtfont_collection_header));
+	unsigned long long offset = sizeof(msbtfont_collection_header) + ((unsigned long long)(font_count) * sizeof(msbtfont_collection_entry));
+	for (unsigned int current_font = 0; current_font < font_count; ++current_font)
+	{
+		size_t variable_table_size = 0;
+		size_t font_data_size = 0;
+		msbtfont_compute_filedata_size(&headers[current_font], &variable_table_size, &font_data_size);
+		offset = (offset + (MSBTFONT_COLLECTION_ALIGNMENT - 1)) & ~(unsigned long long)(MSBTFONT_COLLECTION_ALIGNMENT - 1);
+		msbtfont_collection_entry entry;
+		memset(&entry, 0, sizeof(msbtfont_collection_entry));
+		MSBTFONT_NATIVE(&entry, offset) = offset;
+		MSBTFONT_FOREIGN(&entry, offset) = msbtfont_swap64(offset);
+		MSBTFONT_NATIVE(&entry, size) = variable_table_size + font_data_size;
+		MSBTFONT_FOREIGN(&entry, size) = msbtfont_swap64(variable_table_size + font_data_size);
+		entry.header = headers[current_font];
+		msbtfont_normalize_header(&entry.header);
+		memcpy(&data[sizeof(msbtfont_collection_header) + ((size_t)(current_font) * sizeof(msbtfont_collection_entry))], &entry, sizeof(msbtfont_collection_entry));
+		if (variable_table_size != 0)
+		{
+			memcpy(&data[(size_t)(offset)], filedata[current_font].variable_table, variable_table_size);
+		}
+		memcpy(&data[(size_t)(offset) + variable_table_size], filedata[current_font].font_data, font_data_size);
+		offset += variable_table_size + font_data_size;
+	}
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_open_collection(msbtfont_collection *collection, const unsigned char *data, size_t size)
+{
+	if (collection == NULL)
+	{
+		return MSBTFONT_MISSING_COLLECTION;
+	}
+	if (data == NULL)
+	{
+		return MSBTFONT_MISSING_SOURCE_DATA;
+	}
+	if (size < sizeof(msbtfont_collection_header))
+	{
+		return MSBTFONT_INVALID_COLLECTION;
+	}
+	msbtfont_collection_header collection_header;
+	memcpy(&collection_header, data, sizeof(msbtfont_collection_header));
+	unsigned int font_count = 0;
+	unsigned char foreign = 0;
+	if (MSBTFONT_NATIVE(&collection_header, magicword) == MSBTFONT_MSBC)
+	{
+		font_count = MSBTFONT_NATIVE(&collection_header, font_count);
+	}
+	else if (MSBTFONT_FOREIGN(&collection_header, magicword) == MSBTFONT_CBSM)
+	{
+		font_count = msbtfont_swap32(MSBTFONT_FOREIGN(&collection_header, font_count));
+		foreign = 1;
+	}
+	else
+	{
+		return MSBTFONT_INVALID_COLLECTION;
+	}
+	if ((size - sizeof(msbtfont_collection_header)) / sizeof(msbtfont_collection_entry) < font_count)
+	{
+		return MSBTFONT_INVALID_COLLECTION;
+	}
+	collection->data = data;
+	collection->size = size;
+	collection->font_count = font_count;
+	collection->foreign = foreign;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_collection_font(const msbtfont_collection *collection, unsigned int index, msbtfont_header *header, msbtfont_filedata *filedata)
+{
+	if (collection == NULL || collection->data == NULL)
+	{
+		return MSBTFONT_MISSING_COLLECTION;
+	}
+	if (header == NULL || filedata == NULL)
+	{
+		return (header == NULL) ? MSBTFONT_MISSING_HEADER : MSBTFONT_MISSING_FILEDATA;
+	}
+	if (index >= collection->font_count)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	msbtfont_collection_entry entry;
+	memcpy(&entry, &collection->data[sizeof(msbtfont_collection_header) + ((size_t)(index) * sizeof(msbtfont_collection_entry))], sizeof(msbtfont_collection_entry));
+	unsigned long long offset = collection->foreign ? msbtfont_swap64(MSBTFONT_FOREIGN(&entry, offset)) : MSBTFONT_NATIVE(&entry, offset);
+	unsigned long long font_size = collection->foreign ? msbtfont_swap64(MSBTFONT_FOREIGN(&entry, size)) : MSBTFONT_NATIVE(&entry, size);
+	if (offset > collection->size || font_size > collection->size - offset)
+	{
+		return MSBTFONT_INVALID_COLLECTION;
+	}
+	msbtfont_header font_header = entry.header;
+	msbtfont_retcode retcode = msbtfont_normalize_header(&font_header);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	// The file data only borrows the collection's memory, so deleting it never frees anything
+	retcode = msbtfont_adopt_filedata(&font_header, filedata, (unsigned char *)(&collection->data[(size_t)(offset)]), (size_t)(font_size), NULL);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	*header = font_header;
+	return MSBTFONT_SUCCESS;
+}
+
+// Slots are kept in a doubly linked list ordered from most (head) to least (tail) recently used.
+struct msbtfont_page_cache
+{
+	size_t allocation_size;
+	unsigned long long page_count;
+	unsigned int *page_slots; // Slot holding each page of the font, or MSBTFONT_NO_SLOT
+	unsigned long long *slot_pages; // Page held by each slot
+	unsigned int *previous_slots;
+	unsigned int *next_slots;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int used_slots;
+	unsigned char *scratch; // Holds characters that straddle two or more pages
+	unsigned char *pages;
+	struct msbtfont_prefetch_worker *worker; // Created by the first 'msbtfont_schedule_paged_prefetch'
+};
+
+struct msbtfont_prefetch_request
+{
+	unsigned long long first_page;
+	unsigned long long last_page;
+	unsigned long long ticket;
+	struct msbtfont_prefetch_request *next;
+};
+
+// Once the worker exists, every access to the cache happens with the lock held.  The worker
+// reads pages into its own staging buffer without the lock, so loads only wait for I/O they need.
+struct msbtfont_prefetch_worker
+{
+#if defined(_WIN32)
+	SRWLOCK lock;
+	CONDITION_VARIABLE wake;
+	HANDLE thread;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_t thread;
+#endif
+	struct msbtfont_prefetch_request *first_request;
+	struct msbtfont_prefetch_request *last_request;
+	unsigned long long scheduled_ticket;
+	unsigned long long completed_ticket;
+	unsigned char *staging;
+	int stopping;
+	msbtfont_paged_filedata *paged_filedata;
+};
+
+#if defined(_WIN32)
+// Positional reads through an OVERLAPPED offset (like pread) never touch a shared file position,
+// so the prefetch worker and loads can read at the same time.
+static size_t msbtfont_file_read(void *user_data, void *buffer, size_t size, unsigned long long offset)
+{
+	HANDLE file = (HANDLE)(user_data);
+	size_t total = 0;
+	while (total < size)
+	{
+		OVERLAPPED overlapped;
+		DWORD chunk = (size - total > 0x40000000) ? 0x40000000 : (DWORD)(size - total);
+		DWORD result = 0;
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = (DWORD)((offset + total) & 0xFFFFFFFF);
+		overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+		if (!ReadFile(file, &((unsigned char *)(buffer))[total], chunk, &result, &overlapped) || result == 0)
+		{
+			break;
+		}
+		total += result;
+	}
+	return total;
+}
+
+static void msbtfont_file_close(void *user_data)
+{
+	CloseHandle((HANDLE)(user_data));
+}
+
+static int msbtfont_file_open(msbtfont_reader *reader, const char *path)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+	reader->read = msbtfont_file_read;
+	reader->close = msbtfont_file_close;
+	reader->user_data = file;
+	return 1;
+}
+#else
+static size_t msbtfont_file_read(void *user_data, void *buffer, size_t size, unsigned long long offset)
+{
+	int file = (int)((intptr_t)(user_data));
+	size_t total = 0;
+	while (total < size)
+	{
+		ssize_t result = pread(file, &((unsigned char *)(buffer))[total], size - total, (off_t)(offset + total));
+		if (result <= 0)
+		{
+			break;
+		}
+		total += (size_t)(result);
+	}
+	return total;
+}
+
+static void msbtfont_file_close(void *user_data)
+{
+	close((int)((intptr_t)(user_data)));
+}
+
+static int msbtfont_file_open(msbtfont_reader *reader, const char *path)
+{
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return 0;
+	}
+	reader->read = msbtfont_file_read;
+	reader->close = msbtfont_file_close;
+	reader->user_data = (void *)((intptr_t)(file));
+	return 1;
+}
+#endif
+
+static void msbtfont_unlink_slot(struct msbtfont_page_cache *cache, unsigned int slot)
+{
+	if (cache->previous_slots[slot] != MSBTFONT_NO_SLOT)
+	{
+		cache->next_slots[cache->previous_slots[slot]] = cache->next_slots[slot];
+	}
+	else
+	{
+		cache->head = cache->next_slots[slot];
+	}
+	if (cache->next_slots[slot] != MSBTFONT_NO_SLOT)
+	{
+		cache->previous_slots[cache->next_slots[slot]] = cache->previous_slots[slot];
+	}
+	else
+	{
+		cache->tail = cache->previous_slots[slot];
+	}
+}
+
+static void msbtfont_link_slot(struct msbtfont_page_cache *cache, unsigned int slot, int most_recent)
+{
+	if (most_recent)
+	{
+		cache->previous_slots[slot] = MSBTFONT_NO_SLOT;
+		cache->next_slots[slot] = cache->head;
+		if (cache->head != MSBTFONT_NO_SLOT)
+		{
+			cache->previous_slots[cache->head] = slot;
+		}
+		cache->head = slot;
+		if (cache->tail == MSBTFONT_NO_SLOT)
+		{
+			cache->tail = slot;
+		}
+	}
+	else
+	{
+		cache->next_slots[slot] = MSBTFONT_NO_SLOT;
+		cache->previous_slots[slot] = cache->tail;
+		if (cache->tail != MSBTFONT_NO_SLOT)
+		{
+			cache->next_slots[cache->tail] = slot;
+		}
+		cache->tail = slot;
+		if (cache->head == MSBTFONT_NO_SLOT)
+		{
+			cache->head = slot;
+		}
+	}
+}
+
+static unsigned int msbtfont_find_page(struct msbtfont_page_cache *cache, unsigned long long page)
+{
+	unsigned int slot = cache->page_slots[page];
+	if (slot != MSBTFONT_NO_SLOT && cache->head != slot)
+	{
+		msbtfont_unlink_slot(cache, slot);
+		msbtfont_link_slot(cache, slot, 1);
+	}
+	return slot;
+}
+
+static unsigned int msbtfont_claim_slot(msbtfont_paged_filedata *paged_filedata)
+{
+	struct msbtfont_page_cache *cache = paged_filedata->cache;
+	if (cache->used_slots < paged_filedata->max_resident_pages)
+	{
+		return cache->used_slots++;
+	}
+	// Reuse the least recently used slot (failed reads are parked there as well)
+	unsigned int slot = cache->tail;
+	msbtfont_unlink_slot(cache, slot);
+	if (cache->slot_pages[slot] != ULLONG_MAX)
+	{
+		cache->page_slots[cache->slot_pages[slot]] = MSBTFONT_NO_SLOT;
+		--paged_filedata->resident_pages;
+	}
+	return slot;
+}
+
+static void msbtfont_install_page(msbtfont_paged_filedata *paged_filedata, unsigned int slot, unsigned long long page)
+{
+	struct msbtfont_page_cache *cache = paged_filedata->cache;
+	cache->slot_pages[slot] = page;
+	cache->page_slots[page] = slot;
+	msbtfont_link_slot(cache, slot, 1);
+	++paged_filedata->resident_pages;
+}
+
+static size_t msbtfont_get_page_size(const msbtfont_paged_filedata *paged_filedata, unsigned long long page)
+{
+	unsigned long long page_offset = page * paged_filedata->page_size;
+	return (paged_filedata->font_data_size - page_offset < paged_filedata->page_size) ? (size_t)(paged_filedata->font_data_size - page_offset) : paged_filedata->page_size;
+}
+
+static msbtfont_retcode msbtfont_get_page(msbtfont_paged_filedata *paged_filedata, unsigned long long page, const unsigned char **page_data)
+{
+	struct msbtfont_page_cache *cache = paged_filedata->cache;
+	unsigned int slot = msbtfont_find_page(cache, page);
+	if (slot == MSBTFONT_NO_SLOT)
+	{
+		slot = msbtfont_claim_slot(paged_filedata);
+		size_t page_size = msbtfont_get_page_size(paged_filedata, page);
+		if (paged_filedata->reader.read(paged_filedata->reader.user_data, &cache->pages[(size_t)(slot) * paged_filedata->page_size], page_size, paged_filedata->font_data_offset + (page * paged_filedata->page_size)) != page_size)
+		{
+			cache->slot_pages[slot] = ULLONG_MAX;
+			msbtfont_link_slot(cache, slot, 0);
+			return MSBTFONT_READ_FAILED;
+		}
+		msbtfont_install_page(paged_filedata, slot, page);
+	}
+	*page_data = &cache->pages[(size_t)(slot) * paged_filedata->page_size];
+	return MSBTFONT_SUCCESS;
+}
+
+static void msbtfont_lock_worker(struct msbtfont_prefetch_worker *worker)
+{
+	if (worker != NULL)
+	{
+#if defined(_WIN32)
+		AcquireSRWLockExclusive(&worker->lock);
+#else
+		pthread_mutex_lock(&worker->lock);
+#endif
+	}
+}
+
+static void msbtfont_unlock_worker(struct msbtfont_prefetch_worker *worker)
+{
+	if (worker != NULL)
+	{
+#if defined(_WIN32)
+		ReleaseSRWLockExclusive(&worker->lock);
+#else
+		pthread_mutex_unlock(&worker->lock);
+#endif
+	}
+}
+
+static void msbtfont_run_prefetch_worker(struct msbtfont_prefetch_worker *worker)
+{
+	msbtfont_paged_filedata *paged_filedata = worker->paged_filedata;
+	msbtfont_lock_worker(worker);
+	while (!worker->stopping)
+	{
+		struct msbtfont_prefetch_request *request = worker->first_request;
+		if (request == NULL)
+		{
+#if defined(_WIN32)
+			SleepConditionVariableSRW(&worker->wake, &worker->lock, INFINITE, 0);
+#else
+			pthread_cond_wait(&worker->wake, &worker->lock);
+#endif
+			continue;
+		}
+		// Read backwards so the start of the range ends up most recently used
+		for (unsigned long long current_page = request->last_page + 1; current_page > request->first_page && !worker->stopping; --current_page)
+		{
+			unsigned long long page = current_page - 1;
+			if (msbtfont_find_page(paged_filedata->cache, page) != MSBTFONT_NO_SLOT)
+			{
+				continue;
+			}
+			size_t page_size = msbtfont_get_page_size(paged_filedata, page);
+			msbtfont_unlock_worker(worker);
+			size_t read_size = paged_filedata->reader.read(paged_filedata->reader.user_data, worker->staging, page_size, paged_filedata->font_data_offset + (page * paged_filedata->page_size));
+			msbtfont_lock_worker(worker);
+			// A load may have brought the page in while the lock was released
+			if (read_size == page_size && paged_filedata->cache->page_slots[page] == MSBTFONT_NO_SLOT)
+			{
+				unsigned int slot = msbtfont_claim_slot(paged_filedata);
+				memcpy(&paged_filedata->cache->pages[(size_t)(slot) * paged_filedata->page_size], worker->staging, page_size);
+				msbtfont_install_page(paged_filedata, slot, page);
+			}
+		}
+		worker->first_request = request->next;
+		if (worker->first_request == NULL)
+		{
+			worker->last_request = NULL;
+		}
+		worker->completed_ticket = request->ticket;
+		msbtfont_deallocate(&paged_filedata->allocator, request, sizeof(struct msbtfont_prefetch_request));
+	}
+	msbtfont_unlock_worker(worker);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI msbtfont_prefetch_worker_main(LPVOID parameter)
+{
+	msbtfont_run_prefetch_worker((struct msbtfont_prefetch_worker *)(parameter));
+	return 0;
+}
+#else
+static void *msbtfont_prefetch_worker_main(void *parameter)
+{
+	msbtfont_run_prefetch_worker((struct msbtfont_prefetch_worker *)(parameter));
+	return NULL;
+}
+#endif
+
+static msbtfont_retcode msbtfont_start_prefetch_worker(msbtfont_paged_filedata *paged_filedata)
+{
+	struct msbtfont_prefetch_worker *worker = (struct msbtfont_prefetch_worker *)(msbtfont_allocate(&paged_filedata->allocator, sizeof(struct msbtfont_prefetch_worker)));
+	if (worker == NULL)
+	{
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	worker->staging = (unsigned char *)(msbtfont_allocate(&paged_filedata->allocator, paged_filedata->page_size));
+	if (worker->staging == NULL)
+	{
+		msbtfont_deallocate(&paged_filedata->allocator, worker, sizeof(struct msbtfont_prefetch_worker));
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	worker->first_request = NULL;
+	worker->last_request = NULL;
+	worker->scheduled_ticket = 0;
+	worker->completed_ticket = 0;
+	worker->stopping = 0;
+	worker->paged_filedata = paged_filedata;
+#if defined(_WIN32)
+	InitializeSRWLock(&worker->lock);
+	InitializeConditionVariable(&worker->wake);
+	worker->thread = CreateThread(NULL, 0, msbtfont_prefetch_worker_main, worker, 0, NULL);
+	if (worker->thread == NULL)
+#else
+	pthread_mutex_init(&worker->lock, NULL);
+	pthread_cond_init(&worker->wake, NULL);
+	if (pthread_create(&worker->thread, NULL, msbtfont_prefetch_worker_main, worker) != 0)
+#endif
+	{
+#if !defined(_WIN32)
+		pthread_cond_destroy(&worker->wake);
+		pthread_mutex_destroy(&worker->lock);
+#endif
+		msbtfont_deallocate(&paged_filedata->allocator, worker->staging, paged_filedata->page_size);
+		msbtfont_deallocate(&paged_filedata->allocator, worker, sizeof(struct msbtfont_prefetch_worker));
+		return MSBTFONT_THREAD_FAILED;
+	}
+	paged_filedata->cache->worker = worker;
+	return MSBTFONT_SUCCESS;
+}
+
+static void msbtfont_stop_prefetch_worker(msbtfont_paged_filedata *paged_filedata)
+{
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	msbtfont_lock_worker(worker);
+	worker->stopping = 1;
+#if defined(_WIN32)
+	WakeConditionVariable(&worker->wake);
+	msbtfont_unlock_worker(worker);
+	WaitForSingleObject(worker->thread, INFINITE);
+	CloseHandle(worker->thread);
+#else
+	pthread_cond_signal(&worker->wake);
+	msbtfont_unlock_worker(worker);
+	pthread_join(worker->thread, NULL);
+	pthread_cond_destroy(&worker->wake);
+	pthread_mutex_destroy(&worker->lock);
+#endif
+	while (worker->first_request != NULL)
+	{
+		struct msbtfont_prefetch_request *request = worker->first_request;
+		worker->first_request = request->next;
+		msbtfont_deallocate(&paged_filedata->allocator, request, sizeof(struct msbtfont_prefetch_request));
+	}
+	msbtfont_deallocate(&paged_filedata->allocator, worker->staging, paged_filedata->page_size);
+	msbtfont_deallocate(&paged_filedata->allocator, worker, sizeof(struct msbtfont_prefetch_worker));
+	paged_filedata->cache->worker = NULL;
+}
+
+static void msbtfont_get_page_range(const msbtfont_header *header, const msbtfont_paged_filedata *paged_filedata, unsigned int first_index, unsigned int count, unsigned long long *first_page, unsigned long long *last_page)
+{
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	*first_page = ((first_index * character_bits) / 8) / paged_filedata->page_size;
+	*last_page = ((((unsigned long long)(first_index) + count) * character_bits + 7) / 8 - 1) / paged_filedata->page_size;
+	if (*last_page - *first_page >= paged_filedata->max_resident_pages)
+	{
+		*last_page = *first_page + paged_filedata->max_resident_pages - 1;
+	}
+}
+
+static msbtfont_retcode msbtfont_check_paged_filedata(const msbtfont_header *header, const msbtfont_paged_filedata *paged_filedata)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (paged_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (paged_filedata->cache == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_open_paged_filedata(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, const msbtfont_paged_filedata_descriptor *descriptor)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (paged_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (descriptor == NULL || (descriptor->reader == NULL && descriptor->path == NULL) || (descriptor->reader != NULL && descriptor->reader->read == NULL))
+	{
+		return MSBTFONT_MISSING_READER;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	const msbtfont_allocator *allocator = (descriptor->allocator != NULL) ? descriptor->allocator : &msbtfont_global_allocator;
+	if (allocator->alloc == NULL || allocator->free == NULL)
+	{
+		return MSBTFONT_INVALID_ALLOCATOR;
+	}
+	size_t variable_table_size = 0;
+	size_t font_data_size = 0;
+	msbtfont_retcode retcode = msbtfont_compute_filedata_size(header, &variable_table_size, &font_data_size);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	size_t page_size = descriptor->page_size ? descriptor->page_size : MSBTFONT_DEFAULT_PAGE_SIZE;
+	unsigned int max_resident_pages = descriptor->max_resident_pages ? descriptor->max_resident_pages : MSBTFONT_DEFAULT_RESIDENT_PAGES;
+	unsigned long long page_count = (font_data_size / page_size) + ((font_data_size % page_size) ? 1 : 0);
+	if (page_count < max_resident_pages)
+	{
+		max_resident_pages = (page_count != 0) ? (unsigned int)(page_count) : 1;
+	}
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	size_t scratch_size = (size_t)((character_bits + 7) / 8) + 1;
+	// Everything lives in one allocation: the cache itself, the lookup tables, the scratch buffer and the pages
+	unsigned long long layout_size = sizeof(struct msbtfont_page_cache);
+	unsigned long long slot_pages_offset = (layout_size + 7) & ~7ull;
+	layout_size = slot_pages_offset + ((unsigned long long)(max_resident_pages) * sizeof(unsigned long long));
+	unsigned long long page_slots_offset = layout_size;
+	layout_size += page_count * sizeof(unsigned int);
+	unsigned long long previous_slots_offset = layout_size;
+	layout_size += (unsigned long long)(max_resident_pages) * sizeof(unsigned int);
+	unsigned long long next_slots_offset = layout_size;
+	layout_size += (unsigned long long)(max_resident_pages) * sizeof(unsigned int);
+	unsigned long long scratch_offset = layout_size;
+	layout_size += scratch_size;
+	unsigned long long pages_offset = (layout_size + (MSBTFONT_ALLOCATION_ALIGNMENT - 1)) & ~(unsigned long long)(MSBTFONT_ALLOCATION_ALIGNMENT - 1);
+	if (page_size > (ULLONG_MAX - pages_offset) / max_resident_pages || pages_offset + ((unsigned long long)(page_size) * max_resident_pages) > SIZE_MAX)
+	{
+		return MSBTFONT_FONT_TOO_LARGE;
+	}
+	layout_size = pages_offset + ((unsigned long long)(page_size) * max_resident_pages);
+	msbtfont_reader reader;
+	unsigned char owns_file = 0;
+	if (descriptor->reader != NULL)
+	{
+		reader = *descriptor->reader;
+	}
+	else
+	{
+		if (!msbtfont_file_open(&reader, descriptor->path))
+		{
+			return MSBTFONT_READ_FAILED;
+		}
+		owns_file = 1;
+	}
+	unsigned char *allocation = (unsigned char *)(msbtfont_allocate(allocator, (size_t)(layout_size) + variable_table_size));
+	if (allocation == NULL)
+	{
+		if (owns_file)
+		{
+			reader.close(reader.user_data);
+		}
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	struct msbtfont_page_cache *cache = (struct msbtfont_page_cache *)(allocation);
+	cache->allocation_size = (size_t)(layout_size) + variable_table_size;
+	cache->page_count = page_count;
+	cache->slot_pages = (unsigned long long *)(&allocation[(size_t)(slot_pages_offset)]);
+	cache->page_slots = (unsigned int *)(&allocation[(size_t)(page_slots_offset)]);
+	cache->previous_slots = (unsigned int *)(&allocation[(size_t)(previous_slots_offset)]);
+	cache->next_slots = (unsigned int *)(&allocation[(size_t)(next_slots_offset)]);
+	cache->scratch = &allocation[(size_t)(scratch_offset)];
+	cache->pages = &allocation[(size_t)(pages_offset)];
+	cache->head = MSBTFONT_NO_SLOT;
+	cache->tail = MSBTFONT_NO_SLOT;
+	cache->used_slots = 0;
+	cache->worker = NULL;
+	memset(cache->page_slots, 0xFF, (size_t)(page_count) * sizeof(unsigned int));
+	unsigned char *variable_table = NULL;
+	if (variable_table_size != 0)
+	{
+		variable_table = &allocation[(size_t)(layout_size)];
+		if (reader.read(reader.user_data, variable_table, variable_table_size, descriptor->offset) != variable_table_size)
+		{
+			msbtfont_deallocate(allocator, allocation, cache->allocation_size);
+			if (owns_file)
+			{
+				reader.close(reader.user_data);
+			}
+			return MSBTFONT_READ_FAILED;
+		}
+	}
+	paged_filedata->variable_table = variable_table;
+	paged_filedata->reader = reader;
+	paged_filedata->font_data_offset = descriptor->offset + variable_table_size;
+	paged_filedata->font_data_size = font_data_size;
+	paged_filedata->page_size = page_size;
+	paged_filedata->max_resident_pages = max_resident_pages;
+	paged_filedata->resident_pages = 0;
+	paged_filedata->allocator = *allocator;
+	paged_filedata->cache = cache;
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_close_paged_filedata(msbtfont_paged_filedata *paged_filedata)
+{
+	if (paged_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (paged_filedata->cache == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	if (paged_filedata->cache->worker != NULL)
+	{
+		msbtfont_stop_prefetch_worker(paged_filedata);
+	}
+	if (paged_filedata->reader.close != NULL)
+	{
+		paged_filedata->reader.close(paged_filedata->reader.user_data);
+	}
+	msbtfont_deallocate(&paged_filedata->allocator, paged_filedata->cache, paged_filedata->cache->allocation_size);
+	paged_filedata->cache = NULL;
+	paged_filedata->variable_table = NULL;
+	paged_filedata->resident_pages = 0;
+	return MSBTFONT_SUCCESS;
+}
+
+static msbtfont_retcode msbtfont_read_paged_character(msbtfont_paged_filedata *paged_filedata, unsigned char *dstdata, unsigned long long bit_offset, unsigned long long character_bits)
+{
+	unsigned long long first_byte = bit_offset / 8;
+	unsigned long long end_byte = (bit_offset + character_bits + 7) / 8;
+	unsigned long long first_page = first_byte / paged_filedata->page_size;
+	unsigned long long last_page = (end_byte - 1) / paged_filedata->page_size;
+	const unsigned char *page_data = NULL;
+	msbtfont_retcode retcode = MSBTFONT_SUCCESS;
+	if (first_page == last_page)
+	{
+		retcode = msbtfont_get_page(paged_filedata, first_page, &page_data);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			return retcode;
+		}
+		msbtfont_unpack_bits(dstdata, &page_data[(size_t)(first_byte - (first_page * paged_filedata->page_size))], bit_offset % 8, character_bits);
+		return MSBTFONT_SUCCESS;
+	}
+	// Gather the character's bytes first, since fetching a later page may evict an earlier one
+	unsigned char *scratch = paged_filedata->cache->scratch;
+	unsigned long long current_byte = first_byte;
+	for (unsigned long long current_page = first_page; current_page <= last_page; ++current_page)
+	{
+		retcode = msbtfont_get_page(paged_filedata, current_page, &page_data);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			return retcode;
+		}
+		unsigned long long page_end = (current_page + 1) * paged_filedata->page_size;
+		unsigned long long copy_end = (end_byte < page_end) ? end_byte : page_end;
+		memcpy(&scratch[(size_t)(current_byte - first_byte)], &page_data[(size_t)(current_byte - (current_page * paged_filedata->page_size))], (size_t)(copy_end - current_byte));
+		current_byte = copy_end;
+	}
+	msbtfont_unpack_bits(dstdata, scratch, bit_offset % 8, character_bits);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_load_paged_font_character_data(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned char *dstdata, unsigned int index)
+{
+	msbtfont_retcode retcode = msbtfont_check_paged_filedata(header, paged_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	if (dstdata == NULL)
+	{
+		return MSBTFONT_MISSING_DESTINATION_DATA;
+	}
+	if (index >= MSBTFONT_NATIVE(header, font_character_count))
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	msbtfont_lock_worker(worker);
+	retcode = msbtfont_read_paged_character(paged_filedata, dstdata, index * character_bits, character_bits);
+	msbtfont_unlock_worker(worker);
+	return retcode;
+}
+
+msbtfont_retcode msbtfont_prefetch_paged_characters(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned int first_index, unsigned int count)
+{
+	msbtfont_retcode retcode = msbtfont_check_paged_filedata(header, paged_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (first_index >= font_character_count)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	if (count > font_character_count - first_index)
+	{
+		count = font_character_count - first_index;
+	}
+	if (count == 0)
+	{
+		return MSBTFONT_SUCCESS;
+	}
+	unsigned long long first_page = 0;
+	unsigned long long last_page = 0;
+	msbtfont_get_page_range(header, paged_filedata, first_index, count, &first_page, &last_page);
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	msbtfont_lock_worker(worker);
+	// Read backwards so the start of the range ends up most recently used
+	for (unsigned long long current_page = last_page + 1; current_page > first_page; --current_page)
+	{
+		const unsigned char *page_data = NULL;
+		retcode = msbtfont_get_page(paged_filedata, current_page - 1, &page_data);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			break;
+		}
+	}
+	msbtfont_unlock_worker(worker);
+	return retcode;
+}
+
+msbtfont_retcode msbtfont_schedule_paged_prefetch(const msbtfont_header *header, msbtfont_paged_filedata *paged_filedata, unsigned int first_index, unsigned int count, unsigned long long *ticket)
+{
+	msbtfont_retcode retcode = msbtfont_check_paged_filedata(header, paged_filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (first_index >= font_character_count)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	if (count > font_character_count - first_index)
+	{
+		count = font_character_count - first_index;
+	}
+	if (count == 0)
+	{
+		count = 1;
+	}
+	if (paged_filedata->cache->worker == NULL)
+	{
+		retcode = msbtfont_start_prefetch_worker(paged_filedata);
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			return retcode;
+		}
+	}
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	struct msbtfont_prefetch_request *request = (struct msbtfont_prefetch_request *)(msbtfont_allocate(&paged_filedata->allocator, sizeof(struct msbtfont_prefetch_request)));
+	if (request == NULL)
+	{
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	msbtfont_get_page_range(header, paged_filedata, first_index, count, &request->first_page, &request->last_page);
+	request->next = NULL;
+	msbtfont_lock_worker(worker);
+	request->ticket = ++worker->scheduled_ticket;
+	if (worker->last_request != NULL)
+	{
+		worker->last_request->next = request;
+	}
+	else
+	{
+		worker->first_request = request;
+	}
+	worker->last_request = request;
+#if defined(_WIN32)
+	WakeConditionVariable(&worker->wake);
+#else
+	pthread_cond_signal(&worker->wake);
+#endif
+	if (ticket != NULL)
+	{
+		*ticket = request->ticket;
+	}
+	msbtfont_unlock_worker(worker);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_query_paged_prefetch(msbtfont_paged_filedata *paged_filedata, unsigned long long ticket, int *complete)
+{
+	if (paged_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (complete == NULL)
+	{
+		return MSBTFONT_MISSING_STATUS;
+	}
+	if (paged_filedata->cache == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	if (worker == NULL)
+	{
+		*complete = 1;
+		return MSBTFONT_SUCCESS;
+	}
+	msbtfont_lock_worker(worker);
+	*complete = (worker->completed_ticket >= ticket) ? 1 : 0;
+	msbtfont_unlock_worker(worker);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_paged_resident_pages(msbtfont_paged_filedata *paged_filedata, unsigned int *resident_pages)
+{
+	if (paged_filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (resident_pages == NULL)
+	{
+		return MSBTFONT_MISSING_STATUS;
+	}
+	if (paged_filedata->cache == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	struct msbtfont_prefetch_worker *worker = paged_filedata->cache->worker;
+	msbtfont_lock_worker(worker);
+	*resident_pages = paged_filedata->resident_pages;
+	msbtfont_unlock_worker(worker);
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_prefetch_characters(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int first_index, unsigned int count)
+{
+	if (header == NULL)
+	{
+		return MSBTFONT_MISSING_HEADER;
+	}
+	if (filedata == NULL)
+	{
+		return MSBTFONT_MISSING_FILEDATA;
+	}
+	if (MSBTFONT_NATIVE(header, magicword) != MSBTFONT_MSBT)
+	{
+		return MSBTFONT_INVALID_HEADER;
+	}
+	if (filedata->data == NULL || filedata->font_data == NULL)
+	{
+		return MSBTFONT_FILEDATA_NOT_INITIALIZED;
+	}
+	msbtfont_retcode retcode = msbtfont_check_filedata(header, filedata);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		return retcode;
+	}
+	unsigned int font_character_count = MSBTFONT_NATIVE(header, font_character_count);
+	if (first_index >= font_character_count)
+	{
+		return MSBTFONT_INDEX_OUT_OF_BOUNDS;
+	}
+	if (count > font_character_count - first_index)
+	{
+		count = font_character_count - first_index;
+	}
+	if (count == 0)
+	{
+		return MSBTFONT_SUCCESS;
+	}
+	unsigned long long character_bits = (unsigned long long)(header->palette_format + 1) * (header->max_font_width + 1) * (header->max_font_height + 1);
+	unsigned long long first_glyph = first_index;
+	unsigned long long end_glyph = (unsigned long long)(first_index) + count;
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		// The glyphs of a range of characters can be anywhere in the (already smaller) font data
+		first_glyph = 0;
+		end_glyph = msbtfont_read_le32(filedata->glyph_table);
+	}
+	uintptr_t start = (uintptr_t)(&filedata->font_data[(size_t)((first_glyph * character_bits) / 8)]);
+	uintptr_t end = (uintptr_t)(&filedata->font_data[(size_t)(((end_glyph * character_bits) + 7) / 8)]);
+#if defined(_WIN32)
+	// PrefetchVirtualMemory only exists since Windows 8, so it is looked up instead of linked
+	typedef struct
+	{
+		void *virtual_address;
+		SIZE_T number_of_bytes;
+	} msbtfont_memory_range;
+	typedef BOOL (WINAPI *msbtfont_prefetch_virtual_memory)(HANDLE process, ULONG_PTR entry_count, msbtfont_memory_range *entries, ULONG flags);
+	msbtfont_prefetch_virtual_memory prefetch_virtual_memory = (msbtfont_prefetch_virtual_memory)((void (*)(void))(GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory")));
+	if (prefetch_virtual_memory == NULL)
+	{
+		return MSBTFONT_FEATURE_DISABLED;
+	}
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	uintptr_t system_page_size = (uintptr_t)(system_info.dwPageSize);
+	start &= ~(system_page_size - 1);
+	msbtfont_memory_range range;
+	range.virtual_address = (void *)(start);
+	range.number_of_bytes = (SIZE_T)(end - start);
+	// The system starts reading the pages in the background; nothing is waited on here
+	prefetch_virtual_memory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// The kernel starts reading the pages in the background; nothing is waited on here
+	uintptr_t system_page_size = (uintptr_t)(sysconf(_SC_PAGESIZE));
+	start &= ~(system_page_size - 1);
+	posix_madvise((void *)(start), (size_t)(end - start), POSIX_MADV_WILLNEED);
+#endif
+	return MSBTFONT_SUCCESS;
+}
+
+msbtfont_retcode msbtfont_get_stats(msbtfont_stats *stats)
+{
+	if (stats == NULL)
+	{
+		return MSBTFONT_MISSING_STATS;
+	}
+#if defined(MSBTFONT_ENABLE_STATS)
+	*stats = msbtfont_thread_stats;
+	return MSBTFONT_SUCCESS;
+#else
+	memset(stats, 0, sizeof(msbtfont_stats));
+	return MSBTFONT_FEATURE_DISABLED;
+#endif
+}
+
+msbtfont_retcode msbtfont_reset_stats(void)
+{
+#if defined(MSBTFONT_ENABLE_STATS)
+	memset(&msbtfont_thread_stats, 0, sizeof(msbtfont_stats));
+	return MSBTFONT_SUCCESS;
+#else
+	return MSBTFONT_FEATURE_DISABLED;
+#endif
+}
@@ -0,0 +1,169 @@
+/* MisbitFont Library Fuzz Target
+ *
+ * libFuzzer entry point (built with the MSBTFONT_BUILD_FUZZERS CMake option and clang).  The
+ * first input byte picks how the font is made:  either a raw header followed by file data, as
+ * read from an untrusted file (normalized and adopted, so validation is exercised), or a small
+ * header descriptor followed by character data stored through the store functions.  Every font
+ * that is accepted is then loaded, stored back, copied to a surface (with and without effects),
+ * repacked and deduplicated.
+ *
+ * Usage:  msbtfont_fuzz [libFuzzer options] [corpus directory]
+ *
+ */
+
+#include "../include/msbtfont.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MSBTFONT_FUZZ_MAX_CHARACTERS 4096
+#define MSBTFONT_FUZZ_MAX_SURFACE_SIZE (16 * 1024 * 1024)
+
+static void msbtfont_fuzz_surface(const msbtfont_header *header, const msbtfont_filedata *filedata, const uint8_t *options)
+{
+	unsigned int characters_per_row = 1 + (options[0] % 64);
+	msbtfont_surface_descriptor surface_descriptor;
+	memset(&surface_descriptor, 0, sizeof(surface_descriptor));
+	if (msbtfont_get_surface_size(header, &surface_descriptor.rect, characters_per_row) != MSBTFONT_SUCCESS)
+	{
+		return;
+	}
+	surface_descriptor.format = (msbtfont_surface_format)(options[1] % 4);
+	surface_descriptor.origin = (msbtfont_surface_origin)((options[1] >> 2) % 2);
+	size_t surface_size = msbtfont_get_surface_memory_requirement(&surface_descriptor);
+	if (surface_size == 0 || surface_size > MSBTFONT_FUZZ_MAX_SURFACE_SIZE)
+	{
+		return;
+	}
+	unsigned char *surface_data = malloc(surface_size);
+	if (surface_data == NULL)
+	{
+		return;
+	}
+	msbtfont_copy_to_surface(header, filedata, characters_per_row, options[2], &surface_descriptor, surface_data);
+	msbtfont_effect_descriptor effect_descriptor;
+	effect_descriptor.bold = (unsigned char)(options[3] % (MSBTFONT_MAX_EFFECT_RADIUS + 2));
+	effect_descriptor.outline = (unsigned char)(options[4] % (MSBTFONT_MAX_EFFECT_RADIUS + 2));
+	effect_descriptor.outline_index = options[5];
+	effect_descriptor.shadow_index = options[6];
+	effect_descriptor.shadow_x = (signed char)(options[7]) % (MSBTFONT_MAX_EFFECT_RADIUS + 2);
+	effect_descriptor.shadow_y = (signed char)(options[8]) % (MSBTFONT_MAX_EFFECT_RADIUS + 2);
+	msbtfont_copy_to_surface_with_effects(header, filedata, characters_per_row, options[2], &surface_descriptor, &effect_descriptor, surface_data);
+	free(surface_data);
+}
+
+static void msbtfont_fuzz_font(msbtfont_header *header, msbtfont_filedata *filedata, const uint8_t *options)
+{
+	if (msbtfont_validate_filedata(header, filedata) != MSBTFONT_SUCCESS)
+	{
+		return;
+	}
+	size_t character_size = (((size_t)(header->palette_format) + 1) * ((size_t)(header->max_font_width) + 1) * ((size_t)(header->max_font_height) + 1) + 7) / 8;
+	unsigned char *character = malloc(character_size);
+	if (character != NULL)
+	{
+		// Loading stops at the first index past the end of the font
+		for (unsigned int index = 0; index < MSBTFONT_FUZZ_MAX_CHARACTERS; ++index)
+		{
+			if (msbtfont_load_font_character_data(header, filedata, character, index) != MSBTFONT_SUCCESS)
+			{
+				break;
+			}
+			msbtfont_store_font_character_data(header, filedata, character, index);
+		}
+		free(character);
+	}
+	msbtfont_fuzz_surface(header, filedata, options);
+	msbtfont_header repacked_header;
+	msbtfont_filedata repacked_filedata = MSBTFONT_FILEDATA_INIT;
+	if (msbtfont_repack(header, filedata, &repacked_header, &repacked_filedata, (unsigned char)(options[9] % 8), (msbtfont_repack_mode)(options[10] % 3)) == MSBTFONT_SUCCESS)
+	{
+		msbtfont_fuzz_surface(&repacked_header, &repacked_filedata, &options[1]);
+		msbtfont_delete_filedata(&repacked_filedata);
+	}
+	msbtfont_header deduplicated_header;
+	msbtfont_filedata deduplicated_filedata = MSBTFONT_FILEDATA_INIT;
+	if (msbtfont_deduplicate(header, filedata, &deduplicated_header, &deduplicated_filedata) == MSBTFONT_SUCCESS)
+	{
+		msbtfont_fuzz_surface(&deduplicated_header, &deduplicated_filedata, &options[2]);
+		msbtfont_delete_filedata(&deduplicated_filedata);
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	// Mode byte plus the options shared by every operation
+	uint8_t options[12];
+	if (size < 1 + sizeof(options))
+	{
+		return 0;
+	}
+	uint8_t mode = data[0];
+	memcpy(options, &data[1], sizeof(options));
+	data = &data[1 + sizeof(options)];
+	size -= 1 + sizeof(options);
+	msbtfont_header header;
+	msbtfont_filedata filedata = MSBTFONT_FILEDATA_INIT;
+	if (mode & 1)
+	{
+		// Raw header and file data, as they would come out of a file
+		if (size < sizeof(header))
+		{
+			return 0;
+		}
+		memcpy(&header, data, sizeof(header));
+		data = &data[sizeof(header)];
+		size -= sizeof(header);
+		if (msbtfont_normalize_header(&header) != MSBTFONT_SUCCESS)
+		{
+			return 0;
+		}
+		// A private copy lets the sanitizers catch any access past the end of the file data
+		unsigned char *buffer = malloc(size ? size : 1);
+		if (buffer == NULL)
+		{
+			return 0;
+		}
+		memcpy(buffer, data, size);
+		if (msbtfont_adopt_filedata(&header, &filedata, buffer, size, NULL) == MSBTFONT_SUCCESS)
+		{
+			msbtfont_fuzz_font(&header, &filedata, options);
+		}
+		free(buffer);
+		return 0;
+	}
+	// Small generated font filled with the rest of the input through the store functions
+	if (size < 4)
+	{
+		return 0;
+	}
+	msbtfont_header_descriptor header_descriptor;
+	memset(&header_descriptor, 0, sizeof(header_descriptor));
+	header_descriptor.palette_format = data[0] % 8;
+	header_descriptor.max_font_width = data[1] % 32;
+	header_descriptor.max_font_height = data[2] % 32;
+	header_descriptor.flags = (mode >> 1) & MSBTFONT_FLAG_VARIABLE_WIDTH;
+	header_descriptor.font_character_count = 1 + (data[3] % 128);
+	data = &data[4];
+	size -= 4;
+	if (msbtfont_create_header(&header, &header_descriptor) != MSBTFONT_SUCCESS || msbtfont_create_filedata(&header, &filedata) != MSBTFONT_SUCCESS)
+	{
+		return 0;
+	}
+	size_t character_size = (((size_t)(header_descriptor.palette_format) + 1) * ((size_t)(header_descriptor.max_font_width) + 1) * ((size_t)(header_descriptor.max_font_height) + 1) + 7) / 8;
+	if (size >= character_size * header_descriptor.font_character_count)
+	{
+		msbtfont_store_font_characters(&header, &filedata, data, 0, header_descriptor.font_character_count);
+	}
+	else
+	{
+		for (unsigned int index = 0; (size_t)(index + 1) * character_size <= size; ++index)
+		{
+			msbtfont_store_font_character_data(&header, &filedata, &data[(size_t)(index) * character_size], index % header_descriptor.font_character_count);
+		}
+	}
+	msbtfont_fuzz_font(&header, &filedata, options);
+	msbtfont_delete_filedata(&filedata);
+	return 0;
+}
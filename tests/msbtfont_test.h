@@ -0,0 +1,95 @@
+/* MisbitFont Library Test Helpers
+ *
+ * Shared by the test executables in this directory.  Every test is a plain executable that
+ * prints the failed checks to stderr and returns a non-zero exit code if any check failed,
+ * so they can be run from ctest without a test framework.
+ *
+ */
+
+#ifndef _MSBTFONT_TEST_H_
+#define _MSBTFONT_TEST_H_
+
+#include "../include/msbtfont.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MSBTFONT_TEST_MAX_REPORTED_FAILURES 32
+
+static unsigned long long msbtfont_test_failures = 0;
+
+// Records a failed check; Only the first few failures are printed to keep the output readable
+#define MSBTFONT_TEST_CHECK(condition, ...) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			if (msbtfont_test_failures++ < MSBTFONT_TEST_MAX_REPORTED_FAILURES) \
+			{ \
+				fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+				fprintf(stderr, __VA_ARGS__); \
+				fputc('\n', stderr); \
+			} \
+		} \
+	} while (0)
+
+// Deterministic xorshift generator so failures can be reproduced
+static inline unsigned int msbtfont_test_random(unsigned int *state)
+{
+	unsigned int value = *state;
+	value ^= value << 13;
+	value ^= value >> 17;
+	value ^= value << 5;
+	*state = value;
+	return value;
+}
+
+static inline void msbtfont_test_fill_random(unsigned int *state, unsigned char *data, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		data[i] = (unsigned char)(msbtfont_test_random(state) >> 24);
+	}
+}
+
+// Plain MSB-first bit accessors used as the reference for the packed font data layout
+static inline unsigned int msbtfont_test_get_bit(const unsigned char *data, unsigned long long bit)
+{
+	return (data[(size_t)(bit / 8)] >> (7 - (unsigned int)(bit % 8))) & 1;
+}
+
+static inline void msbtfont_test_set_bit(unsigned char *data, unsigned long long bit, unsigned int value)
+{
+	unsigned char mask = (unsigned char)(0x80 >> (unsigned int)(bit % 8));
+	data[(size_t)(bit / 8)] = (unsigned char)(value ? (data[(size_t)(bit / 8)] | mask) : (data[(size_t)(bit / 8)] & ~mask));
+}
+
+static inline int msbtfont_test_create_font(msbtfont_header *header, msbtfont_filedata *filedata, unsigned char palette_format, unsigned char width, unsigned char height, unsigned char flags, unsigned int count)
+{
+	msbtfont_header_descriptor header_descriptor;
+	memset(&header_descriptor, 0, sizeof(header_descriptor));
+	header_descriptor.palette_format = palette_format;
+	header_descriptor.max_font_width = (unsigned char)(width - 1);
+	header_descriptor.max_font_height = (unsigned char)(height - 1);
+	header_descriptor.flags = flags;
+	header_descriptor.font_character_count = count;
+	*filedata = (msbtfont_filedata)MSBTFONT_FILEDATA_INIT;
+	if (msbtfont_create_header(header, &header_descriptor) != MSBTFONT_SUCCESS)
+	{
+		return 0;
+	}
+	return msbtfont_create_filedata(header, filedata) == MSBTFONT_SUCCESS;
+}
+
+static inline int msbtfont_test_finish(const char *name)
+{
+	if (msbtfont_test_failures != 0)
+	{
+		fprintf(stderr, "%s: %llu check(s) failed\n", name, msbtfont_test_failures);
+		return EXIT_FAILURE;
+	}
+	printf("%s: all checks passed\n", name);
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,142 @@
+/* MisbitFont Differential Decoding Test
+ *
+ * Decodes every character of random fonts with a plain MSB-first bit reader working straight
+ * on the file data layout (variable table, glyph table, font data) and compares the pixels
+ * with the ones returned by 'msbtfont_load_font_character_data' and written to 8-bit surfaces
+ * by 'msbtfont_copy_to_surface'.  Plain, variable width and deduplicated fonts are covered.
+ *
+ */
+
+#include "msbtfont_test.h"
+
+#define MSBTFONT_TEST_FONT_COUNT 400
+
+// Reads a pixel value one bit at a time, most significant bit first
+static unsigned int msbtfont_test_read_pixel(const unsigned char *data, unsigned long long bit_offset, unsigned int bits_per_pixel)
+{
+	unsigned int value = 0;
+	for (unsigned int bit = 0; bit < bits_per_pixel; ++bit)
+	{
+		value = (value << 1) | msbtfont_test_get_bit(data, bit_offset + bit);
+	}
+	return value;
+}
+
+static unsigned int msbtfont_test_read_le32(const unsigned char *data)
+{
+	return (unsigned int)(data[0]) | ((unsigned int)(data[1]) << 8) | ((unsigned int)(data[2]) << 16) | ((unsigned int)(data[3]) << 24);
+}
+
+static void msbtfont_test_compare(const msbtfont_header *header, const msbtfont_filedata *filedata, unsigned int count, unsigned int characters_per_row, const char *config)
+{
+	unsigned int width = header->max_font_width + 1u;
+	unsigned int height = header->max_font_height + 1u;
+	unsigned int bits_per_pixel = header->palette_format + 1u;
+	unsigned long long character_bits = (unsigned long long)(bits_per_pixel) * width * height;
+	// Locate everything from the raw file data instead of trusting the file data pointers
+	const unsigned char *raw = filedata->data;
+	if (header->flags & MSBTFONT_FLAG_VARIABLE_WIDTH)
+	{
+		raw = &raw[count];
+	}
+	const unsigned char *glyph_table = NULL;
+	if (header->flags & MSBTFONT_FLAG_DEDUPLICATED)
+	{
+		glyph_table = raw;
+		raw = &raw[((size_t)(count) + 1) * 4];
+	}
+	msbtfont_surface_descriptor surface_descriptor;
+	memset(&surface_descriptor, 0, sizeof(surface_descriptor));
+	surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_8;
+	surface_descriptor.origin = MSBTFONT_SURFACE_ORIGIN_UPPERLEFT;
+	msbtfont_retcode retcode = msbtfont_get_surface_size(header, &surface_descriptor.rect, characters_per_row);
+	MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: msbtfont_get_surface_size returned %d", config, (int)(retcode));
+	size_t surface_size = msbtfont_get_surface_memory_requirement(&surface_descriptor);
+	size_t pitch = ((size_t)(surface_descriptor.rect.width) + 3) & ~(size_t)(3); // Surface rows are padded to 4 bytes
+	unsigned char *surface_data = malloc(surface_size ? surface_size : 1);
+	unsigned char *loaded = malloc((size_t)((character_bits + 7) / 8));
+	if (surface_data == NULL || loaded == NULL)
+	{
+		MSBTFONT_TEST_CHECK(0, "%s: out of memory", config);
+		free(surface_data);
+		free(loaded);
+		return;
+	}
+	retcode = msbtfont_copy_to_surface(header, filedata, characters_per_row, 0, &surface_descriptor, surface_data);
+	MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: msbtfont_copy_to_surface returned %d", config, (int)(retcode));
+	for (unsigned int index = 0; index < count; ++index)
+	{
+		unsigned int glyph = (glyph_table != NULL) ? msbtfont_test_read_le32(&glyph_table[4 + (size_t)(index) * 4]) : index;
+		retcode = msbtfont_load_font_character_data(header, filedata, loaded, index);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: load of character %u returned %d", config, index, (int)(retcode));
+		unsigned int column = index % characters_per_row;
+		unsigned int row = index / characters_per_row;
+		int mismatch = 0;
+		for (unsigned int y = 0; y < height && !mismatch; ++y)
+		{
+			for (unsigned int x = 0; x < width && !mismatch; ++x)
+			{
+				unsigned long long pixel = (unsigned long long)(y) * width + x;
+				unsigned int expected = msbtfont_test_read_pixel(raw, glyph * character_bits + pixel * bits_per_pixel, bits_per_pixel);
+				unsigned int from_load = msbtfont_test_read_pixel(loaded, pixel * bits_per_pixel, bits_per_pixel);
+				unsigned int from_surface = surface_data[((size_t)(row) * height + y) * pitch + (size_t)(column) * width + x];
+				if (from_load != expected || from_surface != expected)
+				{
+					MSBTFONT_TEST_CHECK(0, "%s: character %u pixel (%u, %u) is %u, loaded %u, copied %u", config, index, x, y, expected, from_load, from_surface);
+					mismatch = 1;
+				}
+			}
+		}
+	}
+	free(surface_data);
+	free(loaded);
+}
+
+int main(void)
+{
+	unsigned int state = 0x44494646;
+	for (unsigned int font = 0; font < MSBTFONT_TEST_FONT_COUNT; ++font)
+	{
+		msbtfont_header header;
+		msbtfont_filedata filedata;
+		unsigned char palette_format = (unsigned char)(msbtfont_test_random(&state) % 8);
+		unsigned char width = (unsigned char)(1 + msbtfont_test_random(&state) % 24);
+		unsigned char height = (unsigned char)(1 + msbtfont_test_random(&state) % 24);
+		unsigned char flags = (unsigned char)(msbtfont_test_random(&state) & MSBTFONT_FLAG_VARIABLE_WIDTH);
+		unsigned int count = 1 + msbtfont_test_random(&state) % 70;
+		unsigned int characters_per_row = 1 + msbtfont_test_random(&state) % 12;
+		char config[96];
+		snprintf(config, sizeof(config), "font %u (palette format %u, %ux%u, %u characters, flags %u)", font, palette_format, width, height, count, flags);
+		if (!msbtfont_test_create_font(&header, &filedata, palette_format, width, height, flags, count))
+		{
+			MSBTFONT_TEST_CHECK(0, "%s: font creation failed", config);
+			continue;
+		}
+		unsigned long long character_bits = (unsigned long long)(palette_format + 1) * width * height;
+		msbtfont_test_fill_random(&state, filedata.font_data, filedata.size - (size_t)(filedata.font_data - filedata.data));
+		// Repeat some characters so deduplication has something to share
+		for (unsigned int index = 1; index < count; ++index)
+		{
+			if (msbtfont_test_random(&state) % 3 == 0)
+			{
+				unsigned int source = msbtfont_test_random(&state) % index;
+				for (unsigned long long bit = 0; bit < character_bits; ++bit)
+				{
+					msbtfont_test_set_bit(filedata.font_data, index * character_bits + bit, msbtfont_test_get_bit(filedata.font_data, source * character_bits + bit));
+				}
+			}
+		}
+		msbtfont_test_compare(&header, &filedata, count, characters_per_row, config);
+		msbtfont_header deduplicated_header;
+		msbtfont_filedata deduplicated_filedata = MSBTFONT_FILEDATA_INIT;
+		msbtfont_retcode retcode = msbtfont_deduplicate(&header, &filedata, &deduplicated_header, &deduplicated_filedata);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: msbtfont_deduplicate returned %d", config, (int)(retcode));
+		if (retcode == MSBTFONT_SUCCESS)
+		{
+			msbtfont_test_compare(&deduplicated_header, &deduplicated_filedata, count, characters_per_row, config);
+			msbtfont_delete_filedata(&deduplicated_filedata);
+		}
+		msbtfont_delete_filedata(&filedata);
+	}
+	return msbtfont_test_finish("msbtfont_test_differential");
+}
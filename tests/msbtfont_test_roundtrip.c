@@ -0,0 +1,236 @@
+/* MisbitFont Store/Load Round-Trip Test
+ *
+ * Exhaustively stores and loads characters through 'msbtfont_store_font_character_data',
+ * 'msbtfont_store_font_characters' and 'msbtfont_load_font_character_data' for every palette
+ * format, odd character widths/heights and unaligned start characters.  The font data is
+ * checked against a plain bit-by-bit reference after every store, so bits belonging to the
+ * neighbouring characters (and the padding past the last character) must stay untouched.
+ * File data set up by hand (zeroed or not) is stored to and tracked as well.
+ *
+ */
+
+#include "msbtfont_test.h"
+
+static const unsigned char msbtfont_test_widths[] = { 1, 2, 3, 5, 7, 8, 9, 13 };
+static const unsigned char msbtfont_test_heights[] = { 1, 3, 7, 8, 11 };
+
+#define MSBTFONT_TEST_CHARACTER_COUNT 19
+#define MSBTFONT_TEST_GUARD_BYTES 4
+#define MSBTFONT_TEST_GUARD_VALUE 0xA5
+
+// Writes 'bit_count' bits of 'srcdata' into the reference font data, one bit at a time
+static void msbtfont_test_reference_store(unsigned char *font_data, unsigned long long bit_offset, const unsigned char *srcdata, unsigned long long bit_count)
+{
+	for (unsigned long long bit = 0; bit < bit_count; ++bit)
+	{
+		msbtfont_test_set_bit(font_data, bit_offset + bit, msbtfont_test_get_bit(srcdata, bit));
+	}
+}
+
+static void msbtfont_test_check_load(const msbtfont_header *header, const msbtfont_filedata *filedata, const unsigned char *expected, unsigned long long character_bits, unsigned int index, const char *config)
+{
+	size_t character_bytes = (size_t)((character_bits + 7) / 8);
+	unsigned char loaded[1024];
+	memset(loaded, MSBTFONT_TEST_GUARD_VALUE, character_bytes + MSBTFONT_TEST_GUARD_BYTES);
+	msbtfont_retcode retcode = msbtfont_load_font_character_data(header, filedata, loaded, index);
+	MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: load of character %u returned %d", config, index, (int)(retcode));
+	for (unsigned long long bit = 0; bit < character_bits; ++bit)
+	{
+		if (msbtfont_test_get_bit(loaded, bit) != msbtfont_test_get_bit(expected, index * character_bits + bit))
+		{
+			MSBTFONT_TEST_CHECK(0, "%s: character %u loaded the wrong value for bit %llu", config, index, bit);
+			break;
+		}
+	}
+	// Bits past the character in the last byte and anything after it must be left alone
+	for (unsigned long long bit = character_bits; bit < (unsigned long long)(character_bytes + MSBTFONT_TEST_GUARD_BYTES) * 8; ++bit)
+	{
+		if (msbtfont_test_get_bit(loaded, bit) != ((MSBTFONT_TEST_GUARD_VALUE >> (7 - (bit % 8))) & 1))
+		{
+			MSBTFONT_TEST_CHECK(0, "%s: load of character %u overwrote destination bit %llu", config, index, bit);
+			break;
+		}
+	}
+}
+
+static void msbtfont_test_check_font_data(const msbtfont_filedata *filedata, const unsigned char *expected, size_t variable_table_size, const char *config, const char *operation, unsigned int first_index, unsigned int count)
+{
+	size_t font_data_size = filedata->size - variable_table_size;
+	for (size_t i = 0; i < font_data_size; ++i)
+	{
+		if (filedata->font_data[i] != expected[i])
+		{
+			MSBTFONT_TEST_CHECK(0, "%s: %s of characters %u-%u changed font data byte %zu (0x%02X, expected 0x%02X)", config, operation, first_index, first_index + count - 1, i, filedata->font_data[i], expected[i]);
+			return;
+		}
+	}
+	for (size_t i = 0; i < variable_table_size; ++i)
+	{
+		if (filedata->variable_table[i] != 0)
+		{
+			MSBTFONT_TEST_CHECK(0, "%s: %s of characters %u-%u changed variable table entry %zu", config, operation, first_index, first_index + count - 1, i);
+			return;
+		}
+	}
+}
+
+static void msbtfont_test_roundtrip(unsigned int *state, unsigned char palette_format, unsigned char width, unsigned char height, unsigned char flags)
+{
+	msbtfont_header header;
+	msbtfont_filedata filedata;
+	char config[96];
+	snprintf(config, sizeof(config), "palette format %u, %ux%u, flags %u", palette_format, width, height, flags);
+	if (!msbtfont_test_create_font(&header, &filedata, palette_format, width, height, flags, MSBTFONT_TEST_CHARACTER_COUNT))
+	{
+		MSBTFONT_TEST_CHECK(0, "%s: font creation failed", config);
+		return;
+	}
+	unsigned long long character_bits = (unsigned long long)(palette_format + 1) * width * height;
+	size_t character_bytes = (size_t)((character_bits + 7) / 8);
+	size_t variable_table_size = (flags & MSBTFONT_FLAG_VARIABLE_WIDTH) ? MSBTFONT_TEST_CHARACTER_COUNT : 0;
+	size_t font_data_size = filedata.size - variable_table_size;
+	unsigned char *expected = malloc(font_data_size);
+	unsigned char *srcdata = malloc(character_bytes * MSBTFONT_TEST_CHARACTER_COUNT);
+	if (expected == NULL || srcdata == NULL)
+	{
+		MSBTFONT_TEST_CHECK(0, "%s: out of memory", config);
+		free(expected);
+		free(srcdata);
+		msbtfont_delete_filedata(&filedata);
+		return;
+	}
+	// Random font data (including the padding bits past the last character) shows any stray write
+	if (variable_table_size != 0)
+	{
+		memset(filedata.variable_table, 0, variable_table_size);
+	}
+	msbtfont_test_fill_random(state, filedata.font_data, font_data_size);
+	memcpy(expected, filedata.font_data, font_data_size);
+
+	// Every single character, through the single character store
+	for (unsigned int index = 0; index < MSBTFONT_TEST_CHARACTER_COUNT; ++index)
+	{
+		msbtfont_test_fill_random(state, srcdata, character_bytes);
+		msbtfont_retcode retcode = msbtfont_store_font_character_data(&header, &filedata, srcdata, index);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: store of character %u returned %d", config, index, (int)(retcode));
+		msbtfont_test_reference_store(expected, index * character_bits, srcdata, character_bits);
+		msbtfont_test_check_font_data(&filedata, expected, variable_table_size, config, "single store", index, 1);
+		for (unsigned int loaded = 0; loaded < MSBTFONT_TEST_CHARACTER_COUNT; ++loaded)
+		{
+			msbtfont_test_check_load(&header, &filedata, expected, character_bits, loaded, config);
+		}
+	}
+
+	// Every range of characters, starting on every (mostly unaligned) character
+	for (unsigned int first_index = 0; first_index < MSBTFONT_TEST_CHARACTER_COUNT; ++first_index)
+	{
+		for (unsigned int count = 1; first_index + count <= MSBTFONT_TEST_CHARACTER_COUNT; ++count)
+		{
+			msbtfont_test_fill_random(state, srcdata, character_bytes * count);
+			msbtfont_retcode retcode = msbtfont_store_font_characters(&header, &filedata, srcdata, first_index, count);
+			MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "%s: store of characters %u-%u returned %d", config, first_index, first_index + count - 1, (int)(retcode));
+			msbtfont_test_reference_store(expected, first_index * character_bits, srcdata, count * character_bits);
+			msbtfont_test_check_font_data(&filedata, expected, variable_table_size, config, "range store", first_index, count);
+		}
+		for (unsigned int loaded = 0; loaded < MSBTFONT_TEST_CHARACTER_COUNT; ++loaded)
+		{
+			msbtfont_test_check_load(&header, &filedata, expected, character_bits, loaded, config);
+		}
+	}
+
+	// Out of range stores must not touch anything
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_character_data(&header, &filedata, srcdata, MSBTFONT_TEST_CHARACTER_COUNT) == MSBTFONT_INDEX_OUT_OF_BOUNDS, "%s: store past the last character was accepted", config);
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_characters(&header, &filedata, srcdata, MSBTFONT_TEST_CHARACTER_COUNT - 1, 2) == MSBTFONT_INDEX_OUT_OF_BOUNDS, "%s: range store past the last character was accepted", config);
+	msbtfont_test_check_font_data(&filedata, expected, variable_table_size, config, "rejected store", MSBTFONT_TEST_CHARACTER_COUNT - 1, 2);
+
+	free(expected);
+	free(srcdata);
+	msbtfont_delete_filedata(&filedata);
+}
+
+// File data set up by hand around an application buffer (no allocator), as a loader would
+static void msbtfont_test_hand_built(unsigned int *state)
+{
+	msbtfont_header_descriptor header_descriptor;
+	memset(&header_descriptor, 0, sizeof(header_descriptor));
+	header_descriptor.palette_format = 1;
+	header_descriptor.max_font_width = 4;
+	header_descriptor.max_font_height = 6;
+	header_descriptor.font_character_count = MSBTFONT_TEST_CHARACTER_COUNT;
+	msbtfont_header header;
+	size_t size = 0;
+	if (msbtfont_create_header(&header, &header_descriptor) != MSBTFONT_SUCCESS || msbtfont_get_filedata_size(&header, &size) != MSBTFONT_SUCCESS)
+	{
+		MSBTFONT_TEST_CHECK(0, "hand built file data: header creation failed");
+		return;
+	}
+	unsigned char *buffer = malloc(size);
+	unsigned char srcdata[9]; // 2 bits per pixel, 5x7 pixels
+	if (buffer == NULL)
+	{
+		MSBTFONT_TEST_CHECK(0, "hand built file data: out of memory");
+		return;
+	}
+	// Leftovers in file data that was never zeroed must not be taken for a dirty tracker
+	msbtfont_filedata stray;
+	memset(&stray, 0xA5, sizeof(stray));
+	stray.data = buffer;
+	stray.variable_table = NULL;
+	stray.font_data = buffer;
+	stray.size = size;
+	msbtfont_test_fill_random(state, srcdata, sizeof(srcdata));
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_character_data(&header, &stray, srcdata, 3) == MSBTFONT_SUCCESS, "unzeroed file data: store failed");
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_characters(&header, &stray, srcdata, 4, 1) == MSBTFONT_SUCCESS, "unzeroed file data: range store failed");
+	MSBTFONT_TEST_CHECK(msbtfont_mark_dirty_characters(&header, &stray, 0, 1) == MSBTFONT_FILEDATA_NOT_INITIALIZED, "unzeroed file data: stray tracker was used");
+	MSBTFONT_TEST_CHECK(msbtfont_track_dirty_characters(&header, &stray, 0) == MSBTFONT_SUCCESS, "unzeroed file data: tracking couldn't be turned off");
+
+	msbtfont_filedata filedata = MSBTFONT_FILEDATA_INIT;
+	filedata.data = buffer;
+	filedata.font_data = buffer;
+	filedata.size = size;
+	MSBTFONT_TEST_CHECK(msbtfont_validate_filedata(&header, &filedata) == MSBTFONT_SUCCESS, "hand built file data: validation failed");
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_character_data(&header, &filedata, srcdata, 3) == MSBTFONT_SUCCESS, "hand built file data: store failed");
+	// Tracking falls back to the global allocator, as the file data has none
+	MSBTFONT_TEST_CHECK(msbtfont_track_dirty_characters(&header, &filedata, 1) == MSBTFONT_SUCCESS, "hand built file data: tracking couldn't be turned on");
+	MSBTFONT_TEST_CHECK(msbtfont_store_font_character_data(&header, &filedata, srcdata, 9) == MSBTFONT_SUCCESS, "hand built file data: tracked store failed");
+	// One row of characters, so the update of character 9 covers the 5 columns starting at 45
+	msbtfont_surface_descriptor surface_descriptor;
+	memset(&surface_descriptor, 0, sizeof(surface_descriptor));
+	surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_8;
+	unsigned char *surface_data = NULL;
+	if (msbtfont_get_surface_size(&header, &surface_descriptor.rect, MSBTFONT_TEST_CHARACTER_COUNT) == MSBTFONT_SUCCESS)
+	{
+		surface_data = calloc(msbtfont_get_surface_memory_requirement(&surface_descriptor), 1);
+	}
+	MSBTFONT_TEST_CHECK(surface_data != NULL, "hand built file data: surface creation failed");
+	if (surface_data != NULL)
+	{
+		msbtfont_rect rects[2];
+		unsigned int rect_count = 0;
+		msbtfont_retcode retcode = msbtfont_update_surface(&header, &filedata, MSBTFONT_TEST_CHARACTER_COUNT, 0, &surface_descriptor, NULL, surface_data, rects, 2, &rect_count);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS && rect_count == 1 && rects[0].x == 45 && rects[0].width == 5, "hand built file data: stored character wasn't marked dirty");
+		retcode = msbtfont_update_surface(&header, &filedata, MSBTFONT_TEST_CHARACTER_COUNT, 0, &surface_descriptor, NULL, surface_data, rects, 2, &rect_count);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS && rect_count == 0, "hand built file data: update didn't clear the dirty characters");
+		free(surface_data);
+	}
+	MSBTFONT_TEST_CHECK(msbtfont_track_dirty_characters(&header, &filedata, 0) == MSBTFONT_SUCCESS && filedata.dirty_tracker == NULL, "hand built file data: tracking couldn't be turned off");
+	free(buffer);
+}
+
+int main(void)
+{
+	unsigned int state = 0x4D534254;
+	for (unsigned char palette_format = 0; palette_format < 8; ++palette_format)
+	{
+		for (size_t width = 0; width < sizeof(msbtfont_test_widths); ++width)
+		{
+			for (size_t height = 0; height < sizeof(msbtfont_test_heights); ++height)
+			{
+				msbtfont_test_roundtrip(&state, palette_format, msbtfont_test_widths[width], msbtfont_test_heights[height], 0);
+				msbtfont_test_roundtrip(&state, palette_format, msbtfont_test_widths[width], msbtfont_test_heights[height], MSBTFONT_FLAG_VARIABLE_WIDTH);
+			}
+		}
+	}
+	msbtfont_test_hand_built(&state);
+	return msbtfont_test_finish("msbtfont_test_roundtrip");
+}
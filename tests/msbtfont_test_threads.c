@@ -0,0 +1,285 @@
+/* MisbitFont Thread Safety Test
+ *
+ * Built with ThreadSanitizer when the compiler supports it.  Several threads load, copy (plain,
+ * with effects and clipped) and render cells from one shared font into their own surfaces while
+ * other threads store separate 8-character aligned ranges of a second font, and the results are
+ * compared with single-threaded runs.  A paged copy of the font is then loaded while prefetches
+ * for other ranges run on its worker.
+ *
+ * Usage:  msbtfont_test_threads <scratch file path>
+ *
+ */
+
+#include "msbtfont_test.h"
+#include <pthread.h>
+
+#define MSBTFONT_TEST_THREAD_COUNT 4
+#define MSBTFONT_TEST_ITERATIONS 4
+#define MSBTFONT_TEST_CHARACTER_COUNT 96
+#define MSBTFONT_TEST_CHARACTERS_PER_ROW 16
+#define MSBTFONT_TEST_COLUMNS 24
+#define MSBTFONT_TEST_ROWS 8
+
+typedef struct msbtfont_test_output
+{
+	unsigned char *loaded;
+	unsigned char *copied;
+	unsigned char *effects;
+	unsigned char *clipped;
+	unsigned char *cells;
+} msbtfont_test_output;
+
+typedef struct msbtfont_test_context
+{
+	msbtfont_header header;
+	msbtfont_filedata filedata;
+	msbtfont_filedata stored_filedata; // Written by the store threads
+	size_t character_size;
+	msbtfont_surface_descriptor surface_descriptor;
+	size_t surface_size;
+	msbtfont_surface_descriptor cell_surface_descriptor;
+	size_t cell_surface_size;
+	msbtfont_effect_descriptor effect_descriptor;
+	msbtfont_rect clip_rect;
+	msbtfont_cell cells[MSBTFONT_TEST_COLUMNS * MSBTFONT_TEST_ROWS];
+	msbtfont_test_output expected;
+} msbtfont_test_context;
+
+typedef struct msbtfont_test_thread
+{
+	msbtfont_test_context *context;
+	unsigned int number;
+	msbtfont_test_output output;
+	int failed;
+	pthread_t thread;
+} msbtfont_test_thread;
+
+static int msbtfont_test_allocate_output(const msbtfont_test_context *context, msbtfont_test_output *output)
+{
+	output->loaded = malloc(context->character_size * MSBTFONT_TEST_CHARACTER_COUNT);
+	output->copied = malloc(context->surface_size);
+	output->effects = malloc(context->surface_size);
+	output->clipped = malloc(context->surface_size);
+	output->cells = malloc(context->cell_surface_size);
+	return output->loaded != NULL && output->copied != NULL && output->effects != NULL && output->clipped != NULL && output->cells != NULL;
+}
+
+static void msbtfont_test_free_output(msbtfont_test_output *output)
+{
+	free(output->loaded);
+	free(output->copied);
+	free(output->effects);
+	free(output->clipped);
+	free(output->cells);
+}
+
+// Everything a reader thread does with the shared font; Returns 0 if a call failed
+static int msbtfont_test_read_font(const msbtfont_test_context *context, msbtfont_test_output *output)
+{
+	int succeeded = 1;
+	msbtfont_cell previous_cells[MSBTFONT_TEST_COLUMNS * MSBTFONT_TEST_ROWS];
+	msbtfont_rect rects[MSBTFONT_TEST_ROWS];
+	unsigned int rect_count = 0;
+	for (unsigned int index = 0; index < MSBTFONT_TEST_CHARACTER_COUNT; ++index)
+	{
+		succeeded &= msbtfont_load_font_character_data(&context->header, &context->filedata, &output->loaded[index * context->character_size], index) == MSBTFONT_SUCCESS;
+	}
+	memset(output->copied, 0, context->surface_size);
+	memset(output->effects, 0, context->surface_size);
+	memset(output->clipped, 0, context->surface_size);
+	memset(output->cells, 0, context->cell_surface_size);
+	succeeded &= msbtfont_copy_to_surface(&context->header, &context->filedata, MSBTFONT_TEST_CHARACTERS_PER_ROW, 0, &context->surface_descriptor, output->copied) == MSBTFONT_SUCCESS;
+	succeeded &= msbtfont_copy_to_surface_with_effects(&context->header, &context->filedata, MSBTFONT_TEST_CHARACTERS_PER_ROW, 0, &context->surface_descriptor, &context->effect_descriptor, output->effects) == MSBTFONT_SUCCESS;
+	succeeded &= msbtfont_copy_to_surface_clipped(&context->header, &context->filedata, MSBTFONT_TEST_CHARACTERS_PER_ROW, 0, &context->surface_descriptor, NULL, &context->clip_rect, output->clipped) == MSBTFONT_SUCCESS;
+	// Full draw followed by a damage-tracked redraw of the same frame (which draws nothing)
+	memset(previous_cells, 0xFF, sizeof(previous_cells));
+	succeeded &= msbtfont_render_cells(&context->header, &context->filedata, MSBTFONT_TEST_COLUMNS, MSBTFONT_TEST_ROWS, context->cells, previous_cells, &context->cell_surface_descriptor, output->cells, rects, MSBTFONT_TEST_ROWS, &rect_count) == MSBTFONT_SUCCESS;
+	succeeded &= msbtfont_render_cells(&context->header, &context->filedata, MSBTFONT_TEST_COLUMNS, MSBTFONT_TEST_ROWS, context->cells, previous_cells, &context->cell_surface_descriptor, output->cells, rects, MSBTFONT_TEST_ROWS, &rect_count) == MSBTFONT_SUCCESS;
+	succeeded &= (rect_count == 0);
+	return succeeded;
+}
+
+static int msbtfont_test_compare_output(const msbtfont_test_context *context, const msbtfont_test_output *output)
+{
+	return memcmp(output->loaded, context->expected.loaded, context->character_size * MSBTFONT_TEST_CHARACTER_COUNT) == 0 &&
+		memcmp(output->copied, context->expected.copied, context->surface_size) == 0 &&
+		memcmp(output->effects, context->expected.effects, context->surface_size) == 0 &&
+		memcmp(output->clipped, context->expected.clipped, context->surface_size) == 0 &&
+		memcmp(output->cells, context->expected.cells, context->cell_surface_size) == 0;
+}
+
+static void *msbtfont_test_reader_main(void *parameter)
+{
+	msbtfont_test_thread *thread = (msbtfont_test_thread *)(parameter);
+	for (unsigned int iteration = 0; iteration < MSBTFONT_TEST_ITERATIONS; ++iteration)
+	{
+		if (!msbtfont_test_read_font(thread->context, &thread->output) || !msbtfont_test_compare_output(thread->context, &thread->output))
+		{
+			thread->failed = 1;
+		}
+	}
+	return NULL;
+}
+
+// Stores every character of its share of 8-character aligned ranges, as loaded from the shared font
+static void *msbtfont_test_store_main(void *parameter)
+{
+	msbtfont_test_thread *thread = (msbtfont_test_thread *)(parameter);
+	msbtfont_test_context *context = thread->context;
+	for (unsigned int first_index = thread->number * 8; first_index < MSBTFONT_TEST_CHARACTER_COUNT; first_index += MSBTFONT_TEST_THREAD_COUNT * 8)
+	{
+		unsigned int count = (MSBTFONT_TEST_CHARACTER_COUNT - first_index < 8) ? MSBTFONT_TEST_CHARACTER_COUNT - first_index : 8;
+		if ((first_index / 8) % 2)
+		{
+			for (unsigned int index = first_index; index < first_index + count; ++index)
+			{
+				thread->failed |= msbtfont_store_font_character_data(&context->header, &context->stored_filedata, &context->expected.loaded[index * context->character_size], index) != MSBTFONT_SUCCESS;
+			}
+		}
+		else
+		{
+			// Packed range copied straight from the shared font data
+			thread->failed |= msbtfont_store_font_characters(&context->header, &context->stored_filedata, &context->filedata.font_data[first_index * context->character_size], first_index, count) != MSBTFONT_SUCCESS;
+		}
+	}
+	return NULL;
+}
+
+static void msbtfont_test_shared_font(msbtfont_test_context *context)
+{
+	msbtfont_test_thread threads[MSBTFONT_TEST_THREAD_COUNT * 2];
+	unsigned int started = 0;
+	memset(threads, 0, sizeof(threads));
+	for (unsigned int i = 0; i < MSBTFONT_TEST_THREAD_COUNT * 2; ++i)
+	{
+		threads[i].context = context;
+		threads[i].number = i % MSBTFONT_TEST_THREAD_COUNT;
+		if (i < MSBTFONT_TEST_THREAD_COUNT && !msbtfont_test_allocate_output(context, &threads[i].output))
+		{
+			MSBTFONT_TEST_CHECK(0, "out of memory");
+			break;
+		}
+		if (pthread_create(&threads[i].thread, NULL, (i < MSBTFONT_TEST_THREAD_COUNT) ? msbtfont_test_reader_main : msbtfont_test_store_main, &threads[i]) != 0)
+		{
+			MSBTFONT_TEST_CHECK(0, "could not start thread %u", i);
+			break;
+		}
+		++started;
+	}
+	for (unsigned int i = 0; i < started; ++i)
+	{
+		pthread_join(threads[i].thread, NULL);
+		MSBTFONT_TEST_CHECK(!threads[i].failed, "%s thread %u got results that differ from a single thread", (i < MSBTFONT_TEST_THREAD_COUNT) ? "reader" : "store", threads[i].number);
+	}
+	for (unsigned int i = 0; i < MSBTFONT_TEST_THREAD_COUNT; ++i)
+	{
+		msbtfont_test_free_output(&threads[i].output);
+	}
+	MSBTFONT_TEST_CHECK(memcmp(context->stored_filedata.data, context->filedata.data, context->filedata.size) == 0, "font stored from several threads differs from the source font");
+}
+
+static void msbtfont_test_paged_font(msbtfont_test_context *context, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		MSBTFONT_TEST_CHECK(0, "could not create %s", path);
+		return;
+	}
+	size_t written = fwrite(context->filedata.data, 1, context->filedata.size, file);
+	fclose(file);
+	MSBTFONT_TEST_CHECK(written == context->filedata.size, "could not write %s", path);
+	msbtfont_paged_filedata paged_filedata;
+	msbtfont_paged_filedata_descriptor descriptor;
+	memset(&paged_filedata, 0, sizeof(paged_filedata));
+	memset(&descriptor, 0, sizeof(descriptor));
+	descriptor.path = path;
+	descriptor.page_size = 64; // Small pages and cache so prefetches keep evicting what loads use
+	descriptor.max_resident_pages = 4;
+	msbtfont_retcode retcode = msbtfont_open_paged_filedata(&context->header, &paged_filedata, &descriptor);
+	MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "msbtfont_open_paged_filedata returned %d", (int)(retcode));
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		remove(path);
+		return;
+	}
+	unsigned char *character = malloc(context->character_size);
+	unsigned int state = 0x50414745;
+	unsigned long long ticket = 0;
+	for (unsigned int iteration = 0; iteration < 400 && character != NULL; ++iteration)
+	{
+		unsigned int first_index = msbtfont_test_random(&state) % MSBTFONT_TEST_CHARACTER_COUNT;
+		unsigned int count = 1 + msbtfont_test_random(&state) % 16;
+		retcode = msbtfont_schedule_paged_prefetch(&context->header, &paged_filedata, first_index, count, &ticket);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "msbtfont_schedule_paged_prefetch returned %d", (int)(retcode));
+		unsigned int index = msbtfont_test_random(&state) % MSBTFONT_TEST_CHARACTER_COUNT;
+		retcode = msbtfont_load_paged_font_character_data(&context->header, &paged_filedata, character, index);
+		MSBTFONT_TEST_CHECK(retcode == MSBTFONT_SUCCESS, "msbtfont_load_paged_font_character_data returned %d", (int)(retcode));
+		MSBTFONT_TEST_CHECK(memcmp(character, &context->expected.loaded[index * context->character_size], context->character_size) == 0, "paged character %u differs from the loaded one", index);
+		unsigned int resident_pages = 0;
+		int complete = 0;
+		MSBTFONT_TEST_CHECK(msbtfont_get_paged_resident_pages(&paged_filedata, &resident_pages) == MSBTFONT_SUCCESS && resident_pages <= descriptor.max_resident_pages, "resident page count %u is wrong", resident_pages);
+		MSBTFONT_TEST_CHECK(msbtfont_query_paged_prefetch(&paged_filedata, ticket, &complete) == MSBTFONT_SUCCESS, "msbtfont_query_paged_prefetch failed");
+	}
+	free(character);
+	// Closing with prefetches still queued must stop the worker cleanly
+	msbtfont_close_paged_filedata(&paged_filedata);
+	remove(path);
+}
+
+int main(int argc, char **argv)
+{
+	msbtfont_test_context *context = calloc(1, sizeof(msbtfont_test_context));
+	if (argc < 2 || context == NULL)
+	{
+		fprintf(stderr, "Usage:  %s <scratch file path>\n", argv[0]);
+		free(context);
+		return EXIT_FAILURE;
+	}
+	unsigned int state = 0x54485244;
+	if (!msbtfont_test_create_font(&context->header, &context->filedata, 2, 8, 8, 0, MSBTFONT_TEST_CHARACTER_COUNT) || !msbtfont_test_create_font(&context->header, &context->stored_filedata, 2, 8, 8, 0, MSBTFONT_TEST_CHARACTER_COUNT))
+	{
+		fprintf(stderr, "font creation failed\n");
+		return EXIT_FAILURE;
+	}
+	msbtfont_test_fill_random(&state, context->filedata.data, context->filedata.size);
+	context->character_size = (3 * 8 * 8) / 8;
+	context->surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_8;
+	context->surface_descriptor.origin = MSBTFONT_SURFACE_ORIGIN_UPPERLEFT;
+	msbtfont_get_surface_size(&context->header, &context->surface_descriptor.rect, MSBTFONT_TEST_CHARACTERS_PER_ROW);
+	context->surface_size = msbtfont_get_surface_memory_requirement(&context->surface_descriptor);
+	context->cell_surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_32_8;
+	context->cell_surface_descriptor.origin = MSBTFONT_SURFACE_ORIGIN_LOWERLEFT;
+	context->cell_surface_descriptor.rect.width = MSBTFONT_TEST_COLUMNS * 8;
+	context->cell_surface_descriptor.rect.height = MSBTFONT_TEST_ROWS * 8;
+	context->cell_surface_size = msbtfont_get_surface_memory_requirement(&context->cell_surface_descriptor);
+	context->effect_descriptor.bold = 1;
+	context->effect_descriptor.outline = 1;
+	context->effect_descriptor.outline_index = 8;
+	context->effect_descriptor.shadow_index = 9;
+	context->effect_descriptor.shadow_x = 1;
+	context->effect_descriptor.shadow_y = 1;
+	context->clip_rect.x = 13;
+	context->clip_rect.y = 5;
+	context->clip_rect.width = 70;
+	context->clip_rect.height = 29;
+	for (unsigned int i = 0; i < MSBTFONT_TEST_COLUMNS * MSBTFONT_TEST_ROWS; ++i)
+	{
+		context->cells[i].character = msbtfont_test_random(&state) % (MSBTFONT_TEST_CHARACTER_COUNT + 4);
+		context->cells[i].foreground = msbtfont_test_random(&state);
+		context->cells[i].background = msbtfont_test_random(&state);
+	}
+	if (!msbtfont_test_allocate_output(context, &context->expected))
+	{
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+	MSBTFONT_TEST_CHECK(msbtfont_test_read_font(context, &context->expected), "single threaded run failed");
+	msbtfont_test_shared_font(context);
+	msbtfont_test_paged_font(context, argv[1]);
+	msbtfont_test_free_output(&context->expected);
+	msbtfont_delete_filedata(&context->filedata);
+	msbtfont_delete_filedata(&context->stored_filedata);
+	free(context);
+	return msbtfont_test_finish("msbtfont_test_threads");
+}
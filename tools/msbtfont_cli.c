@@ -0,0 +1,789 @@
+/* MisbitFont Command Line Tool
+ *
+ * Inspects, converts, bakes, compares and imports MisbitFont files (a 'msbtfont_header' followed
+ * by the file data) and times the library on them.  Everything goes through the public library
+ * functions, so the timings reflect what applications get.
+ *
+ * Usage:
+ *   msbtfont info <font.msbt>
+ *   msbtfont convert <input.msbt> <output.msbt> [--palette-format <0-7>] [--mode threshold|scale|dither] [--deduplicate]
+ *   msbtfont bake <font.msbt> <output.png|output.raw> [--format 8|16|24|32] [--origin upper|lower] [--columns <count>] [--glyphs]
+ *   msbtfont bench <font.msbt> [--min-time <ms>]
+ *   msbtfont diff <old.msbt> <new.msbt>
+ *   msbtfont import <font.bdf|font.pcf|font.psf> <output.msbt> [--first <code>] [--last <code>] [--threads <count>]
+ *
+ */
+
+#include "../include/msbtfont.h"
+#include "msbtfont_import.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct msbtfont_cli_font
+{
+	msbtfont_header header;
+	msbtfont_filedata filedata;
+	int little_endian_valid; // Whether each copy of the header was valid before normalizing
+	int big_endian_valid;
+} msbtfont_cli_font;
+
+static int msbtfont_cli_little_endian_host(void)
+{
+	const unsigned int value = 1;
+	unsigned char first_byte = 0;
+	memcpy(&first_byte, &value, 1);
+	return first_byte == 1;
+}
+
+static unsigned int msbtfont_cli_character_count(const msbtfont_header *header)
+{
+	return msbtfont_cli_little_endian_host() ? header->font_character_count_le : header->font_character_count_be;
+}
+
+static double msbtfont_cli_now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)(ts.tv_sec) + ((double)(ts.tv_nsec) / 1e9);
+}
+
+// Resizes a buffer from the library's allocator, emulating 'realloc' when the allocator has none
+static unsigned char *msbtfont_cli_resize(const msbtfont_allocator *allocator, unsigned char *data, size_t old_size, size_t new_size)
+{
+	if (allocator->realloc != NULL)
+	{
+		return (unsigned char *)(allocator->realloc(allocator->user_data, data, old_size, new_size, 16));
+	}
+	unsigned char *resized = (unsigned char *)(allocator->alloc(allocator->user_data, new_size, 16));
+	if (resized != NULL)
+	{
+		memcpy(resized, data, (old_size < new_size) ? old_size : new_size);
+		allocator->free(allocator->user_data, data, old_size);
+	}
+	return resized;
+}
+
+static int msbtfont_cli_load_remainder(const char *path, FILE *input, msbtfont_cli_font *font)
+{
+	msbtfont_allocator allocator;
+	msbtfont_get_allocator(&allocator);
+	size_t capacity = 65536;
+	size_t size = 0;
+	unsigned char *data = (unsigned char *)(allocator.alloc(allocator.user_data, capacity, 16));
+	while (data != NULL)
+	{
+		size += fread(&data[size], 1, capacity - size, input);
+		if (size < capacity)
+		{
+			break;
+		}
+		unsigned char *larger = msbtfont_cli_resize(&allocator, data, capacity, capacity * 2);
+		if (larger == NULL)
+		{
+			allocator.free(allocator.user_data, data, capacity);
+		}
+		data = larger;
+		capacity *= 2;
+	}
+	fclose(input);
+	if (data != NULL && size != capacity)
+	{
+		// Trim the buffer to the data read so it is freed with the size it was allocated with
+		unsigned char *trimmed = msbtfont_cli_resize(&allocator, data, capacity, size ? size : 1);
+		if (trimmed == NULL)
+		{
+			allocator.free(allocator.user_data, data, capacity);
+		}
+		data = trimmed;
+	}
+	if (data == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	msbtfont_retcode retcode = msbtfont_adopt_filedata(&font->header, &font->filedata, data, size, &allocator);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "'%s' is truncated or invalid (error %d).\n", path, retcode);
+		allocator.free(allocator.user_data, data, size ? size : 1);
+		return 0;
+	}
+	return 1;
+}
+
+static int msbtfont_cli_load(const char *path, msbtfont_cli_font *font)
+{
+	FILE *input = fopen(path, "rb");
+	if (input == NULL)
+	{
+		fprintf(stderr, "Couldn't open '%s'.\n", path);
+		return 0;
+	}
+	if (fread(&font->header, sizeof(msbtfont_header), 1, input) != 1)
+	{
+		fprintf(stderr, "'%s' is too small to be a MisbitFont file.\n", path);
+		fclose(input);
+		return 0;
+	}
+	font->little_endian_valid = (memcmp(&font->header.magicword_le, "MSBT", 4) == 0);
+	font->big_endian_valid = (memcmp(&font->header.magicword_be, "TBSM", 4) == 0);
+	msbtfont_retcode retcode = msbtfont_normalize_header(&font->header);
+	if (retcode == MSBTFONT_SUCCESS && (font->header.flags & MSBTFONT_FLAG_DEDUPLICATED))
+	{
+		// The size of a deduplicated font depends on its glyph table, so read the rest of the file
+		return msbtfont_cli_load_remainder(path, input, font);
+	}
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		// Reading straight into the file data, so there's no point in clearing it first
+		retcode = msbtfont_create_filedata_with_initialization(&font->header, &font->filedata, NULL, MSBTFONT_FILEDATA_UNINITIALIZED);
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "'%s' has an invalid header (error %d).\n", path, retcode);
+		fclose(input);
+		return 0;
+	}
+	size_t read_size = fread(font->filedata.data, 1, font->filedata.size, input);
+	fclose(input);
+	if (read_size != font->filedata.size)
+	{
+		fprintf(stderr, "'%s' is truncated (%llu of %llu bytes of file data).\n", path, (unsigned long long)(read_size), (unsigned long long)(font->filedata.size));
+		msbtfont_delete_filedata(&font->filedata);
+		return 0;
+	}
+	return 1;
+}
+
+static int msbtfont_cli_save(const char *path, const msbtfont_header *header, const msbtfont_filedata *filedata)
+{
+	FILE *output = fopen(path, "wb");
+	if (output == NULL)
+	{
+		fprintf(stderr, "Couldn't create '%s'.\n", path);
+		return 0;
+	}
+	int written = (fwrite(header, sizeof(msbtfont_header), 1, output) == 1) && (fwrite(filedata->data, 1, filedata->size, output) == filedata->size);
+	if (fclose(output) != 0 || !written)
+	{
+		fprintf(stderr, "Couldn't write '%s'.\n", path);
+		remove(path);
+		return 0;
+	}
+	return 1;
+}
+
+static const char *msbtfont_cli_option(int argc, char *argv[], int first, const char *name)
+{
+	for (int i = first; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], name) == 0)
+		{
+			return argv[i + 1];
+		}
+	}
+	return NULL;
+}
+
+static int msbtfont_cli_flag(int argc, char *argv[], int first, const char *name)
+{
+	for (int i = first; i < argc; ++i)
+	{
+		if (strcmp(argv[i], name) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int msbtfont_cli_info(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		return 2;
+	}
+	msbtfont_cli_font font;
+	if (!msbtfont_cli_load(argv[2], &font))
+	{
+		return 1;
+	}
+	const msbtfont_header *header = &font.header;
+	unsigned int count = msbtfont_cli_character_count(header);
+	unsigned short major = msbtfont_cli_little_endian_host() ? header->version_le.major : header->version_be.major;
+	unsigned short minor = msbtfont_cli_little_endian_host() ? header->version_le.minor : header->version_be.minor;
+	printf("File:              %s\n", argv[2]);
+	printf("Version:           %u.%u\n", major, minor);
+	printf("Header copies:     %s\n", (font.little_endian_valid && font.big_endian_valid) ? "little and big endian" : (font.little_endian_valid ? "little endian only" : "big endian only"));
+	printf("Font name:         %.64s\n", (const char *)(header->font_name));
+	printf("Language:          %.64s\n", (const char *)(header->language));
+	printf("Palette format:    %u (%u bits per pixel, %u colors)\n", header->palette_format, header->palette_format + 1, 1u << (header->palette_format + 1));
+	printf("Character size:    %ux%u\n", header->max_font_width + 1, header->max_font_height + 1);
+	printf("Characters:        %u\n", count);
+	unsigned int glyph_count = 0;
+	if (msbtfont_get_glyph_count(header, &font.filedata, &glyph_count) == MSBTFONT_SUCCESS && (header->flags & MSBTFONT_FLAG_DEDUPLICATED))
+	{
+		printf("Deduplicated:      yes (%u unique glyphs)\n", glyph_count);
+	}
+	else
+	{
+		printf("Deduplicated:      no\n");
+	}
+	if (font.filedata.variable_table != NULL && count != 0)
+	{
+		unsigned int min_width = 256;
+		unsigned int max_width = 0;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			unsigned int width = font.filedata.variable_table[i] + 1u;
+			min_width = (width < min_width) ? width : min_width;
+			max_width = (width > max_width) ? width : max_width;
+		}
+		printf("Variable width:    yes (%u to %u pixels)\n", min_width, max_width);
+	}
+	else
+	{
+		printf("Variable width:    no\n");
+	}
+	printf("File data size:    %llu bytes\n", (unsigned long long)(font.filedata.size));
+	unsigned long long hash = 0;
+	if (msbtfont_hash_font(header, &font.filedata, &hash) == MSBTFONT_SUCCESS)
+	{
+		printf("Content hash:      %016llx\n", hash);
+	}
+	msbtfont_delete_filedata(&font.filedata);
+	return 0;
+}
+
+static int msbtfont_cli_convert(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		return 2;
+	}
+	msbtfont_cli_font font;
+	if (!msbtfont_cli_load(argv[2], &font))
+	{
+		return 1;
+	}
+	const char *palette_format_option = msbtfont_cli_option(argc, argv, 4, "--palette-format");
+	const char *mode_option = msbtfont_cli_option(argc, argv, 4, "--mode");
+	msbtfont_repack_mode mode = MSBTFONT_REPACK_SCALE;
+	if (mode_option != NULL)
+	{
+		if (strcmp(mode_option, "threshold") == 0)
+		{
+			mode = MSBTFONT_REPACK_THRESHOLD;
+		}
+		else if (strcmp(mode_option, "dither") == 0)
+		{
+			mode = MSBTFONT_REPACK_ORDERED_DITHER;
+		}
+		else if (strcmp(mode_option, "scale") != 0)
+		{
+			fprintf(stderr, "Unknown mode '%s'.\n", mode_option);
+			msbtfont_delete_filedata(&font.filedata);
+			return 1;
+		}
+	}
+	int result = 1;
+	msbtfont_retcode retcode = MSBTFONT_SUCCESS;
+	msbtfont_header repacked_header;
+	msbtfont_filedata repacked_filedata;
+	const msbtfont_header *header = &font.header;
+	const msbtfont_filedata *filedata = &font.filedata;
+	int repacked = 0;
+	if (palette_format_option != NULL && atoi(palette_format_option) != font.header.palette_format)
+	{
+		retcode = msbtfont_repack(&font.header, &font.filedata, &repacked_header, &repacked_filedata, (unsigned char)(atoi(palette_format_option)), mode);
+		if (retcode == MSBTFONT_SUCCESS)
+		{
+			header = &repacked_header;
+			filedata = &repacked_filedata;
+			repacked = 1;
+		}
+	}
+	// The header is always written normalized, which also repairs files that only carry one byte order
+	if (retcode == MSBTFONT_SUCCESS && msbtfont_cli_flag(argc, argv, 4, "--deduplicate") && !(header->flags & MSBTFONT_FLAG_DEDUPLICATED))
+	{
+		msbtfont_header deduplicated_header;
+		msbtfont_filedata deduplicated_filedata;
+		retcode = msbtfont_deduplicate(header, filedata, &deduplicated_header, &deduplicated_filedata);
+		if (retcode == MSBTFONT_SUCCESS)
+		{
+			result = msbtfont_cli_save(argv[3], &deduplicated_header, &deduplicated_filedata) ? 0 : 1;
+			if (result == 0)
+			{
+				unsigned int glyph_count = 0;
+				msbtfont_get_glyph_count(&deduplicated_header, &deduplicated_filedata, &glyph_count);
+				printf("%u characters share %u unique glyphs (%llu -> %llu bytes of file data)\n", msbtfont_cli_character_count(header), glyph_count, (unsigned long long)(filedata->size), (unsigned long long)(deduplicated_filedata.size));
+			}
+			msbtfont_delete_filedata(&deduplicated_filedata);
+		}
+	}
+	else if (retcode == MSBTFONT_SUCCESS)
+	{
+		result = msbtfont_cli_save(argv[3], header, filedata) ? 0 : 1;
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "Couldn't convert the font (error %d).\n", retcode);
+	}
+	if (repacked)
+	{
+		msbtfont_delete_filedata(&repacked_filedata);
+	}
+	msbtfont_delete_filedata(&font.filedata);
+	return result;
+}
+
+static unsigned long msbtfont_cli_crc32(unsigned long crc, const unsigned char *data, size_t size)
+{
+	crc = ~crc & 0xFFFFFFFFul;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320ul & (0ul - (crc & 1)));
+		}
+	}
+	return ~crc & 0xFFFFFFFFul;
+}
+
+static void msbtfont_cli_put32(unsigned char *data, unsigned long value)
+{
+	data[0] = (unsigned char)(value >> 24);
+	data[1] = (unsigned char)(value >> 16);
+	data[2] = (unsigned char)(value >> 8);
+	data[3] = (unsigned char)(value);
+}
+
+static int msbtfont_cli_write_chunk(FILE *output, const char *type, const unsigned char *data, size_t size)
+{
+	unsigned char length[4];
+	unsigned char crc_bytes[4];
+	msbtfont_cli_put32(length, (unsigned long)(size));
+	unsigned long crc = msbtfont_cli_crc32(0, (const unsigned char *)(type), 4);
+	crc = msbtfont_cli_crc32(crc, data, size);
+	msbtfont_cli_put32(crc_bytes, crc);
+	return fwrite(length, 1, 4, output) == 4 && fwrite(type, 1, 4, output) == 4 && (size == 0 || fwrite(data, 1, size, output) == size) && fwrite(crc_bytes, 1, 4, output) == 4;
+}
+
+// Writes an 8-bit grayscale PNG using uncompressed deflate blocks, which keeps the tool free of
+// any compression library.
+static int msbtfont_cli_write_png(const char *path, const unsigned char *pixels, unsigned int width, unsigned int height)
+{
+	size_t row_size = (size_t)(width) + 1;
+	size_t raw_size = row_size * height;
+	size_t block_count = (raw_size + 65534) / 65535;
+	size_t zlib_size = 2 + raw_size + (block_count * 5) + 4;
+	unsigned char *zlib_data = (unsigned char *)(malloc(zlib_size));
+	unsigned char *raw_data = (unsigned char *)(malloc(raw_size ? raw_size : 1));
+	if (zlib_data == NULL || raw_data == NULL)
+	{
+		free(zlib_data);
+		free(raw_data);
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		raw_data[y * row_size] = 0;
+		memcpy(&raw_data[(y * row_size) + 1], &pixels[(size_t)(y) * width], width);
+	}
+	size_t position = 0;
+	zlib_data[position++] = 0x78;
+	zlib_data[position++] = 0x01;
+	for (size_t offset = 0; offset < raw_size || (offset == 0 && raw_size == 0); offset += 65535)
+	{
+		size_t block_size = (raw_size - offset < 65535) ? raw_size - offset : 65535;
+		zlib_data[position++] = (offset + block_size >= raw_size) ? 1 : 0;
+		zlib_data[position++] = (unsigned char)(block_size);
+		zlib_data[position++] = (unsigned char)(block_size >> 8);
+		zlib_data[position++] = (unsigned char)(~block_size);
+		zlib_data[position++] = (unsigned char)((~block_size) >> 8);
+		memcpy(&zlib_data[position], &raw_data[offset], block_size);
+		position += block_size;
+		if (raw_size == 0)
+		{
+			break;
+		}
+	}
+	unsigned long a = 1;
+	unsigned long b = 0;
+	for (size_t i = 0; i < raw_size; ++i)
+	{
+		a = (a + raw_data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	msbtfont_cli_put32(&zlib_data[position], (b << 16) | a);
+	position += 4;
+	unsigned char header[13];
+	msbtfont_cli_put32(&header[0], width);
+	msbtfont_cli_put32(&header[4], height);
+	header[8] = 8; // Bit depth
+	header[9] = 0; // Grayscale
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	FILE *output = fopen(path, "wb");
+	int written = 0;
+	if (output != NULL)
+	{
+		written = fwrite(signature, 1, 8, output) == 8 && msbtfont_cli_write_chunk(output, "IHDR", header, 13) && msbtfont_cli_write_chunk(output, "IDAT", zlib_data, position) && msbtfont_cli_write_chunk(output, "IEND", NULL, 0);
+		if (fclose(output) != 0)
+		{
+			written = 0;
+		}
+	}
+	free(zlib_data);
+	free(raw_data);
+	if (!written)
+	{
+		fprintf(stderr, "Couldn't write '%s'.\n", path);
+		remove(path);
+	}
+	return written;
+}
+
+static int msbtfont_cli_bake(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		return 2;
+	}
+	const char *format_option = msbtfont_cli_option(argc, argv, 4, "--format");
+	const char *origin_option = msbtfont_cli_option(argc, argv, 4, "--origin");
+	const char *columns_option = msbtfont_cli_option(argc, argv, 4, "--columns");
+	msbtfont_surface_descriptor surface_descriptor;
+	memset(&surface_descriptor, 0, sizeof(msbtfont_surface_descriptor));
+	int bits = (format_option != NULL) ? atoi(format_option) : 8;
+	switch (bits)
+	{
+		case 8: surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_8; break;
+		case 16: surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_16_8; break;
+		case 24: surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_24_8; break;
+		case 32: surface_descriptor.format = MSBTFONT_SURFACE_FORMAT_32_8; break;
+		default:
+		{
+			fprintf(stderr, "Unsupported surface format '%s'.\n", format_option);
+			return 1;
+		}
+	}
+	surface_descriptor.origin = (origin_option != NULL && strcmp(origin_option, "lower") == 0) ? MSBTFONT_SURFACE_ORIGIN_LOWERLEFT : MSBTFONT_SURFACE_ORIGIN_UPPERLEFT;
+	unsigned int columns = (columns_option != NULL) ? (unsigned int)(atoi(columns_option)) : 16;
+	int glyphs = msbtfont_cli_flag(argc, argv, 4, "--glyphs");
+	msbtfont_cli_font font;
+	if (!msbtfont_cli_load(argv[2], &font))
+	{
+		return 1;
+	}
+	int result = 1;
+	// With '--glyphs', a deduplicated font is baked as its unique glyphs only
+	msbtfont_retcode retcode = glyphs ? msbtfont_get_glyph_surface_size(&font.header, &font.filedata, &surface_descriptor.rect, columns) : msbtfont_get_surface_size(&font.header, &surface_descriptor.rect, columns);
+	size_t surface_size = (retcode == MSBTFONT_SUCCESS) ? msbtfont_get_surface_memory_requirement(&surface_descriptor) : 0;
+	unsigned char *surface_data = (surface_size != 0) ? (unsigned char *)(calloc(surface_size, 1)) : NULL;
+	if (surface_data != NULL)
+	{
+		retcode = glyphs ? msbtfont_copy_glyphs_to_surface(&font.header, &font.filedata, columns, 0, &surface_descriptor, surface_data) : msbtfont_copy_to_surface(&font.header, &font.filedata, columns, 0, &surface_descriptor, surface_data);
+	}
+	if (retcode != MSBTFONT_SUCCESS || surface_data == NULL)
+	{
+		fprintf(stderr, "Couldn't bake the atlas (error %d).\n", (retcode != MSBTFONT_SUCCESS) ? retcode : MSBTFONT_OUT_OF_MEMORY);
+	}
+	else
+	{
+		size_t path_length = strlen(argv[3]);
+		if (path_length >= 4 && strcmp(&argv[3][path_length - 4], ".png") == 0)
+		{
+			// PNG output is a viewable grayscale image: palette indices are scaled to 0-255
+			unsigned int width = surface_descriptor.rect.width;
+			unsigned int height = surface_descriptor.rect.height;
+			size_t pixel_size = (size_t)(bits / 8);
+			size_t pitch = (((size_t)(width) * pixel_size) + 3) & ~(size_t)(3);
+			unsigned int max_index = (1u << (font.header.palette_format + 1)) - 1;
+			unsigned char *pixels = (unsigned char *)(malloc(((size_t)(width) * height != 0) ? (size_t)(width) * height : 1));
+			if (pixels != NULL)
+			{
+				for (unsigned int y = 0; y < height; ++y)
+				{
+					for (unsigned int x = 0; x < width; ++x)
+					{
+						pixels[((size_t)(y) * width) + x] = (unsigned char)((surface_data[((size_t)(y) * pitch) + ((size_t)(x) * pixel_size)] * 255u) / max_index);
+					}
+				}
+				result = msbtfont_cli_write_png(argv[3], pixels, width, height) ? 0 : 1;
+				free(pixels);
+			}
+			else
+			{
+				fprintf(stderr, "Out of memory.\n");
+			}
+		}
+		else
+		{
+			FILE *output = fopen(argv[3], "wb");
+			if (output != NULL && fwrite(surface_data, 1, surface_size, output) == surface_size && fclose(output) == 0)
+			{
+				result = 0;
+			}
+			else
+			{
+				fprintf(stderr, "Couldn't write '%s'.\n", argv[3]);
+			}
+		}
+		if (result == 0)
+		{
+			printf("%ux%u %d-bit surface (%s origin), %u %s per row\n", surface_descriptor.rect.width, surface_descriptor.rect.height, bits, (surface_descriptor.origin == MSBTFONT_SURFACE_ORIGIN_LOWERLEFT) ? "lower left" : "upper left", columns, glyphs ? "glyphs" : "characters");
+		}
+	}
+	free(surface_data);
+	msbtfont_delete_filedata(&font.filedata);
+	return result;
+}
+
+static void msbtfont_cli_report(const char *name, double seconds, unsigned long long iterations, unsigned long long items_per_iteration, const char *items)
+{
+	double per_iteration = (seconds * 1e6) / (double)(iterations);
+	double per_second = ((double)(items_per_iteration) * (double)(iterations)) / ((seconds > 0.0) ? seconds : 1e-9);
+	printf("%-34s %12.2f us %16.0f %s/s\n", name, per_iteration, per_second, items);
+}
+
+static int msbtfont_cli_bench(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		return 2;
+	}
+	const char *min_time_option = msbtfont_cli_option(argc, argv, 3, "--min-time");
+	double min_time = ((min_time_option != NULL) ? atof(min_time_option) : 200.0) / 1000.0;
+	msbtfont_cli_font font;
+	if (!msbtfont_cli_load(argv[2], &font))
+	{
+		return 1;
+	}
+	unsigned int count = msbtfont_cli_character_count(&font.header);
+	unsigned long long character_bits = (unsigned long long)(font.header.palette_format + 1) * (font.header.max_font_width + 1) * (font.header.max_font_height + 1);
+	unsigned char *character = (unsigned char *)(malloc((size_t)((character_bits + 7) / 8) + 1));
+	if (character == NULL || count == 0)
+	{
+		free(character);
+		msbtfont_delete_filedata(&font.filedata);
+		return 1;
+	}
+	unsigned long long iterations = 0;
+	double start = msbtfont_cli_now();
+	double elapsed = 0.0;
+	do
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			msbtfont_load_font_character_data(&font.header, &font.filedata, character, i);
+		}
+		++iterations;
+		elapsed = msbtfont_cli_now() - start;
+	}
+	while (elapsed < min_time);
+	msbtfont_cli_report("load_font_character_data (all)", elapsed, iterations, count, "characters");
+	free(character);
+	static const msbtfont_surface_format formats[4] = { MSBTFONT_SURFACE_FORMAT_8, MSBTFONT_SURFACE_FORMAT_16_8, MSBTFONT_SURFACE_FORMAT_24_8, MSBTFONT_SURFACE_FORMAT_32_8 };
+	static const char *format_names[4] = { "8", "16_8", "24_8", "32_8" };
+	for (int format = 0; format < 4; ++format)
+	{
+		for (int origin = 0; origin < 2; ++origin)
+		{
+			msbtfont_surface_descriptor surface_descriptor;
+			memset(&surface_descriptor, 0, sizeof(msbtfont_surface_descriptor));
+			surface_descriptor.format = formats[format];
+			surface_descriptor.origin = origin ? MSBTFONT_SURFACE_ORIGIN_LOWERLEFT : MSBTFONT_SURFACE_ORIGIN_UPPERLEFT;
+			if (msbtfont_get_surface_size(&font.header, &surface_descriptor.rect, 64) != MSBTFONT_SUCCESS)
+			{
+				continue;
+			}
+			size_t surface_size = msbtfont_get_surface_memory_requirement(&surface_descriptor);
+			unsigned char *surface_data = (surface_size != 0) ? (unsigned char *)(malloc(surface_size)) : NULL;
+			if (surface_data == NULL)
+			{
+				continue;
+			}
+			char name[64];
+			snprintf(name, sizeof(name), "copy_to_surface %s %s", format_names[format], origin ? "lowerleft" : "upperleft");
+			iterations = 0;
+			start = msbtfont_cli_now();
+			do
+			{
+				msbtfont_copy_to_surface(&font.header, &font.filedata, 64, 0, &surface_descriptor, surface_data);
+				++iterations;
+				elapsed = msbtfont_cli_now() - start;
+			}
+			while (elapsed < min_time);
+			msbtfont_cli_report(name, elapsed, iterations, count, "characters");
+			free(surface_data);
+		}
+	}
+	// Deduplicated fonts can't be repacked, so there's nothing to time for them
+	for (unsigned char palette_format = 0; palette_format < 8 && !(font.header.flags & MSBTFONT_FLAG_DEDUPLICATED); ++palette_format)
+	{
+		if (palette_format == font.header.palette_format)
+		{
+			continue;
+		}
+		char name[64];
+		snprintf(name, sizeof(name), "repack %u -> %u (scale)", font.header.palette_format, palette_format);
+		iterations = 0;
+		start = msbtfont_cli_now();
+		do
+		{
+			msbtfont_header header;
+			msbtfont_filedata filedata;
+			if (msbtfont_repack(&font.header, &font.filedata, &header, &filedata, palette_format, MSBTFONT_REPACK_SCALE) == MSBTFONT_SUCCESS)
+			{
+				msbtfont_delete_filedata(&filedata);
+			}
+			++iterations;
+			elapsed = msbtfont_cli_now() - start;
+		}
+		while (elapsed < min_time);
+		msbtfont_cli_report(name, elapsed, iterations, count, "characters");
+	}
+	msbtfont_delete_filedata(&font.filedata);
+	return 0;
+}
+
+static int msbtfont_cli_diff(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		return 2;
+	}
+	msbtfont_cli_font old_font;
+	msbtfont_cli_font new_font;
+	if (!msbtfont_cli_load(argv[2], &old_font))
+	{
+		return 1;
+	}
+	if (!msbtfont_cli_load(argv[3], &new_font))
+	{
+		msbtfont_delete_filedata(&old_font.filedata);
+		return 1;
+	}
+	unsigned int changed_count = 0;
+	msbtfont_retcode retcode = msbtfont_diff_fonts(&old_font.header, &old_font.filedata, &new_font.header, &new_font.filedata, NULL, 0, &changed_count);
+	unsigned int *changed_indices = NULL;
+	if (retcode == MSBTFONT_SUCCESS && changed_count != 0)
+	{
+		changed_indices = (unsigned int *)(malloc((size_t)(changed_count) * sizeof(unsigned int)));
+		retcode = (changed_indices != NULL) ? msbtfont_diff_fonts(&old_font.header, &old_font.filedata, &new_font.header, &new_font.filedata, changed_indices, changed_count, &changed_count) : MSBTFONT_OUT_OF_MEMORY;
+	}
+	int result = 1;
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		// Consecutive indices are printed as ranges to keep the output short
+		printf("%u characters changed\n", changed_count);
+		for (unsigned int i = 0; i < changed_count;)
+		{
+			unsigned int last = i;
+			while (last + 1 < changed_count && changed_indices[last + 1] == changed_indices[last] + 1)
+			{
+				++last;
+			}
+			if (last == i)
+			{
+				printf("  %u\n", changed_indices[i]);
+			}
+			else
+			{
+				printf("  %u-%u\n", changed_indices[i], changed_indices[last]);
+			}
+			i = last + 1;
+		}
+		result = 0;
+	}
+	else
+	{
+		fprintf(stderr, "Couldn't compare the fonts (error %d).\n", retcode);
+	}
+	free(changed_indices);
+	msbtfont_delete_filedata(&old_font.filedata);
+	msbtfont_delete_filedata(&new_font.filedata);
+	return result;
+}
+
+static int msbtfont_cli_import(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		return 2;
+	}
+	const char *first_option = msbtfont_cli_option(argc, argv, 4, "--first");
+	const char *last_option = msbtfont_cli_option(argc, argv, 4, "--last");
+	const char *threads_option = msbtfont_cli_option(argc, argv, 4, "--threads");
+	msbtfont_import_descriptor descriptor;
+	descriptor.first_code = (first_option != NULL) ? (unsigned int)(strtoul(first_option, NULL, 0)) : 0;
+	descriptor.last_code = (last_option != NULL) ? (unsigned int)(strtoul(last_option, NULL, 0)) : UINT_MAX;
+	descriptor.thread_count = (threads_option != NULL) ? (unsigned int)(atoi(threads_option)) : 0;
+	msbtfont_header header;
+	msbtfont_filedata filedata;
+	unsigned int glyph_count = 0;
+	double start = msbtfont_cli_now();
+	if (!msbtfont_import_font(argv[2], &descriptor, &header, &filedata, &glyph_count))
+	{
+		return 1;
+	}
+	double elapsed = msbtfont_cli_now() - start;
+	int result = msbtfont_cli_save(argv[3], &header, &filedata) ? 0 : 1;
+	if (result == 0)
+	{
+		printf("%u glyphs imported as %u %ux%u characters%s in %.1f ms\n", glyph_count, msbtfont_cli_character_count(&header), header.max_font_width + 1, header.max_font_height + 1, (header.flags & 0x01) ? " (variable width)" : "", elapsed * 1000.0);
+	}
+	msbtfont_delete_filedata(&filedata);
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	int result = 2;
+	if (argc >= 2)
+	{
+		if (strcmp(argv[1], "info") == 0)
+		{
+			result = msbtfont_cli_info(argc, argv);
+		}
+		else if (strcmp(argv[1], "convert") == 0)
+		{
+			result = msbtfont_cli_convert(argc, argv);
+		}
+		else if (strcmp(argv[1], "bake") == 0)
+		{
+			result = msbtfont_cli_bake(argc, argv);
+		}
+		else if (strcmp(argv[1], "bench") == 0)
+		{
+			result = msbtfont_cli_bench(argc, argv);
+		}
+		else if (strcmp(argv[1], "diff") == 0)
+		{
+			result = msbtfont_cli_diff(argc, argv);
+		}
+		else if (strcmp(argv[1], "import") == 0)
+		{
+			result = msbtfont_cli_import(argc, argv);
+		}
+	}
+	if (result == 2)
+	{
+		fprintf(stderr, "Usage:\n");
+		fprintf(stderr, "  %s info <font.msbt>\n", argv[0]);
+		fprintf(stderr, "  %s convert <input.msbt> <output.msbt> [--palette-format <0-7>] [--mode threshold|scale|dither] [--deduplicate]\n", argv[0]);
+		fprintf(stderr, "  %s bake <font.msbt> <output.png|output.raw> [--format 8|16|24|32] [--origin upper|lower] [--columns <count>] [--glyphs]\n", argv[0]);
+		fprintf(stderr, "  %s bench <font.msbt> [--min-time <ms>]\n", argv[0]);
+		fprintf(stderr, "  %s diff <old.msbt> <new.msbt>\n", argv[0]);
+		fprintf(stderr, "  %s import <font.bdf|font.pcf|font.psf> <output.msbt> [--first <code>] [--last <code>] [--threads <count>]\n", argv[0]);
+	}
+	return result;
+}
@@ -0,0 +1,249 @@
+/* MisbitFont Embedding Tool
+ *
+ * Turns a MisbitFont file (a 'msbtfont_header' followed by the file data) into a header file
+ * holding the font as static read-only data, so it can be compiled into a program with no
+ * loading or parsing at startup.  The font is checked with the library before anything is
+ * written.  The generated header defines:
+ *
+ *   <name>_data      The file data (variable table if used, glyph table if deduplicated, then font data)
+ *   <name>_header    A ready to use 'msbtfont_header' (valid on both little and big endian targets)
+ *   <name>_filedata  A 'msbtfont_filedata' referring to <name>_data; Must never be written to or deleted
+ *   <name>_embedded  A constexpr 'msbtfont::embedded_font' (C++17 and later only)
+ *
+ * Usage:  msbtfont_embed <input.msbt> <output.h> <name>
+ *
+ */
+
+#include "../include/msbtfont.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int msbtfont_embed_little_endian_host(void)
+{
+	const unsigned int value = 1;
+	unsigned char first_byte = 0;
+	memcpy(&first_byte, &value, 1);
+	return first_byte == 1;
+}
+
+static unsigned int msbtfont_embed_swap32(unsigned int value)
+{
+	return ((value >> 24) | ((value & 0xFF0000) >> 8) | ((value & 0xFF00) << 8) | (value << 24));
+}
+
+static unsigned short msbtfont_embed_swap16(unsigned short value)
+{
+	return (unsigned short)((value >> 8) | (value << 8));
+}
+
+static int msbtfont_embed_valid_name(const char *name)
+{
+	if (name[0] == '\0' || isdigit((unsigned char)(name[0])))
+	{
+		return 0;
+	}
+	for (const char *c = name; *c != '\0'; ++c)
+	{
+		if (!isalnum((unsigned char)(*c)) && *c != '_')
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void msbtfont_embed_write_bytes(FILE *output, const unsigned char *bytes, size_t size, const char *indent)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (i % 16 == 0)
+		{
+			fprintf(output, "%s%s", (i != 0) ? "\n" : "", indent);
+		}
+		fprintf(output, "0x%02X%s", bytes[i], (i + 1 == size) ? "" : ((i % 16 == 15) ? "," : ", "));
+	}
+}
+
+static int msbtfont_embed_write(FILE *output, const char *input_path, const char *name, const msbtfont_header *header, const msbtfont_filedata *filedata)
+{
+	int little_endian = msbtfont_embed_little_endian_host();
+	unsigned int magicword = little_endian ? header->magicword_le : header->magicword_be;
+	unsigned short major = little_endian ? header->version_le.major : header->version_be.major;
+	unsigned short minor = little_endian ? header->version_le.minor : header->version_be.minor;
+	unsigned int font_character_count = little_endian ? header->font_character_count_le : header->font_character_count_be;
+	size_t variable_table_size = (filedata->variable_table != NULL) ? font_character_count : 0;
+	size_t glyph_table_size = (filedata->glyph_table != NULL) ? ((size_t)(font_character_count) + 1) * 4 : 0;
+	char guard[256];
+	size_t guard_length = 0;
+	for (const char *c = name; *c != '\0' && guard_length < sizeof(guard) - 32; ++c)
+	{
+		guard[guard_length++] = (char)(toupper((unsigned char)(*c)));
+	}
+	guard[guard_length] = '\0';
+	fprintf(output, "/* Generated by msbtfont_embed from '%s'.  Do not edit. */\n\n", input_path);
+	fprintf(output, "#ifndef _%s_MSBTFONT_EMBEDDED_H_\n#define _%s_MSBTFONT_EMBEDDED_H_\n\n", guard, guard);
+	fprintf(output, "#if defined(__cplusplus) && (__cplusplus >= 201703L)\n#include <msbtfont.hpp>\n#define %s_STORAGE static constexpr\n#else\n#include <msbtfont.h>\n#define %s_STORAGE static const\n#endif\n\n", guard, guard);
+	// The library reads the copy of each multi-byte field matching the host, so emit both copies in
+	// the layout expected by whichever byte order the including program is compiled for.
+	fprintf(output, "#if defined(MSBTFONT_BIG_ENDIAN) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))\n#define %s_LE(value, swapped) (swapped)\n#define %s_BE(value, swapped) (value)\n#else\n#define %s_LE(value, swapped) (value)\n#define %s_BE(value, swapped) (swapped)\n#endif\n\n", guard, guard, guard, guard);
+	fprintf(output, "%s_STORAGE unsigned char %s_data[%llu] =\n{\n", guard, name, (unsigned long long)(filedata->size ? filedata->size : 1));
+	if (filedata->size != 0)
+	{
+		msbtfont_embed_write_bytes(output, filedata->data, filedata->size, "\t");
+	}
+	else
+	{
+		fprintf(output, "\t0x00");
+	}
+	fprintf(output, "\n};\n\n");
+	fprintf(output, "static const msbtfont_header %s_header =\n{\n", name);
+	fprintf(output, "\t%s_LE(0x%08Xu, 0x%08Xu),\n", guard, magicword, msbtfont_embed_swap32(magicword));
+	fprintf(output, "\t{ %s_LE(%u, %u), %s_LE(%u, %u) },\n", guard, major, msbtfont_embed_swap16(major), guard, minor, msbtfont_embed_swap16(minor));
+	fprintf(output, "\t%s_BE(0x%08Xu, 0x%08Xu),\n", guard, magicword, msbtfont_embed_swap32(magicword));
+	fprintf(output, "\t{ %s_BE(%u, %u), %s_BE(%u, %u) },\n", guard, major, msbtfont_embed_swap16(major), guard, minor, msbtfont_embed_swap16(minor));
+	fprintf(output, "\t%u, %u, %u, %u,\n", header->palette_format, header->max_font_width, header->max_font_height, header->flags);
+	fprintf(output, "\t%s_LE(%uu, %uu),\n", guard, font_character_count, msbtfont_embed_swap32(font_character_count));
+	fprintf(output, "\t%s_BE(%uu, %uu),\n", guard, font_character_count, msbtfont_embed_swap32(font_character_count));
+	fprintf(output, "\t{\n");
+	msbtfont_embed_write_bytes(output, header->font_name, sizeof(header->font_name), "\t\t");
+	fprintf(output, "\n\t},\n\t{\n");
+	msbtfont_embed_write_bytes(output, header->language, sizeof(header->language), "\t\t");
+	fprintf(output, "\n\t}\n};\n\n");
+	fprintf(output, "static const msbtfont_filedata %s_filedata =\n{\n", name);
+	fprintf(output, "\t(unsigned char *)(%s_data),\n", name);
+	if (variable_table_size != 0)
+	{
+		fprintf(output, "\t(unsigned char *)(%s_data),\n", name);
+	}
+	else
+	{
+		fprintf(output, "\tNULL,\n");
+	}
+	fprintf(output, "\t(unsigned char *)(&%s_data[%llu]),\n", name, (unsigned long long)(variable_table_size + glyph_table_size));
+	fprintf(output, "\t%llu,\n\t{ NULL, NULL, NULL, NULL },\n", (unsigned long long)(filedata->size));
+	if (glyph_table_size != 0)
+	{
+		fprintf(output, "\t(unsigned char *)(&%s_data[%llu]),\n", name, (unsigned long long)(variable_table_size));
+	}
+	else
+	{
+		fprintf(output, "\tNULL,\n");
+	}
+	fprintf(output, "\tNULL,\n\t0\n};\n\n");
+	fprintf(output, "#if defined(__cplusplus) && (__cplusplus >= 201703L)\n");
+	fprintf(output, "static constexpr msbtfont::embedded_font %s_embedded { %uu, %uu, %uu, %uu, ", name, font_character_count, header->max_font_width + 1u, header->max_font_height + 1u, header->palette_format + 1u);
+	if (variable_table_size != 0)
+	{
+		fprintf(output, "%s_data, ", name);
+	}
+	else
+	{
+		fprintf(output, "nullptr, ");
+	}
+	fprintf(output, "&%s_data[%llu], ", name, (unsigned long long)(variable_table_size + glyph_table_size));
+	if (glyph_table_size != 0)
+	{
+		fprintf(output, "&%s_data[%llu] };\n", name, (unsigned long long)(variable_table_size));
+	}
+	else
+	{
+		fprintf(output, "nullptr };\n");
+	}
+	fprintf(output, "#endif\n\n#undef %s_LE\n#undef %s_BE\n#undef %s_STORAGE\n\n#endif\n", guard, guard, guard);
+	return ferror(output) ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage:  %s <input.msbt> <output.h> <name>\n", argv[0]);
+		return 1;
+	}
+	const char *input_path = argv[1];
+	const char *output_path = argv[2];
+	const char *name = argv[3];
+	if (!msbtfont_embed_valid_name(name))
+	{
+		fprintf(stderr, "'%s' is not a valid C identifier.\n", name);
+		return 1;
+	}
+	FILE *input = fopen(input_path, "rb");
+	if (input == NULL)
+	{
+		fprintf(stderr, "Couldn't open '%s'.\n", input_path);
+		return 1;
+	}
+	msbtfont_header header;
+	size_t size = 0;
+	if (fread(&header, sizeof(msbtfont_header), 1, input) != 1)
+	{
+		fprintf(stderr, "'%s' is too small to be a MisbitFont file.\n", input_path);
+		fclose(input);
+		return 1;
+	}
+	msbtfont_retcode retcode = msbtfont_normalize_header(&header);
+	if (retcode == MSBTFONT_SUCCESS && !(header.flags & MSBTFONT_FLAG_DEDUPLICATED))
+	{
+		retcode = msbtfont_get_filedata_size(&header, &size);
+	}
+	else if (retcode == MSBTFONT_SUCCESS)
+	{
+		// The size of a deduplicated font depends on its glyph table, so take the rest of the file
+		long start = ftell(input);
+		if (start < 0 || fseek(input, 0, SEEK_END) != 0 || ftell(input) < start)
+		{
+			retcode = MSBTFONT_INVALID_FILEDATA;
+		}
+		else
+		{
+			size = (size_t)(ftell(input) - start);
+			fseek(input, start, SEEK_SET);
+		}
+	}
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "'%s' has an invalid header (error %d).\n", input_path, retcode);
+		fclose(input);
+		return 1;
+	}
+	unsigned char *data = (unsigned char *)(malloc(size ? size : 1));
+	if (data == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		fclose(input);
+		return 1;
+	}
+	size_t read_size = fread(data, 1, size, input);
+	fclose(input);
+	msbtfont_filedata filedata;
+	retcode = msbtfont_adopt_filedata(&header, &filedata, data, read_size, NULL);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "'%s' is truncated or invalid (error %d).\n", input_path, retcode);
+		free(data);
+		return 1;
+	}
+	FILE *output = fopen(output_path, "w");
+	if (output == NULL)
+	{
+		fprintf(stderr, "Couldn't create '%s'.\n", output_path);
+		free(data);
+		return 1;
+	}
+	int written = msbtfont_embed_write(output, input_path, name, &header, &filedata);
+	if (fclose(output) != 0)
+	{
+		written = 0;
+	}
+	free(data);
+	if (!written)
+	{
+		fprintf(stderr, "Couldn't write '%s'.\n", output_path);
+		remove(output_path);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,918 @@
+/* MisbitFont Importers
+ *
+ * See 'msbtfont_import.h'.
+ *
+ */
+
+#include "msbtfont_import.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MSBTFONT_IMPORT_BATCH_SIZE 4096 // Characters packed per batch; Must be a multiple of 8 so batches never share a byte
+#define MSBTFONT_IMPORT_NO_GLYPH UINT_MAX
+
+#define MSBTFONT_PCF_PROPERTIES 0x01
+#define MSBTFONT_PCF_ACCELERATORS 0x02
+#define MSBTFONT_PCF_METRICS 0x04
+#define MSBTFONT_PCF_BITMAPS 0x08
+#define MSBTFONT_PCF_BDF_ENCODINGS 0x20
+#define MSBTFONT_PCF_BDF_ACCELERATORS 0x100
+#define MSBTFONT_PCF_COMPRESSED_METRICS 0x100
+#define MSBTFONT_PCF_BYTE_MASK 0x04 // Set = Most significant byte first
+#define MSBTFONT_PCF_BIT_MASK 0x08 // Set = Most significant bit first
+
+typedef struct msbtfont_import_glyph
+{
+	unsigned int code;
+	int left; // Left edge of the bitmap relative to the origin
+	int top; // Top edge of the bitmap above the baseline
+	unsigned int width;
+	unsigned int height;
+	int advance;
+	size_t bitmap_offset; // Rows of (width + 7) / 8 bytes, most significant bit first
+} msbtfont_import_glyph;
+
+typedef struct msbtfont_import_source
+{
+	msbtfont_import_glyph *glyphs;
+	size_t glyph_count;
+	size_t glyph_capacity;
+	unsigned char *bitmaps;
+	size_t bitmap_size;
+	size_t bitmap_capacity;
+	unsigned int first_code;
+	unsigned int last_code;
+	int ascent; // Font-wide ascent and descent (if the format has them), so the baseline stays put
+	int descent;
+	char name[64];
+} msbtfont_import_source;
+
+// Returns the zeroed bitmap of the new glyph (valid until the next glyph is added), 'skipped' for
+// glyphs outside the requested range, or NULL when out of memory.
+static unsigned char msbtfont_import_skipped[1];
+
+static unsigned char *msbtfont_import_add_glyph(msbtfont_import_source *font, const msbtfont_import_glyph *glyph)
+{
+	if (glyph->code < font->first_code || glyph->code > font->last_code)
+	{
+		return msbtfont_import_skipped;
+	}
+	size_t bitmap_size = (size_t)((glyph->width + 7) / 8) * glyph->height;
+	if (font->glyph_count == font->glyph_capacity)
+	{
+		size_t capacity = font->glyph_capacity ? font->glyph_capacity * 2 : 256;
+		msbtfont_import_glyph *glyphs = (msbtfont_import_glyph *)(realloc(font->glyphs, capacity * sizeof(msbtfont_import_glyph)));
+		if (glyphs == NULL)
+		{
+			return NULL;
+		}
+		font->glyphs = glyphs;
+		font->glyph_capacity = capacity;
+	}
+	if (font->bitmap_capacity - font->bitmap_size < bitmap_size + 1)
+	{
+		size_t capacity = font->bitmap_capacity ? font->bitmap_capacity : 4096;
+		while (capacity - font->bitmap_size < bitmap_size + 1)
+		{
+			capacity *= 2;
+		}
+		unsigned char *bitmaps = (unsigned char *)(realloc(font->bitmaps, capacity));
+		if (bitmaps == NULL)
+		{
+			return NULL;
+		}
+		font->bitmaps = bitmaps;
+		font->bitmap_capacity = capacity;
+	}
+	msbtfont_import_glyph *new_glyph = &font->glyphs[font->glyph_count++];
+	*new_glyph = *glyph;
+	new_glyph->bitmap_offset = font->bitmap_size;
+	font->bitmap_size += bitmap_size;
+	memset(&font->bitmaps[new_glyph->bitmap_offset], 0, bitmap_size);
+	return &font->bitmaps[new_glyph->bitmap_offset];
+}
+
+static void msbtfont_import_set_name(msbtfont_import_source *font, const char *name, size_t length)
+{
+	if (length >= sizeof(font->name))
+	{
+		length = sizeof(font->name) - 1;
+	}
+	memcpy(font->name, name, length);
+	font->name[length] = '\0';
+}
+
+// Matches a BDF keyword at the start of a line, returning what follows it
+static const char *msbtfont_import_keyword(const char *line, const char *keyword)
+{
+	size_t length = strlen(keyword);
+	if (strncmp(line, keyword, length) != 0 || (line[length] != ' ' && line[length] != '\t' && line[length] != '\r' && line[length] != '\n' && line[length] != '\0'))
+	{
+		return NULL;
+	}
+	return &line[length];
+}
+
+static int msbtfont_import_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+static int msbtfont_import_read_line(FILE *input, char *line, size_t size)
+{
+	if (fgets(line, (int)(size), input) == NULL)
+	{
+		return 0;
+	}
+	// Property lines can be longer than any line the importer cares about, so drop the rest
+	if (strchr(line, '\n') == NULL)
+	{
+		int c;
+		while ((c = fgetc(input)) != EOF && c != '\n')
+		{
+		}
+	}
+	return 1;
+}
+
+static int msbtfont_import_bdf(FILE *input, msbtfont_import_source *font)
+{
+	char line[1024];
+	int bounding_box[4] = { 0, 0, 0, 0 };
+	int default_advance = 0;
+	int in_character = 0;
+	long long code = -1;
+	msbtfont_import_glyph glyph;
+	memset(&glyph, 0, sizeof(msbtfont_import_glyph));
+	while (msbtfont_import_read_line(input, line, sizeof(line)))
+	{
+		const char *arguments = NULL;
+		if ((arguments = msbtfont_import_keyword(line, "FONTBOUNDINGBOX")) != NULL)
+		{
+			sscanf(arguments, "%d %d %d %d", &bounding_box[0], &bounding_box[1], &bounding_box[2], &bounding_box[3]);
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "FONT_ASCENT")) != NULL)
+		{
+			sscanf(arguments, "%d", &font->ascent);
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "FONT_DESCENT")) != NULL)
+		{
+			sscanf(arguments, "%d", &font->descent);
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "FAMILY_NAME")) != NULL)
+		{
+			const char *start = strchr(arguments, '"');
+			const char *end = (start != NULL) ? strchr(start + 1, '"') : NULL;
+			if (end != NULL)
+			{
+				msbtfont_import_set_name(font, start + 1, (size_t)(end - start - 1));
+			}
+		}
+		else if (msbtfont_import_keyword(line, "STARTCHAR") != NULL)
+		{
+			in_character = 1;
+			code = -1;
+			glyph.width = (bounding_box[0] > 0) ? (unsigned int)(bounding_box[0]) : 0;
+			glyph.height = (bounding_box[1] > 0) ? (unsigned int)(bounding_box[1]) : 0;
+			glyph.left = bounding_box[2];
+			glyph.top = bounding_box[3] + bounding_box[1];
+			glyph.advance = default_advance ? default_advance : bounding_box[0];
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "ENCODING")) != NULL)
+		{
+			// Glyphs outside the standard encoding ('-1 <code>') use their alternate code if given
+			long long values[2] = { -1, -1 };
+			int value_count = sscanf(arguments, "%lld %lld", &values[0], &values[1]);
+			code = (values[0] >= 0) ? values[0] : ((value_count == 2) ? values[1] : -1);
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "DWIDTH")) != NULL)
+		{
+			sscanf(arguments, "%d", in_character ? &glyph.advance : &default_advance);
+		}
+		else if ((arguments = msbtfont_import_keyword(line, "BBX")) != NULL)
+		{
+			int values[4] = { 0, 0, 0, 0 };
+			sscanf(arguments, "%d %d %d %d", &values[0], &values[1], &values[2], &values[3]);
+			glyph.width = (values[0] > 0) ? (unsigned int)(values[0]) : 0;
+			glyph.height = (values[1] > 0) ? (unsigned int)(values[1]) : 0;
+			glyph.left = values[2];
+			glyph.top = values[3] + values[1];
+		}
+		else if (msbtfont_import_keyword(line, "BITMAP") != NULL && in_character)
+		{
+			unsigned char *bitmap = msbtfont_import_skipped;
+			if (code >= 0 && code <= (long long)(UINT_MAX))
+			{
+				glyph.code = (unsigned int)(code);
+				bitmap = msbtfont_import_add_glyph(font, &glyph);
+				if (bitmap == NULL)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					return 0;
+				}
+			}
+			size_t pitch = (glyph.width + 7) / 8;
+			for (unsigned int y = 0; y < glyph.height; ++y)
+			{
+				if (!msbtfont_import_read_line(input, line, sizeof(line)))
+				{
+					fprintf(stderr, "Unexpected end of the BDF file.\n");
+					return 0;
+				}
+				if (bitmap == msbtfont_import_skipped)
+				{
+					continue;
+				}
+				const char *c = line;
+				for (size_t x = 0; x < pitch; ++x)
+				{
+					int high = msbtfont_import_hex_digit(c[0]);
+					int low = (high >= 0) ? msbtfont_import_hex_digit(c[1]) : -1;
+					if (high < 0 || low < 0)
+					{
+						break;
+					}
+					bitmap[(y * pitch) + x] = (unsigned char)((high << 4) | low);
+					c += 2;
+				}
+			}
+			in_character = 0;
+		}
+		else if (msbtfont_import_keyword(line, "ENDCHAR") != NULL)
+		{
+			in_character = 0;
+		}
+	}
+	return 1;
+}
+
+static unsigned int msbtfont_import_le32(const unsigned char *data)
+{
+	return (unsigned int)(data[0]) | ((unsigned int)(data[1]) << 8) | ((unsigned int)(data[2]) << 16) | ((unsigned int)(data[3]) << 24);
+}
+
+static int msbtfont_import_psf(FILE *input, const unsigned char *magic, msbtfont_import_source *font)
+{
+	unsigned int glyph_count = 0;
+	unsigned int width = 8;
+	unsigned int height = 0;
+	size_t character_size = 0;
+	if (magic[0] == 0x36)
+	{
+		unsigned char psf1_header[4];
+		if (fread(psf1_header, 4, 1, input) != 1)
+		{
+			fprintf(stderr, "Unexpected end of the PSF file.\n");
+			return 0;
+		}
+		glyph_count = (psf1_header[2] & 0x01) ? 512 : 256;
+		height = psf1_header[3];
+		character_size = height;
+	}
+	else
+	{
+		unsigned char psf2_header[32];
+		if (fread(psf2_header, 32, 1, input) != 1)
+		{
+			fprintf(stderr, "Unexpected end of the PSF file.\n");
+			return 0;
+		}
+		glyph_count = msbtfont_import_le32(&psf2_header[16]);
+		character_size = msbtfont_import_le32(&psf2_header[20]);
+		height = msbtfont_import_le32(&psf2_header[24]);
+		width = msbtfont_import_le32(&psf2_header[28]);
+		if (width == 0 || width > 256 || height > 256 || character_size < (size_t)((width + 7) / 8) * height || fseek(input, (long)(msbtfont_import_le32(&psf2_header[8])), SEEK_SET) != 0)
+		{
+			fprintf(stderr, "Invalid PSF header.\n");
+			return 0;
+		}
+	}
+	font->ascent = (int)(height);
+	unsigned char *character = (unsigned char *)(malloc(character_size ? character_size : 1));
+	if (character == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	msbtfont_import_glyph glyph;
+	memset(&glyph, 0, sizeof(msbtfont_import_glyph));
+	glyph.width = width;
+	glyph.height = height;
+	glyph.top = (int)(height);
+	glyph.advance = (int)(width);
+	int result = 1;
+	for (unsigned int i = 0; i < glyph_count; ++i)
+	{
+		if (fread(character, 1, character_size, input) != character_size)
+		{
+			fprintf(stderr, "Unexpected end of the PSF file.\n");
+			result = 0;
+			break;
+		}
+		glyph.code = i;
+		unsigned char *bitmap = msbtfont_import_add_glyph(font, &glyph);
+		if (bitmap == NULL)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			result = 0;
+			break;
+		}
+		if (bitmap != msbtfont_import_skipped)
+		{
+			memcpy(bitmap, character, (size_t)((width + 7) / 8) * height);
+		}
+	}
+	free(character);
+	return result;
+}
+
+typedef struct msbtfont_import_pcf_table
+{
+	unsigned int type;
+	unsigned int format;
+	unsigned int size;
+	unsigned int offset;
+} msbtfont_import_pcf_table;
+
+typedef struct msbtfont_import_pcf_reader
+{
+	unsigned char *data;
+	size_t size;
+	size_t position;
+	unsigned int format;
+	int failed;
+} msbtfont_import_pcf_reader;
+
+static unsigned int msbtfont_import_pcf_read(msbtfont_import_pcf_reader *reader, size_t size)
+{
+	if (reader->failed || reader->size - reader->position < size)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+	unsigned int value = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		unsigned int byte = reader->data[reader->position + ((reader->format & MSBTFONT_PCF_BYTE_MASK) ? i : size - 1 - i)];
+		value = (value << 8) | byte;
+	}
+	reader->position += size;
+	return value;
+}
+
+// Reads a table and its format (which is always stored least significant byte first)
+static int msbtfont_import_pcf_open(FILE *input, const msbtfont_import_pcf_table *tables, unsigned int table_count, unsigned int type, msbtfont_import_pcf_reader *reader)
+{
+	memset(reader, 0, sizeof(msbtfont_import_pcf_reader));
+	for (unsigned int i = 0; i < table_count; ++i)
+	{
+		if (tables[i].type == type && tables[i].size >= 4)
+		{
+			reader->data = (unsigned char *)(malloc(tables[i].size));
+			if (reader->data == NULL || fseek(input, (long)(tables[i].offset), SEEK_SET) != 0 || fread(reader->data, 1, tables[i].size, input) != tables[i].size)
+			{
+				free(reader->data);
+				reader->data = NULL;
+				return 0;
+			}
+			reader->size = tables[i].size;
+			reader->format = msbtfont_import_le32(reader->data);
+			reader->position = 4;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int msbtfont_import_pcf(FILE *input, msbtfont_import_source *font)
+{
+	unsigned char file_header[8];
+	if (fread(file_header, 8, 1, input) != 1)
+	{
+		fprintf(stderr, "Unexpected end of the PCF file.\n");
+		return 0;
+	}
+	unsigned int table_count = msbtfont_import_le32(&file_header[4]);
+	if (table_count == 0 || table_count > 64)
+	{
+		fprintf(stderr, "Invalid PCF table of contents.\n");
+		return 0;
+	}
+	msbtfont_import_pcf_table tables[64];
+	for (unsigned int i = 0; i < table_count; ++i)
+	{
+		unsigned char entry[16];
+		if (fread(entry, 16, 1, input) != 1)
+		{
+			fprintf(stderr, "Unexpected end of the PCF file.\n");
+			return 0;
+		}
+		tables[i].type = msbtfont_import_le32(&entry[0]);
+		tables[i].format = msbtfont_import_le32(&entry[4]);
+		tables[i].size = msbtfont_import_le32(&entry[8]);
+		tables[i].offset = msbtfont_import_le32(&entry[12]);
+	}
+	msbtfont_import_pcf_reader reader;
+	if (msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_PROPERTIES, &reader))
+	{
+		unsigned int property_count = msbtfont_import_pcf_read(&reader, 4);
+		size_t properties = reader.position;
+		size_t strings = properties + ((size_t)(property_count) * 9) + ((property_count & 3) ? 4 - (property_count & 3) : 0) + 4;
+		for (unsigned int i = 0; i < property_count && strings <= reader.size && !reader.failed; ++i)
+		{
+			reader.position = properties + ((size_t)(i) * 9);
+			unsigned int name = msbtfont_import_pcf_read(&reader, 4);
+			unsigned int is_string = msbtfont_import_pcf_read(&reader, 1);
+			unsigned int value = msbtfont_import_pcf_read(&reader, 4);
+			if (!reader.failed && is_string && name < reader.size - strings && value < reader.size - strings && strcmp((const char *)(&reader.data[strings + name]), "FAMILY_NAME") == 0)
+			{
+				const char *family_name = (const char *)(&reader.data[strings + value]);
+				const char *end = (const char *)(memchr(family_name, '\0', reader.size - strings - value));
+				msbtfont_import_set_name(font, family_name, (end != NULL) ? (size_t)(end - family_name) : reader.size - strings - value);
+			}
+		}
+		free(reader.data);
+	}
+	if (msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_BDF_ACCELERATORS, &reader) || msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_ACCELERATORS, &reader))
+	{
+		reader.position += 8;
+		font->ascent = (int)(msbtfont_import_pcf_read(&reader, 4));
+		font->descent = (int)(msbtfont_import_pcf_read(&reader, 4));
+		free(reader.data);
+	}
+	msbtfont_import_pcf_reader metrics;
+	msbtfont_import_pcf_reader bitmaps;
+	msbtfont_import_pcf_reader encodings;
+	if (!msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_METRICS, &metrics))
+	{
+		fprintf(stderr, "The PCF file has no metrics.\n");
+		return 0;
+	}
+	if (!msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_BITMAPS, &bitmaps))
+	{
+		fprintf(stderr, "The PCF file has no bitmaps.\n");
+		free(metrics.data);
+		return 0;
+	}
+	if (!msbtfont_import_pcf_open(input, tables, table_count, MSBTFONT_PCF_BDF_ENCODINGS, &encodings))
+	{
+		fprintf(stderr, "The PCF file has no encodings.\n");
+		free(metrics.data);
+		free(bitmaps.data);
+		return 0;
+	}
+	int compressed = (metrics.format & MSBTFONT_PCF_COMPRESSED_METRICS) != 0;
+	unsigned int metrics_count = msbtfont_import_pcf_read(&metrics, compressed ? 2 : 4);
+	size_t metrics_start = metrics.position;
+	unsigned int bitmap_count = msbtfont_import_pcf_read(&bitmaps, 4);
+	size_t offsets_start = bitmaps.position;
+	size_t bitmap_data_size = 0;
+	if ((size_t)(bitmap_count) <= (bitmaps.size - offsets_start) / 4)
+	{
+		bitmaps.position = offsets_start + ((size_t)(bitmap_count) * 4) + ((bitmaps.format & 3) * 4);
+		bitmap_data_size = msbtfont_import_pcf_read(&bitmaps, 4);
+		bitmaps.position = offsets_start + ((size_t)(bitmap_count) * 4) + 16;
+	}
+	size_t bitmap_data_start = bitmaps.position;
+	unsigned int min_byte2 = msbtfont_import_pcf_read(&encodings, 2);
+	unsigned int max_byte2 = msbtfont_import_pcf_read(&encodings, 2);
+	unsigned int min_byte1 = msbtfont_import_pcf_read(&encodings, 2);
+	unsigned int max_byte1 = msbtfont_import_pcf_read(&encodings, 2);
+	msbtfont_import_pcf_read(&encodings, 2);
+	size_t encodings_start = encodings.position;
+	int result = !(metrics.failed || bitmaps.failed || encodings.failed || bitmap_data_size > bitmaps.size - bitmap_data_start);
+	if (!result)
+	{
+		fprintf(stderr, "Invalid PCF tables.\n");
+	}
+	size_t row_padding = (size_t)(1) << (bitmaps.format & 3);
+	size_t scan_unit = (size_t)(1) << ((bitmaps.format >> 4) & 3);
+	int reverse_bits = !(bitmaps.format & MSBTFONT_PCF_BIT_MASK);
+	int swap_bytes = ((bitmaps.format & MSBTFONT_PCF_BYTE_MASK) != 0) != ((bitmaps.format & MSBTFONT_PCF_BIT_MASK) != 0);
+	unsigned char row[1024];
+	for (unsigned int byte1 = min_byte1; result && byte1 <= max_byte1; ++byte1)
+	{
+		for (unsigned int byte2 = min_byte2; result && byte2 <= max_byte2; ++byte2)
+		{
+			encodings.position = encodings_start + ((((size_t)(byte1 - min_byte1) * (max_byte2 - min_byte2 + 1)) + (byte2 - min_byte2)) * 2);
+			unsigned int index = msbtfont_import_pcf_read(&encodings, 2);
+			if (encodings.failed || index == 0xFFFF || index >= metrics_count || index >= bitmap_count)
+			{
+				encodings.failed = 0;
+				continue;
+			}
+			int values[5];
+			metrics.position = metrics_start + ((size_t)(index) * (compressed ? 5 : 12));
+			for (int i = 0; i < 5; ++i)
+			{
+				values[i] = compressed ? (int)(msbtfont_import_pcf_read(&metrics, 1)) - 0x80 : (int)((short)(msbtfont_import_pcf_read(&metrics, 2)));
+			}
+			bitmaps.position = offsets_start + ((size_t)(index) * 4);
+			size_t offset = msbtfont_import_pcf_read(&bitmaps, 4);
+			msbtfont_import_glyph glyph;
+			memset(&glyph, 0, sizeof(msbtfont_import_glyph));
+			glyph.code = (min_byte1 == 0 && max_byte1 == 0) ? byte2 : ((byte1 << 8) | byte2);
+			glyph.left = values[0];
+			glyph.width = (values[1] > values[0]) ? (unsigned int)(values[1] - values[0]) : 0;
+			glyph.advance = values[2];
+			glyph.top = values[3];
+			glyph.height = (values[3] + values[4] > 0) ? (unsigned int)(values[3] + values[4]) : 0;
+			size_t pitch = (glyph.width + 7) / 8;
+			size_t stride = ((pitch + row_padding - 1) / row_padding) * row_padding;
+			if (metrics.failed || bitmaps.failed || stride > sizeof(row) || offset > bitmap_data_size || stride * glyph.height > bitmap_data_size - offset)
+			{
+				fprintf(stderr, "Invalid PCF glyph %u.\n", index);
+				result = 0;
+				break;
+			}
+			unsigned char *bitmap = msbtfont_import_add_glyph(font, &glyph);
+			if (bitmap == NULL)
+			{
+				fprintf(stderr, "Out of memory.\n");
+				result = 0;
+				break;
+			}
+			if (bitmap == msbtfont_import_skipped)
+			{
+				continue;
+			}
+			for (unsigned int y = 0; y < glyph.height; ++y)
+			{
+				memcpy(row, &bitmaps.data[bitmap_data_start + offset + (y * stride)], stride);
+				for (size_t x = 0; reverse_bits && x < stride; ++x)
+				{
+					unsigned char value = row[x];
+					value = (unsigned char)(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+					value = (unsigned char)(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+					row[x] = (unsigned char)(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
+				}
+				for (size_t x = 0; swap_bytes && scan_unit > 1 && x + scan_unit <= stride; x += scan_unit)
+				{
+					for (size_t i = 0; i < scan_unit / 2; ++i)
+					{
+						unsigned char value = row[x + i];
+						row[x + i] = row[x + scan_unit - 1 - i];
+						row[x + scan_unit - 1 - i] = value;
+					}
+				}
+				memcpy(&bitmap[y * pitch], row, pitch);
+			}
+		}
+	}
+	free(metrics.data);
+	free(bitmaps.data);
+	free(encodings.data);
+	return result;
+}
+
+typedef struct msbtfont_import_packer
+{
+	const msbtfont_import_source *font;
+	const unsigned int *lookup; // Glyph of every character (MSBTFONT_IMPORT_NO_GLYPH if missing)
+	const msbtfont_header *header;
+	msbtfont_filedata *filedata;
+	unsigned int character_count;
+	unsigned int cell_width;
+	unsigned int cell_height;
+	int origin_x; // Position of the origin (left end of the baseline) within a character
+	int origin_y;
+	unsigned int first_batch;
+	unsigned int batch_stride;
+	msbtfont_retcode retcode;
+} msbtfont_import_packer;
+
+static void msbtfont_import_pack_batches(msbtfont_import_packer *packer)
+{
+	size_t character_bits = (size_t)(packer->cell_width) * packer->cell_height;
+	unsigned char *batch_data = (unsigned char *)(malloc(((MSBTFONT_IMPORT_BATCH_SIZE * character_bits) + 7) / 8));
+	if (batch_data == NULL)
+	{
+		packer->retcode = MSBTFONT_OUT_OF_MEMORY;
+		return;
+	}
+	packer->retcode = MSBTFONT_SUCCESS;
+	for (unsigned long long batch = packer->first_batch; batch * MSBTFONT_IMPORT_BATCH_SIZE < packer->character_count && packer->retcode == MSBTFONT_SUCCESS; batch += packer->batch_stride)
+	{
+		unsigned int first_index = (unsigned int)(batch * MSBTFONT_IMPORT_BATCH_SIZE);
+		unsigned int count = (packer->character_count - first_index < MSBTFONT_IMPORT_BATCH_SIZE) ? packer->character_count - first_index : MSBTFONT_IMPORT_BATCH_SIZE;
+		memset(batch_data, 0, ((count * character_bits) + 7) / 8);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			unsigned int glyph_index = packer->lookup[first_index + i];
+			if (glyph_index == MSBTFONT_IMPORT_NO_GLYPH)
+			{
+				continue;
+			}
+			const msbtfont_import_glyph *glyph = &packer->font->glyphs[glyph_index];
+			const unsigned char *bitmap = &packer->font->bitmaps[glyph->bitmap_offset];
+			size_t pitch = (glyph->width + 7) / 8;
+			int x0 = packer->origin_x + glyph->left;
+			int y0 = packer->origin_y - glyph->top;
+			for (unsigned int y = 0; y < glyph->height; ++y)
+			{
+				for (unsigned int x = 0; x < glyph->width; ++x)
+				{
+					if (bitmap[(y * pitch) + (x / 8)] & (0x80 >> (x % 8)))
+					{
+						size_t bit = (i * character_bits) + ((size_t)(y0 + (int)(y)) * packer->cell_width) + (size_t)(x0 + (int)(x));
+						batch_data[bit / 8] |= (unsigned char)(0x80 >> (bit % 8));
+					}
+				}
+			}
+		}
+		packer->retcode = msbtfont_store_font_characters(packer->header, packer->filedata, batch_data, first_index, count);
+	}
+	free(batch_data);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI msbtfont_import_packer_main(LPVOID parameter)
+{
+	msbtfont_import_pack_batches((msbtfont_import_packer *)(parameter));
+	return 0;
+}
+#else
+static void *msbtfont_import_packer_main(void *parameter)
+{
+	msbtfont_import_pack_batches((msbtfont_import_packer *)(parameter));
+	return NULL;
+}
+#endif
+
+static unsigned int msbtfont_import_processor_count(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	return (system_info.dwNumberOfProcessors > 0) ? (unsigned int)(system_info.dwNumberOfProcessors) : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (unsigned int)(count) : 1;
+#endif
+}
+
+// Splits the batches between threads (the calling thread included) and waits for all of them
+static msbtfont_retcode msbtfont_import_pack(msbtfont_import_packer *template_packer, unsigned int thread_count)
+{
+	unsigned int batch_count = (unsigned int)((template_packer->character_count + (unsigned long long)(MSBTFONT_IMPORT_BATCH_SIZE) - 1) / MSBTFONT_IMPORT_BATCH_SIZE);
+	if (thread_count > batch_count)
+	{
+		thread_count = batch_count ? batch_count : 1;
+	}
+	msbtfont_import_packer *packers = (msbtfont_import_packer *)(calloc(thread_count, sizeof(msbtfont_import_packer)));
+#if defined(_WIN32)
+	HANDLE *threads = (HANDLE *)(calloc(thread_count, sizeof(HANDLE)));
+#else
+	pthread_t *threads = (pthread_t *)(calloc(thread_count, sizeof(pthread_t)));
+	unsigned char *started = (unsigned char *)(calloc(thread_count, 1));
+	if (started == NULL)
+	{
+		free(threads);
+		threads = NULL;
+	}
+#endif
+	if (packers == NULL || threads == NULL)
+	{
+		free(packers);
+		free(threads);
+		return MSBTFONT_OUT_OF_MEMORY;
+	}
+	for (unsigned int i = 0; i < thread_count; ++i)
+	{
+		packers[i] = *template_packer;
+		packers[i].first_batch = i;
+		packers[i].batch_stride = thread_count;
+	}
+	// Threads that can't be started leave their batches to the calling thread
+	unsigned int started_count = 1;
+	for (unsigned int i = 1; i < thread_count; ++i)
+	{
+#if defined(_WIN32)
+		threads[i] = CreateThread(NULL, 0, msbtfont_import_packer_main, &packers[i], 0, NULL);
+		if (threads[i] == NULL)
+		{
+			break;
+		}
+#else
+		if (pthread_create(&threads[i], NULL, msbtfont_import_packer_main, &packers[i]) != 0)
+		{
+			break;
+		}
+		started[i] = 1;
+#endif
+		++started_count;
+	}
+	for (unsigned int i = started_count; i < thread_count; ++i)
+	{
+		msbtfont_import_pack_batches(&packers[i]);
+	}
+	msbtfont_import_pack_batches(&packers[0]);
+	msbtfont_retcode retcode = packers[0].retcode;
+	for (unsigned int i = 1; i < thread_count; ++i)
+	{
+#if defined(_WIN32)
+		if (i < started_count)
+		{
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+#else
+		if (started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+#endif
+		if (packers[i].retcode != MSBTFONT_SUCCESS)
+		{
+			retcode = packers[i].retcode;
+		}
+	}
+#if !defined(_WIN32)
+	free(started);
+#endif
+	free(threads);
+	free(packers);
+	return retcode;
+}
+
+static int msbtfont_import_build(const msbtfont_import_source *font, const msbtfont_import_descriptor *descriptor, msbtfont_header *header, msbtfont_filedata *filedata)
+{
+	if (font->glyph_count == 0)
+	{
+		fprintf(stderr, "The font has no glyphs in the requested range.\n");
+		return 0;
+	}
+	unsigned int last_code = font->first_code;
+	int min_left = 0;
+	int max_right = 1;
+	int max_top = font->ascent;
+	int min_bottom = -font->descent;
+	for (size_t i = 0; i < font->glyph_count; ++i)
+	{
+		const msbtfont_import_glyph *glyph = &font->glyphs[i];
+		last_code = (glyph->code > last_code) ? glyph->code : last_code;
+		min_left = (glyph->left < min_left) ? glyph->left : min_left;
+		max_right = (glyph->left + (int)(glyph->width) > max_right) ? glyph->left + (int)(glyph->width) : max_right;
+		max_right = (glyph->advance > max_right) ? glyph->advance : max_right;
+		if (glyph->height != 0)
+		{
+			max_top = (glyph->top > max_top) ? glyph->top : max_top;
+			min_bottom = (glyph->top - (int)(glyph->height) < min_bottom) ? glyph->top - (int)(glyph->height) : min_bottom;
+		}
+	}
+	if (descriptor->last_code != UINT_MAX)
+	{
+		last_code = descriptor->last_code;
+	}
+	long long cell_width = (long long)(max_right) - min_left;
+	long long cell_height = (long long)(max_top) - min_bottom;
+	if (cell_height < 1)
+	{
+		cell_height = 1;
+	}
+	if (cell_width > 256 || cell_height > 256)
+	{
+		fprintf(stderr, "Glyphs need a %lldx%lld character, which is larger than 256x256.\n", cell_width, cell_height);
+		return 0;
+	}
+	if (last_code - font->first_code >= UINT_MAX)
+	{
+		fprintf(stderr, "Too many characters.\n");
+		return 0;
+	}
+	unsigned int character_count = last_code - font->first_code + 1;
+	unsigned int *lookup = (unsigned int *)(malloc((size_t)(character_count) * sizeof(unsigned int)));
+	if (lookup == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	memset(lookup, 0xFF, (size_t)(character_count) * sizeof(unsigned int));
+	int variable_width = 0;
+	for (size_t i = 0; i < font->glyph_count; ++i)
+	{
+		lookup[font->glyphs[i].code - font->first_code] = (unsigned int)(i);
+		variable_width |= (font->glyphs[i].advance != cell_width);
+	}
+	msbtfont_header_descriptor header_descriptor;
+	memset(&header_descriptor, 0, sizeof(msbtfont_header_descriptor));
+	header_descriptor.palette_format = 0;
+	header_descriptor.max_font_width = (unsigned char)(cell_width - 1);
+	header_descriptor.max_font_height = (unsigned char)(cell_height - 1);
+	header_descriptor.flags = variable_width ? 0x01 : 0x00;
+	header_descriptor.font_character_count = character_count;
+	memcpy(header_descriptor.font_name, font->name, strlen(font->name));
+	msbtfont_retcode retcode = msbtfont_create_header(header, &header_descriptor);
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		// Every character gets stored below, so only the pad bits past the last one need clearing
+		retcode = msbtfont_create_filedata_with_initialization(header, filedata, NULL, MSBTFONT_FILEDATA_UNINITIALIZED);
+	}
+	if (retcode == MSBTFONT_SUCCESS)
+	{
+		size_t font_data_size = filedata->size - (size_t)(filedata->font_data - filedata->data);
+		if (font_data_size != 0)
+		{
+			filedata->font_data[font_data_size - 1] = 0;
+		}
+		for (unsigned int i = 0; variable_width && i < character_count; ++i)
+		{
+			int advance = (lookup[i] != MSBTFONT_IMPORT_NO_GLYPH) ? font->glyphs[lookup[i]].advance : (int)(cell_width);
+			advance = (advance < 1) ? 1 : ((advance > cell_width) ? (int)(cell_width) : advance);
+			filedata->variable_table[i] = (unsigned char)(advance - 1);
+		}
+		msbtfont_import_packer packer;
+		memset(&packer, 0, sizeof(msbtfont_import_packer));
+		packer.font = font;
+		packer.lookup = lookup;
+		packer.header = header;
+		packer.filedata = filedata;
+		packer.character_count = character_count;
+		packer.cell_width = (unsigned int)(cell_width);
+		packer.cell_height = (unsigned int)(cell_height);
+		packer.origin_x = -min_left;
+		packer.origin_y = max_top;
+		retcode = msbtfont_import_pack(&packer, descriptor->thread_count ? descriptor->thread_count : msbtfont_import_processor_count());
+		if (retcode != MSBTFONT_SUCCESS)
+		{
+			msbtfont_delete_filedata(filedata);
+		}
+	}
+	free(lookup);
+	if (retcode != MSBTFONT_SUCCESS)
+	{
+		fprintf(stderr, "Couldn't create the font (error %d).\n", retcode);
+		return 0;
+	}
+	return 1;
+}
+
+int msbtfont_import_font(const char *path, const msbtfont_import_descriptor *descriptor, msbtfont_header *header, msbtfont_filedata *filedata, unsigned int *glyph_count)
+{
+	FILE *input = fopen(path, "rb");
+	if (input == NULL)
+	{
+		fprintf(stderr, "Couldn't open '%s'.\n", path);
+		return 0;
+	}
+	unsigned char magic[9] = { 0 };
+	size_t magic_size = fread(magic, 1, sizeof(magic), input);
+	rewind(input);
+	msbtfont_import_source font;
+	memset(&font, 0, sizeof(msbtfont_import_source));
+	font.first_code = descriptor->first_code;
+	font.last_code = descriptor->last_code;
+	int result = 0;
+	if (magic_size >= 2 && magic[0] == 0x36 && magic[1] == 0x04)
+	{
+		result = msbtfont_import_psf(input, magic, &font);
+	}
+	else if (magic_size >= 4 && magic[0] == 0x72 && magic[1] == 0xB5 && magic[2] == 0x4A && magic[3] == 0x86)
+	{
+		result = msbtfont_import_psf(input, magic, &font);
+	}
+	else if (magic_size >= 4 && memcmp(magic, "\1fcp", 4) == 0)
+	{
+		result = msbtfont_import_pcf(input, &font);
+	}
+	else if (magic_size >= 9 && memcmp(magic, "STARTFONT", 9) == 0)
+	{
+		result = msbtfont_import_bdf(input, &font);
+	}
+	else
+	{
+		fprintf(stderr, "'%s' is not a BDF, PCF or PSF font.\n", path);
+	}
+	fclose(input);
+	if (result)
+	{
+		result = msbtfont_import_build(&font, descriptor, header, filedata);
+	}
+	if (result && glyph_count != NULL)
+	{
+		*glyph_count = (unsigned int)(font.glyph_count);
+	}
+	free(font.glyphs);
+	free(font.bitmaps);
+	return result;
+}
@@ -0,0 +1,36 @@
+/* MisbitFont Importers
+ *
+ * Converts BDF, PCF and PSF (version 1 and 2) bitmap fonts into MisbitFont fonts for the
+ * command line tool.  Files are read front to back (PCF one table at a time) without building
+ * a document of the whole file, and the glyphs are packed into the font data in parallel
+ * batches.
+ *
+ */
+
+#ifndef _MSBTFONT_IMPORT_H_
+#define _MSBTFONT_IMPORT_H_
+
+#include "../include/msbtfont.h"
+
+typedef struct msbtfont_import_descriptor
+{
+	unsigned int first_code; // Code point stored as character 0
+	unsigned int last_code; // Last code point to store; UINT_MAX = Highest code point in the font
+	unsigned int thread_count; // Threads used for packing; 0 = One per processor
+} msbtfont_import_descriptor;
+
+/**
+ *  Function:  msbtfont_import_font
+ *
+ *  Description:  Reads a BDF, PCF or PSF font (detected from its contents) and creates a
+ *  1-bit MisbitFont font from it.  Character 'i' holds code point 'first_code + i' (glyph
+ *  position for PSF fonts), characters the font lacks are left blank and the variable table is
+ *  used whenever the advance widths differ from the character width.  Reports problems on
+ *  stderr.
+ *
+ *  Returns:
+ *  	1 if the font was imported ('filedata' must be deleted with 'msbtfont_delete_filedata'), otherwise 0.
+ **/
+int msbtfont_import_font(const char *path, const msbtfont_import_descriptor *descriptor, msbtfont_header *header, msbtfont_filedata *filedata, unsigned int *glyph_count);
+
+#endif